@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <ast.hpp>
+#include <flat_parse_tree.hpp>
+#include <parse_node.hpp>
+#include <parser.hpp>
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+constexpr std::size_t script_size = 1024 * 1024;
+
+// Functions whose bodies are an if block, as in the scripts we load
+std::string make_function_script(const std::size_t size)
+{
+  std::string result;
+  result.reserve(size + 256);
+
+  for (std::size_t function = 0; result.size() < size; ++function) {
+    const auto id = std::to_string(function);
+    result += "auto function_" + id + "(auto x, auto y, auto z) {\n";
+    result += "  if (x > y && y != " + id + ") {\n";
+    result += "    auto value_" + id + "{ (x * 15 + 0xAF12) / -(y - 3.1415e2f) };\n";
+    result += "    while (x < value_" + id + ") { print(\"Hello \\\"World\\\" from " + id + "\"); }\n";
+    result += "    call_other_function(value_" + id + ", z, 0B1010101, 123.42E1l);\n";
+    result += "  } else {\n";
+    result += "    for (auto i{ 0 }; i < z; i + 1) { print(i); }\n";
+    result += "  }\n";
+    result += "}\n\n";
+  }
+
+  return result;
+}
+
+// Nested blocks of variables initialized with literals, the only statements
+// that a builder without expression operators, calls or control statements
+// can build
+std::string make_declaration_block(const std::size_t size)
+{
+  std::string result = "if (true) {\n";
+  result.reserve(size + 256);
+
+  for (std::size_t block = 0; result.size() < size; ++block) {
+    const auto id = std::to_string(block);
+    result += "  auto value_" + id + "{ 0xAF12 };\n";
+    result += "  { auto name_" + id + "{ \"Hello\" }; { auto ratio_" + id + "{ 3.1415e2f }; } }\n";
+  }
+
+  result += "}\n";
+  return result;
+}
+
+// A block of wide nodes: thousands of statements, each a call with many
+// arguments that starts a long chain of calls
+std::string make_wide_block(const std::size_t size)
+{
+  std::string result = "if (true) {\n";
+  result.reserve(size + 4096);
+
+  while (result.size() < size) {
+    result += "  f(0";
+    for (int argument = 1; argument < 256; ++argument) {
+      result += ", ";
+      result += std::to_string(argument);
+    }
+    result += ")";
+    for (int call = 0; call < 64; ++call) {
+      result += '(';
+      result += std::to_string(call);
+      result += ')';
+    }
+    result += ";\n";
+  }
+
+  result += "}\n";
+  return result;
+}
+
+// Builds every definition into a builder that is then destroyed, which
+// releases the nodes
+template<typename Builder, typename Node> void report(const std::string_view name, const Node &root)
+{
+  constexpr int iterations = 10;
+
+  std::size_t errors = 0;
+  const auto elapsed = thing::benchmark::best_of(iterations, [&] {
+    Builder builder;
+    errors = 0;
+    for (const auto &definition : root) {
+      const auto built = builder.build_function_ast(definition);
+      if (Builder::is_parse_error(built)) { ++errors; }
+      thing::benchmark::do_not_optimize(built);
+    }
+  });
+  fmt::print("{:32} {:10.3f} ms, {} of {} definitions failed\n", name, elapsed * 1000, errors, root.size());
+}
+
+template<typename Builder, typename Node> void report_block(const std::string_view name, const Node &block)
+{
+  constexpr int iterations = 10;
+
+  bool failed = false;
+  const auto elapsed = thing::benchmark::best_of(iterations, [&] {
+    Builder builder;
+    const auto built = builder.build_compound_statement(block);
+    failed = Builder::is_parse_error(built);
+    thing::benchmark::do_not_optimize(built);
+  });
+  fmt::print("{:32} {:10.3f} ms, {}\n", name, elapsed * 1000, failed ? "failed" : "built");
+}
+
+// Destroying a builder that holds the ASTs of all the functions, which frees
+// every node
+template<typename Builder, typename Node> void report_release(const std::string_view name, const Node &root)
+{
+  constexpr int iterations = 10;
+
+  double best = std::numeric_limits<double>::max();
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    std::optional<Builder> builder{ std::in_place };
+    for (const auto &definition : root) { thing::benchmark::do_not_optimize(builder->build_function_ast(definition)); }
+
+    const auto start = std::chrono::steady_clock::now();
+    builder.reset();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  fmt::print("{:32} {:10.3f} ms\n", name, best * 1000);
+}
+
+// A pass over every node of one kind, which are contiguous
+template<typename Builder, typename Node> void report_pass(const std::string_view name, const Node &root)
+{
+  constexpr int iterations = 10;
+
+  Builder builder;
+  for (const auto &definition : root) { thing::benchmark::do_not_optimize(builder.build_function_ast(definition)); }
+
+  std::size_t count = 0;
+  const auto elapsed = thing::benchmark::best_of(iterations, [&] {
+    count = 0;
+    for (const auto &node : builder.nodes.template all<typename Builder::infix_operator>()) {
+      if (node.op.type == thing::lexing::token_type::less_than) { ++count; }
+    }
+    thing::benchmark::do_not_optimize(count);
+  });
+  fmt::print("{:32} {:10.3f} ms, {} of {} infix operators are `<`\n",
+    name,
+    elapsed * 1000,
+    count,
+    builder.nodes.template all<typename Builder::infix_operator>().size());
+}
+}// namespace
+
+// Building ASTs from the trees of scripts that parse without errors, from
+// parse nodes and from flat parse trees. Parsing is not timed.
+int main()
+{
+  using node_builder = thing::ast::basic_ast_builder<std::vector>;
+  using flat_builder =
+    thing::ast::basic_ast_builder<std::vector, thing::parsing::basic_flat_parse_tree<std::vector>::node_view>;
+
+  const auto functions = make_function_script(script_size);
+  const auto declarations = make_declaration_block(script_size);
+
+  thing::parsing::basic_parser<std::vector> node_parser;
+  thing::parsing::basic_flat_parser<std::vector> flat_parser;
+
+  const auto function_tokens = thing::lexing::tokenize(functions);
+  const auto definitions = node_parser.parse_definitions(function_tokens);
+  const auto flat_definitions = flat_parser.parse_definitions(function_tokens);
+  std::vector<flat_builder::parse_node> flat_roots;
+  for (const auto &definition : flat_definitions) { flat_roots.push_back(definition.root()); }
+  fmt::print("functions: {} bytes, {} definitions\n", functions.size(), definitions.size());
+  report<node_builder>("functions, parse nodes", definitions);
+  report<flat_builder>("functions, flat tree", flat_roots);
+  report_release<flat_builder>("freeing the functions' nodes", flat_roots);
+  report_pass<flat_builder>("pass over infix operators", flat_roots);
+
+  const auto declaration_tree = node_parser.parse(declarations);
+  const auto flat_declaration_tree = flat_parser.parse(declarations);
+  fmt::print("declarations: {} bytes\n", declarations.size());
+  report_block<node_builder>("declarations, parse nodes", declaration_tree.children[1]);
+  report_block<flat_builder>("declarations, flat tree", flat_declaration_tree.root().children[1]);
+
+  const auto wide = make_wide_block(script_size);
+  const auto wide_tree = node_parser.parse(wide);
+  const auto flat_wide_tree = flat_parser.parse(wide);
+  fmt::print("wide nodes: {} bytes\n", wide.size());
+  report_block<node_builder>("wide nodes, parse nodes", wide_tree.children[1]);
+  report_block<flat_builder>("wide nodes, flat tree", flat_wide_tree.root().children[1]);
+}
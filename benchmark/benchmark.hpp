@@ -0,0 +1,82 @@
+#ifndef THING_BENCHMARK_HPP
+#define THING_BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace thing::benchmark {
+
+// Runs `func` `iterations` times and returns the fastest run in seconds.
+// Taking the minimum filters out most of the scheduling noise.
+template<typename Func> [[nodiscard]] double best_of(const int iterations, Func &&func)
+{
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+// Defeats dead code elimination of benchmark results
+template<typename T> void do_not_optimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+// Generates a script of roughly `size` bytes, made of function definitions
+// that are representative of the scripts we load
+[[nodiscard]] inline std::string make_script(const std::size_t size)
+{
+  std::string result;
+  result.reserve(size + 256);
+
+  for (std::size_t function = 0; result.size() < size; ++function) {
+    const auto id = std::to_string(function);
+    result += "auto function_" + id + "(auto x, auto y, auto z) {\n";
+    result += "  auto value_" + id + "{ (x * 15 + 0xAF12) / (y - 3.1415e2f) };\n";
+    result += "  if (x > y && y != " + id + ") {\n";
+    result += "    print(\"Hello \\\"World\\\" from " + id + "\");\n";
+    result += "  } else {\n";
+    result += "    call_other_function(value_" + id + ", z, 0B1010101, 123.42E1l);\n";
+    result += "  }\n";
+    result += "}\n\n";
+  }
+
+  return result;
+}
+
+// Generates a single `if (true) { ... }` block of roughly `size` bytes, made
+// of statements the parser accepts, so one parse() call covers the input
+[[nodiscard]] inline std::string make_statement_block(const std::size_t size)
+{
+  std::string result = "if (true) {\n";
+  result.reserve(size + 256);
+
+  for (std::size_t statement = 0; result.size() < size; ++statement) {
+    const auto id = std::to_string(statement);
+    result += "  auto value_" + id + "{ (x * 15 + 0xAF12) / (y - 3.1415e2f) };\n";
+    result += "  if (x > y && y != " + id + ") {\n";
+    result += "    print(\"Hello \\\"World\\\" from " + id + "\");\n";
+    result += "  }\n";
+    result += "  call_other_function(value_" + id + ", z, 0B1010101, 123.42E1l);\n";
+  }
+
+  result += "}\n";
+  return result;
+}
+
+}// namespace thing::benchmark
+
+#endif
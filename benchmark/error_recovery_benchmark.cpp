@@ -0,0 +1,114 @@
+#include <cstddef>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <line_table.hpp>
+#include <parse_node.hpp>
+#include <parser.hpp>
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+constexpr std::size_t line_count = 10000;
+constexpr std::size_t error_count = 100;
+
+// Functions whose bodies are an if block of three statements, with a mistake
+// in every 33rd statement, of one of four kinds in turn. `injected` gets the
+// line numbers of the mistakes.
+std::string make_lint_script(std::vector<std::size_t> &injected)
+{
+  std::vector<std::string> lines;
+  std::vector<std::size_t> statements;
+  for (std::size_t function = 0; lines.size() < line_count; ++function) {
+    const auto id = std::to_string(function);
+    lines.push_back("auto function_" + id + "(auto x, auto y, auto z) {");
+    lines.push_back("  if (x > y && y != " + id + ") {");
+    statements.push_back(lines.size());
+    lines.push_back("    auto value_" + id + "{ (x * 15 + 0xAF12) / (y - 3.1415e2f) };");
+    statements.push_back(lines.size());
+    lines.push_back("    print(\"Hello \\\"World\\\" from " + id + "\");");
+    statements.push_back(lines.size());
+    lines.push_back("    call_other_function(value_" + id + ", z, 0B1010101, 123.42E1l);");
+    lines.push_back("  }");
+    lines.push_back("}");
+  }
+
+  for (std::size_t error = 0; error < error_count; ++error) {
+    const auto line = statements[(error * statements.size() + statements.size() / 2) / error_count];
+    auto &text = lines[line];
+    switch (error % 4) {
+    case 0:
+      // a missing `;`
+      text.pop_back();
+      break;
+    case 1:
+      // a token too many
+      text.insert(text.find('(') + 1, "42 ");
+      break;
+    case 2:
+      // a missing `)`
+      text.erase(text.rfind(')'), 1);
+      break;
+    default:
+      // an operator without a right operand
+      text.insert(text.rfind(')'), " +");
+      break;
+    }
+    injected.push_back(line);
+  }
+
+  std::string result;
+  for (const auto &line : lines) { result += line + '\n'; }
+  return result;
+}
+
+template<typename Node> void collect_errors(const Node &node, std::vector<const Node *> &errors)
+{
+  if (node.is_error()) { errors.push_back(&node); }
+  for (const auto &child : node.children) { collect_errors(child, errors); }
+}
+}// namespace
+
+// Linting a script with 100 mistakes in 10k lines: one parse reports all of
+// them, where a parser that stops at the first one needs a parse per fix
+int main()
+{
+  constexpr int iterations = 10;
+
+  std::vector<std::size_t> injected;
+  const auto script = make_lint_script(injected);
+  thing::parsing::basic_parser<std::vector> parser;
+  using parse_node = thing::parsing::basic_parse_node<std::vector>;
+
+  std::vector<const parse_node *> errors;
+  std::vector<parse_node> definitions;
+  const auto lint = [&] {
+    const auto tokens = thing::lexing::tokenize(script);
+    definitions = parser.parse_definitions(tokens);
+    errors.clear();
+    for (const auto &definition : definitions) { collect_errors(definition, errors); }
+  };
+  const auto elapsed = thing::benchmark::best_of(iterations, lint);
+
+  // a mistake is found if there is an error on its line, or on the next for
+  // a missing `;`, which is reported at the token in its place
+  const thing::basic_line_table<std::vector> lines{ script };
+  std::set<std::size_t> error_lines;
+  for (const auto *error : errors) { error_lines.insert(lines.position_of(error->item).line); }
+  std::size_t found = 0;
+  for (const auto line : injected) {
+    if (error_lines.contains(line) || error_lines.contains(line + 1)) { ++found; }
+  }
+
+  fmt::print("input: {} lines, {} bytes, {} mistakes\n", lines.line_count(), script.size(), injected.size());
+  fmt::print("one pass:              {:10.3f} ms, {} errors reported, {} of {} mistakes found\n",
+    elapsed * 1000,
+    errors.size(),
+    found,
+    injected.size());
+  fmt::print("a pass per mistake:    {:10.3f} ms\n", elapsed * 1000 * static_cast<double>(injected.size()));
+}
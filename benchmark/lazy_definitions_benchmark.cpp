@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <ast.hpp>
+#include <lazy_definitions.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+// heap in use and its high water mark, with the size of every block kept in
+// front of it
+std::size_t in_use = 0;
+std::size_t peak = 0;
+constexpr std::size_t header = alignof(std::max_align_t);
+}// namespace
+
+void *operator new(const std::size_t size)
+{
+  auto *block = static_cast<char *>(std::malloc(size + header));
+  if (block == nullptr) { throw std::bad_alloc{}; }
+  *reinterpret_cast<std::size_t *>(block) = size;
+  in_use += size;
+  peak = std::max(peak, in_use);
+  return block + header;
+}
+
+void operator delete(void *pointer) noexcept
+{
+  if (pointer == nullptr) { return; }
+  auto *block = static_cast<char *>(pointer) - header;
+  in_use -= *reinterpret_cast<std::size_t *>(block);
+  std::free(block);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept { operator delete(pointer); }
+
+namespace {
+// the peak heap of `func` above what was in use before, in bytes
+template<typename Func> std::size_t peak_of(Func &&func)
+{
+  const auto before = in_use;
+  peak = in_use;
+  func();
+  return peak - before;
+}
+}// namespace
+
+// Starting up on a script of 1,000 functions, of which a run calls 10: parsing
+// every definition, against parsing only the signatures and then the bodies,
+// or the ASTs, of the functions that are called
+int main()
+{
+  constexpr int iterations = 5;
+  constexpr int functions = 1000;
+  constexpr int called = 10;
+
+  std::string script;
+  for (int function = 0; function < functions; ++function) {
+    const auto id = std::to_string(function);
+    script += "auto function_" + id + "(auto x, auto y, auto z) {\n";
+    script += "  if (x > y && y != " + id + ") {\n";
+    script += "    auto value_" + id + "{ (x * 15 + 0xAF12) / (y - 3.1415e2f) };\n";
+    script += "    print(\"Hello \\\"World\\\" from " + id + "\");\n";
+    script += "    call_other_function(value_" + id + ", z, 0B1010101, 123.42E1l);\n";
+    script += "    while (z < value_" + id + ") { z + 1; }\n";
+    script += "  }\n}\n\n";
+  }
+  const auto tokens = thing::lexing::tokenize(script);
+
+  const auto eager = [&] {
+    thing::parsing::basic_parser<std::vector> parser;
+    thing::benchmark::do_not_optimize(parser.parse_definitions(tokens));
+  };
+  const auto lazy = [&] {
+    thing::parsing::basic_lazy_definitions<std::vector> definitions{ tokens };
+    for (int function = 0; function < called; ++function) {
+      const auto index = definitions.find("function_" + std::to_string(function * (functions / called)));
+      thing::benchmark::do_not_optimize(definitions.definition(index));
+    }
+  };
+  const auto lazy_ast = [&] {
+    thing::parsing::basic_lazy_definitions<std::vector> definitions{ tokens };
+    thing::ast::basic_ast_builder<std::vector> builder;
+    for (int function = 0; function < called; ++function) {
+      const auto index = definitions.find("function_" + std::to_string(function * (functions / called)));
+      thing::benchmark::do_not_optimize(definitions.function_ast(index, builder));
+    }
+  };
+  const auto lazy_startup = [&] {
+    thing::parsing::basic_lazy_definitions<std::vector> definitions{ tokens };
+    thing::benchmark::do_not_optimize(definitions);
+  };
+
+  fmt::print("input: {} bytes, {} functions, {} called\n", script.size(), functions, called);
+  fmt::print("eager:                   {:8.3f} ms, peak {:8} KiB\n",
+    thing::benchmark::best_of(iterations, eager) * 1000,
+    peak_of(eager) / 1024);
+  fmt::print("lazy, startup only:      {:8.3f} ms, peak {:8} KiB\n",
+    thing::benchmark::best_of(iterations, lazy_startup) * 1000,
+    peak_of(lazy_startup) / 1024);
+  fmt::print("lazy, with {} bodies:    {:8.3f} ms, peak {:8} KiB\n",
+    called,
+    thing::benchmark::best_of(iterations, lazy) * 1000,
+    peak_of(lazy) / 1024);
+  fmt::print("lazy, with {} ASTs:      {:8.3f} ms, peak {:8} KiB\n",
+    called,
+    thing::benchmark::best_of(iterations, lazy_ast) * 1000,
+    peak_of(lazy_ast) / 1024);
+}
@@ -0,0 +1,113 @@
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include <ctre.hpp>
+#include <fmt/format.h>
+
+#include <lexer.hpp>
+
+#include "benchmark.hpp"
+
+// The regex based lexer that the DFA lexer replaced, kept here as the
+// baseline for comparison
+namespace legacy {
+
+// Helper function for concatenating two different ct11::fixed_strings
+template<std::size_t N1, std::size_t N2>
+constexpr auto operator+(const ctll::fixed_string<N1> &lhs, const ctll::fixed_string<N2> &rhs)
+{
+  char32_t result[N1 + N2 - 1]{};
+
+  auto iter = std::begin(result);
+  iter = std::copy(lhs.begin(), lhs.end(), iter);
+  std::copy(rhs.begin(), rhs.end(), iter);
+  return ctll::fixed_string(result);
+}
+
+using thing::lexing::lex_item;
+using thing::lexing::token_type;
+
+[[nodiscard]] static constexpr lex_item lexer(std::string_view v) noexcept
+{
+  if (v.empty()) { return lex_item{ token_type::end_of_file, v, v }; }
+
+  constexpr auto make_token = [](const auto &s) { return ctll::fixed_string{ "^" } + ctll::fixed_string{ s }; };
+
+  const auto ret = [v](const token_type type, std::string_view found) -> lex_item {
+    return { type, v.substr(0, found.size()), v.substr(found.size()) };
+  };
+
+  constexpr auto identifier{ make_token("[_a-zA-Z]+[_0-9a-zA-Z]*") };
+  constexpr auto quoted_string{ make_token(R"("([^"\\]|\\.)*")") };
+  constexpr auto floatingpoint_number{ make_token("[0-9]+[.][0-9]*([eEpP][0-9]+)?[lLfF]?") };
+  constexpr auto integral_number{ make_token("[0-9][_a-zA-Z0-9]*") };
+  constexpr auto whitespace{ make_token("\\s+") };
+
+  constexpr std::array keywords{
+    std::string_view{ "auto" }, std::string_view{ "for" }, std::string_view{ "if" }, std::string_view{ "else" }
+  };
+
+  if (auto result = ctre::search<whitespace>(v); result) { return ret(token_type::whitespace, result); }
+
+  for (const auto &oper : thing::lexing::operator_tokens) {
+    if (v.starts_with(oper.first)) { return ret(oper.second, oper.first); }
+  }
+
+  if (auto id_result = ctre::search<identifier>(v); id_result) {
+    const auto is_keyword = std::any_of(
+      begin(keywords), end(keywords), [id = std::string_view{ id_result }](const auto &rhs) { return id == rhs; });
+    return ret(is_keyword ? token_type::keyword : token_type::identifier, id_result);
+  } else if (auto string_result = ctre::search<quoted_string>(v); string_result) {
+    return ret(token_type::string, string_result);
+  } else if (auto float_result = ctre::search<floatingpoint_number>(v); float_result) {
+    return ret(token_type::number, float_result);
+  } else if (auto int_result = ctre::search<integral_number>(v); int_result) {
+    return ret(token_type::number, int_result);
+  }
+
+  return lex_item{ token_type::unknown, v, v.substr(v.size()) };
+}
+}// namespace legacy
+
+template<typename Lexer> [[nodiscard]] std::size_t count_tokens(std::string_view input, Lexer lexer)
+{
+  std::size_t count = 0;
+  while (true) {
+    const auto item = lexer(input);
+    if (item.type == thing::lexing::token_type::end_of_file) { return count; }
+    ++count;
+    input = item.remainder;
+  }
+}
+
+int main()
+{
+  constexpr int iterations = 10;
+  const auto script = thing::benchmark::make_script(std::size_t{ 8 } * 1024 * 1024);
+
+  const auto tokens = count_tokens(script, thing::lexing::lexer);
+  if (tokens != count_tokens(script, legacy::lexer)) {
+    fmt::print("Token count mismatch between the DFA and regex lexers\n");
+    return 1;
+  }
+
+  fmt::print("input: {} bytes, {} tokens\n", script.size(), tokens);
+
+  const auto report = [tokens](std::string_view name, const double seconds) {
+    fmt::print("{:>8}: {:8.3f} ms {:8.2f} Mtokens/s\n",
+      name,
+      seconds * 1000,
+      static_cast<double>(tokens) / seconds / 1'000'000);
+    return seconds;
+  };
+
+  const auto regex = report("regex", thing::benchmark::best_of(iterations, [&] {
+    thing::benchmark::do_not_optimize(count_tokens(script, legacy::lexer));
+  }));
+  const auto dfa = report("dfa", thing::benchmark::best_of(iterations, [&] {
+    thing::benchmark::do_not_optimize(count_tokens(script, thing::lexing::lexer));
+  }));
+
+  fmt::print("speedup: {:.2f}x\n", regex / dfa);
+}
@@ -0,0 +1,48 @@
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <algorithms.hpp>
+#include <line_table.hpp>
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+// Resolves a position for every token of a large file, as a lint run with
+// many diagnostics would, with the old rescanning approach and the line table
+int main()
+{
+  constexpr int iterations = 5;
+  const auto script = thing::benchmark::make_script(std::size_t{ 1 } * 1024 * 1024);
+  const auto tokens = thing::lexing::tokenize(script);
+
+  // one diagnostic per 100 tokens
+  std::vector<std::size_t> offsets;
+  for (std::size_t index = 0; index < tokens.size(); index += 100) { offsets.push_back(tokens.offsets[index]); }
+
+  fmt::print("input: {} bytes, {} diagnostics\n", script.size(), offsets.size());
+
+  const auto rescan = thing::benchmark::best_of(iterations, [&] {
+    std::size_t sum = 0;
+    for (const auto offset : offsets) {
+      const auto end = std::next(script.begin(), static_cast<std::ptrdiff_t>(offset));
+      const auto [line, location] = thing::count_to_last(script.begin(), end, '\n');
+      sum += static_cast<std::size_t>(line) + static_cast<std::size_t>(std::distance(location, end));
+    }
+    thing::benchmark::do_not_optimize(sum);
+  });
+
+  const auto table = thing::benchmark::best_of(iterations, [&] {
+    const thing::basic_line_table<std::vector> lines{ script };
+    std::size_t sum = 0;
+    for (const auto offset : offsets) {
+      const auto position = lines.position_of(offset);
+      sum += position.line + position.column;
+    }
+    thing::benchmark::do_not_optimize(sum);
+  });
+
+  fmt::print("count_to_last per diagnostic: {:10.3f} ms\n", rescan * 1000);
+  fmt::print("line table (including build): {:10.3f} ms\n", table * 1000);
+}
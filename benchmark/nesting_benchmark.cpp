@@ -0,0 +1,38 @@
+#include <array>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <flat_parse_tree.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+// Parenthesized expressions nested `levels` deep, `((...(x + 1)...))`, with
+// the nesting limit raised above the depth and at its default. Parsing time
+// per level should not depend on the depth, and input nested deeper than the
+// limit is cut short rather than parsed.
+int main()
+{
+  constexpr int iterations = 5;
+
+  for (const std::size_t levels : std::array<std::size_t, 4>{ 100, 1000, 10000, 100000 }) {
+    const auto script = std::string(levels, '(') + "x + 1" + std::string(levels, ')');
+
+    const auto unlimited = thing::benchmark::best_of(iterations, [&] {
+      thing::parsing::basic_flat_parser<std::vector> parser;
+      parser.max_nesting = levels + 1;
+      thing::benchmark::do_not_optimize(parser.parse(script));
+    });
+    const auto limited = thing::benchmark::best_of(iterations, [&] {
+      thing::parsing::basic_flat_parser<std::vector> parser;
+      thing::benchmark::do_not_optimize(parser.parse(script));
+    });
+
+    fmt::print("{:>6} levels: {:8.1f} ns per level, {:8.1f} ns per level with the default limit\n",
+      levels,
+      unlimited * 1e9 / static_cast<double>(levels),
+      limited * 1e9 / static_cast<double>(levels));
+  }
+}
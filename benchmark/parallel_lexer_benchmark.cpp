@@ -0,0 +1,31 @@
+#include <string>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include <parallel_lexer.hpp>
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+// Scaling of parallel_tokenize from 1 to 32 threads on a large generated script
+int main()
+{
+  constexpr int iterations = 5;
+  const auto script = thing::benchmark::make_script(std::size_t{ 64 } * 1024 * 1024);
+
+  fmt::print("input: {} bytes, {} hardware threads\n", script.size(), std::thread::hardware_concurrency());
+
+  const auto sequential = thing::benchmark::best_of(iterations, [&] {
+    thing::benchmark::do_not_optimize(thing::lexing::tokenize(script).size());
+  });
+  fmt::print("tokenize:                     {:10.3f} ms\n", sequential * 1000);
+
+  for (const std::size_t threads : { 1u, 2u, 4u, 8u, 16u, 32u }) {
+    const auto parallel = thing::benchmark::best_of(iterations, [&] {
+      thing::benchmark::do_not_optimize(thing::lexing::parallel_tokenize(script, threads).size());
+    });
+    fmt::print(
+      "parallel_tokenize, {:2} threads: {:10.3f} ms ({:.2f}x)\n", threads, parallel * 1000, sequential / parallel);
+  }
+}
@@ -0,0 +1,39 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <parallel_parser.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+// Scaling of parallel_parse_definitions from 1 to 32 threads on a large
+// generated script, which is tokenized up front
+int main()
+{
+  constexpr int iterations = 5;
+  const auto script = thing::benchmark::make_script(std::size_t{ 16 } * 1024 * 1024);
+  const auto tokens = thing::lexing::tokenize(script);
+
+  fmt::print("input: {} bytes, {} tokens, {} hardware threads\n",
+    script.size(),
+    tokens.size(),
+    std::thread::hardware_concurrency());
+
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto sequential = thing::benchmark::best_of(
+    iterations, [&] { thing::benchmark::do_not_optimize(parser.parse_definitions(tokens).size()); });
+  fmt::print("parse_definitions:                     {:10.3f} ms\n", sequential * 1000);
+
+  for (const std::size_t threads : { 1u, 2u, 4u, 8u, 16u, 32u }) {
+    const auto parallel = thing::benchmark::best_of(iterations, [&] {
+      thing::benchmark::do_not_optimize(thing::parsing::parallel_parse_definitions(parser, tokens, threads).size());
+    });
+    fmt::print("parallel_parse_definitions, {:2} threads: {:10.3f} ms ({:.2f}x)\n",
+      threads,
+      parallel * 1000,
+      sequential / parallel);
+  }
+}
@@ -0,0 +1,68 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <flat_parse_tree.hpp>
+#include <parse_arena.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+// Parses `script` `count` times, as a service handling requests does, with
+// the default allocator and with a parse_arena that is reset between parses
+void compare(const std::string_view name, const std::string_view script, const int count)
+{
+  constexpr int iterations = 5;
+
+  const auto heap = thing::benchmark::best_of(iterations, [&] {
+    for (int index = 0; index < count; ++index) {
+      thing::parsing::basic_parser<std::vector> parser;
+      thing::benchmark::do_not_optimize(parser.parse(script));
+    }
+  });
+
+  thing::parsing::parse_arena arena{ std::size_t{ 1024 } * 1024 };
+  const auto pmr = thing::benchmark::best_of(iterations, [&] {
+    for (int index = 0; index < count; ++index) {
+      {
+        thing::parsing::pmr_parser parser{ arena.allocator() };
+        thing::benchmark::do_not_optimize(parser.parse(script));
+      }
+      arena.reset();
+    }
+  });
+
+  const auto flat_heap = thing::benchmark::best_of(iterations, [&] {
+    for (int index = 0; index < count; ++index) {
+      thing::parsing::basic_flat_parser<std::vector> parser;
+      thing::benchmark::do_not_optimize(parser.parse(script));
+    }
+  });
+
+  const auto flat_pmr = thing::benchmark::best_of(iterations, [&] {
+    for (int index = 0; index < count; ++index) {
+      {
+        thing::parsing::basic_flat_parser<std::pmr::vector> parser{ arena.allocator() };
+        thing::benchmark::do_not_optimize(parser.parse(script));
+      }
+      arena.reset();
+    }
+  });
+
+  const auto per_parse = [&](const double seconds) { return seconds * 1e6 / count; };
+  fmt::print("{}, {} bytes, us per parse\n", name, script.size());
+  fmt::print("  parse_nodes, default allocator: {:10.2f}\n", per_parse(heap));
+  fmt::print("  parse_nodes, parse_arena:       {:10.2f}\n", per_parse(pmr));
+  fmt::print("  flat tree, default allocator:   {:10.2f}\n", per_parse(flat_heap));
+  fmt::print("  flat tree, parse_arena:         {:10.2f}\n", per_parse(flat_pmr));
+}
+}// namespace
+
+int main()
+{
+  compare("one line", R"(if (x > y && y != 5) { print("Hello \"World\"", 1.5e3); } else { call(x, y, z); })", 20000);
+  compare("statement block", thing::benchmark::make_statement_block(8 * 1024), 500);
+}
@@ -0,0 +1,67 @@
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <parse_cache.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+// Starting a worker over a few thousand scripts: parsing all of them, parsing
+// them into an empty cache (cold start), and loading them from a full one
+// (warm start). The cache directory is in the page cache for the warm start,
+// as it is for workers that restart on the same machine.
+int main()
+{
+  constexpr int iterations = 5;
+  constexpr std::size_t script_count = 2000;
+
+  std::vector<std::string> scripts;
+  std::size_t total_size = 0;
+  for (std::size_t script = 0; script < script_count; ++script) {
+    auto source = thing::benchmark::make_statement_block(std::size_t{ 8 } * 1024);
+    // distinct sources, so that every script has an entry of its own
+    source.replace(4, 4, std::to_string(script));
+    total_size += source.size();
+    scripts.push_back(std::move(source));
+  }
+
+  const auto directory = std::filesystem::temp_directory_path() / "thing_parse_cache_benchmark";
+  fmt::print("input: {} scripts, {} bytes\n", script_count, total_size);
+
+  const auto parse = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_flat_parser<std::vector> parser;
+    for (const auto &source : scripts) {
+      thing::benchmark::do_not_optimize(parser.parse(thing::lexing::tokenize(source)));
+    }
+  });
+
+  std::size_t hits = 0;
+  const auto load_all = [&] {
+    const thing::parse_cache cache{ directory };
+    hits = 0;
+    for (const auto &source : scripts) {
+      const auto parsed = cache.parse(source);
+      if (parsed.hit) { ++hits; }
+      thing::benchmark::do_not_optimize(parsed);
+    }
+  };
+
+  double cold = 0;
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    std::filesystem::remove_all(directory);
+    const auto time = thing::benchmark::best_of(1, load_all);
+    cold = iteration == 0 ? time : std::min(cold, time);
+  }
+  const auto cold_hits = hits;
+
+  const auto warm = thing::benchmark::best_of(iterations, load_all);
+  std::filesystem::remove_all(directory);
+
+  fmt::print("parse only:  {:10.3f} ms\n", parse * 1000);
+  fmt::print("cold start:  {:10.3f} ms ({} hits)\n", cold * 1000, cold_hits);
+  fmt::print("warm start:  {:10.3f} ms ({} hits)\n", warm * 1000, hits);
+}
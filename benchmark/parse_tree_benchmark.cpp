@@ -0,0 +1,76 @@
+#include <cstddef>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <flat_parse_tree.hpp>
+#include <parse_events.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+// what a consumer that only wants the lengths of the tokens keeps
+struct length_handler : thing::parsing::parse_event_handler
+{
+  std::size_t total{ 0 };
+
+  void leave_node(const thing::parsing::event_node &node) { total += node.item.match.size(); }
+};
+
+// visits every node through the children of its parent, the way dump() and
+// the AST builders do
+template<typename Node> std::size_t walk(const Node &node)
+{
+  std::size_t total = node.item.match.size();
+  for (const auto &child : node.children) { total += walk(child); }
+  return total;
+}
+}// namespace
+
+// Parsing into one basic_parse_node per node against parsing into a single
+// flat array, and walking each of the resulting trees, and against parsing
+// into events that build no tree at all
+int main()
+{
+  constexpr int iterations = 5;
+  const auto script = thing::benchmark::make_statement_block(std::size_t{ 4 } * 1024 * 1024);
+
+  const auto node_parse = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_parser<std::vector> parser;
+    thing::benchmark::do_not_optimize(parser.parse(script));
+  });
+  const auto flat_parse = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_flat_parser<std::vector> parser;
+    thing::benchmark::do_not_optimize(parser.parse(script));
+  });
+  const auto event_parse = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_event_parser<std::vector, length_handler> parser;
+    thing::benchmark::do_not_optimize(parser.parse(script));
+    thing::benchmark::do_not_optimize(parser.builder.handler.total);
+  });
+
+  thing::parsing::basic_parser<std::vector> node_parser;
+  const auto nodes = node_parser.parse(script);
+  thing::parsing::basic_flat_parser<std::vector> flat_parser;
+  const auto tree = flat_parser.parse(script);
+
+  const auto node_walk =
+    thing::benchmark::best_of(iterations, [&] { thing::benchmark::do_not_optimize(walk(nodes)); });
+  const auto flat_walk =
+    thing::benchmark::best_of(iterations, [&] { thing::benchmark::do_not_optimize(walk(tree.root())); });
+  // code that does not care about the shape of the tree can just scan it
+  const auto flat_scan = thing::benchmark::best_of(iterations, [&] {
+    std::size_t total = 0;
+    for (const auto &node : tree.nodes) { total += node.length; }
+    thing::benchmark::do_not_optimize(total);
+  });
+
+  fmt::print("input: {} bytes, {} nodes\n", script.size(), tree.size());
+  fmt::print("parse, parse_nodes:    {:10.3f} ms\n", node_parse * 1000);
+  fmt::print("parse, flat tree:      {:10.3f} ms\n", flat_parse * 1000);
+  fmt::print("parse, events:         {:10.3f} ms\n", event_parse * 1000);
+  fmt::print("walk, parse_nodes:     {:10.3f} ms\n", node_walk * 1000);
+  fmt::print("walk, flat tree views: {:10.3f} ms\n", flat_walk * 1000);
+  fmt::print("scan, flat tree:       {:10.3f} ms\n", flat_scan * 1000);
+}
@@ -0,0 +1,32 @@
+#include <array>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+// Left associative operator chains, `a0 + a1 + ... + an`, each of which nests
+// the whole expression so far as the left operand of the next operator.
+// Parsing time per term should not depend on the length of the chain.
+int main()
+{
+  constexpr int iterations = 5;
+
+  for (const std::size_t terms : std::array<std::size_t, 4>{ 1250, 2500, 5000, 10000 }) {
+    std::string expression = "a0";
+    for (std::size_t term = 1; term < terms; ++term) { expression += " + a" + std::to_string(term); }
+
+    const auto parse = thing::benchmark::best_of(iterations, [&] {
+      thing::parsing::basic_parser<std::vector> parser;
+      thing::benchmark::do_not_optimize(parser.parse(expression));
+    });
+
+    fmt::print("{:>6} terms: {:10.3f} ms, {:8.1f} ns per term\n",
+      terms,
+      parse * 1000,
+      parse * 1e9 / static_cast<double>(terms));
+  }
+}
@@ -0,0 +1,61 @@
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <parse_node.hpp>
+#include <parser.hpp>
+#include <pipeline.hpp>
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+// stands in for lowering: visits every node, and frees the tree afterwards
+std::size_t count_nodes(const thing::parsing::basic_parse_node<std::vector> &node)
+{
+  std::size_t result = 1;
+  for (const auto &child : node.children) { result += count_nodes(child); }
+  return result;
+}
+}// namespace
+
+// Lexing, parsing and lowering a large generated script one stage after the
+// other, and as a pipeline with a thread per stage
+int main()
+{
+  constexpr int iterations = 5;
+  const auto script = thing::benchmark::make_script(std::size_t{ 16 } * 1024 * 1024);
+  const auto megabytes = static_cast<double>(script.size()) / (1024.0 * 1024.0);
+
+  fmt::print("input: {} bytes, {} hardware threads\n", script.size(), std::thread::hardware_concurrency());
+
+  thing::parsing::basic_parser<std::vector> parser;
+  std::size_t nodes = 0;
+  const auto lower = [&](thing::parsing::basic_parse_node<std::vector> &&definition) {
+    nodes += count_nodes(definition);
+  };
+
+  const auto sequential = thing::benchmark::best_of(iterations, [&] {
+    nodes = 0;
+    for (auto &definition : parser.parse_definitions(thing::lexing::tokenize(script))) { lower(std::move(definition)); }
+    thing::benchmark::do_not_optimize(nodes);
+  });
+  fmt::print("sequential:                    {:10.3f} ms {:8.1f} MiB/s\n", sequential * 1000, megabytes / sequential);
+
+  for (const std::size_t chunk_tokens : { 1024u, 16u * 1024, 256u * 1024 }) {
+    const auto pipelined = thing::benchmark::best_of(iterations, [&] {
+      nodes = 0;
+      thing::benchmark::do_not_optimize(
+        thing::parsing::pipelined_parse_definitions(parser, script, lower, chunk_tokens).size());
+      thing::benchmark::do_not_optimize(nodes);
+    });
+    fmt::print("pipelined, {:6} token chunks: {:10.3f} ms {:8.1f} MiB/s ({:.2f}x)\n",
+      chunk_tokens,
+      pipelined * 1000,
+      megabytes / pipelined,
+      sequential / pipelined);
+  }
+}
@@ -0,0 +1,61 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+// Single character edits at random positions of a large file, as typed in an
+// editor, with a full tokenize and with relex after every keystroke
+int main()
+{
+  constexpr int iterations = 5;
+  constexpr int keystrokes = 200;
+  const auto script = thing::benchmark::make_script(std::size_t{ 4 } * 1024 * 1024);
+
+  // every keystroke inserts a character and the next one removes it again, so
+  // the two buffers can be prepared up front
+  //
+  // edits are made right after a letter, as when typing a name. A stray character elsewhere can start an unknown token,
+  // which runs to the end of the buffer and has to be relexed entirely.
+  std::mt19937 random{ 1 };
+  std::vector<std::size_t> positions;
+  while (positions.size() < keystrokes / 2) {
+    const auto position = std::uniform_int_distribution<std::size_t>{ 1, script.size() }(random);
+    if (thing::lexing::classify(script[position - 1]) == thing::lexing::char_class::identifier_start) {
+      positions.push_back(position);
+    }
+  }
+
+  std::vector<std::string> edited;
+  for (const auto position : positions) { edited.push_back(std::string{ script }.insert(position, "x")); }
+
+  fmt::print("input: {} bytes, {} keystrokes\n", script.size(), keystrokes);
+
+  const auto full = thing::benchmark::best_of(iterations, [&] {
+    for (const auto &source : edited) {
+      thing::benchmark::do_not_optimize(thing::lexing::tokenize(source).size());
+      thing::benchmark::do_not_optimize(thing::lexing::tokenize(script).size());
+    }
+  });
+
+  // every pair of edits restores the buffer, so it can be reused between runs
+  auto tokens = thing::lexing::tokenize(script);
+  std::size_t relexed = 0;
+  const auto incremental = thing::benchmark::best_of(iterations, [&] {
+    relexed = 0;
+    for (std::size_t index = 0; index < positions.size(); ++index) {
+      relexed += thing::lexing::relex(tokens, edited[index], { positions[index], 0, "x" }).inserted;
+      relexed += thing::lexing::relex(tokens, script, { positions[index], 1, "" }).inserted;
+    }
+    thing::benchmark::do_not_optimize(tokens.size());
+  });
+
+  fmt::print("full tokenize per keystroke: {:10.3f} ms\n", full * 1000 / keystrokes);
+  fmt::print("relex per keystroke:         {:10.3f} ms ({:.1f} tokens relexed)\n",
+    incremental * 1000 / keystrokes,
+    static_cast<double>(relexed) / keystrokes);
+}
@@ -0,0 +1,97 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <incremental_parse.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+// Single character edits to the names in a large block of statements, with a
+// full tokenize and parse and with relex and reparse after every keystroke,
+// both from one buffer to another and in place
+int main()
+{
+  constexpr int iterations = 5;
+  constexpr int keystrokes = 200;
+
+  std::string script = "if (true) {\n";
+  for (std::size_t statement = 0; script.size() < std::size_t{ 1024 } * 1024; ++statement) {
+    const auto id = std::to_string(statement);
+    script += "  call_" + id + "(value_" + id + ", (x * 15 + 0xAF12) / (y - 3.1415e2f));\n";
+    script += "  while (x > y && y != " + id + ") { print(\"Hello \\\"World\\\"\"); x - 1; }\n";
+  }
+  script += "}\n";
+
+  // every keystroke inserts a character after a letter of a name, and the next
+  // one removes it again, so the two buffers can be prepared up front
+  std::mt19937 random{ 1 };
+  std::vector<std::size_t> positions;
+  while (positions.size() < keystrokes / 2) {
+    const auto position = std::uniform_int_distribution<std::size_t>{ 1, script.size() - 1 }(random);
+    if (thing::lexing::classify(script[position - 1]) == thing::lexing::char_class::identifier_start) {
+      positions.push_back(position);
+    }
+  }
+
+  std::vector<std::string> edited;
+  for (const auto position : positions) {
+    edited.push_back(script.substr(0, position) + "x" + script.substr(position));
+  }
+
+  fmt::print("input: {} bytes, {} keystrokes\n", script.size(), keystrokes);
+
+  const auto full = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_parser<std::vector> parser;
+    for (const auto &source : edited) {
+      thing::benchmark::do_not_optimize(parser.parse(thing::lexing::tokenize(source)));
+      thing::benchmark::do_not_optimize(parser.parse(thing::lexing::tokenize(script)));
+    }
+  });
+
+  // every pair of edits restores the buffer, so the tree can be reused between
+  // runs
+  thing::parsing::basic_parser<std::vector> parser;
+  auto tokens = thing::lexing::tokenize(script);
+  auto tree = parser.parse(tokens);
+  std::size_t reparsed = 0;
+  std::size_t whole_script = 0;
+  const auto incremental = thing::benchmark::best_of(iterations, [&] {
+    reparsed = 0;
+    whole_script = 0;
+    const auto count = [&](const auto &result) {
+      reparsed += result.inserted;
+      if (result.whole_script) { ++whole_script; }
+    };
+    for (std::size_t index = 0; index < positions.size(); ++index) {
+      count(thing::parsing::reparse(parser, tree, tokens, edited[index], { positions[index], 0, "x" }));
+      count(thing::parsing::reparse(parser, tree, tokens, script, { positions[index], 1, "" }));
+    }
+    thing::benchmark::do_not_optimize(tree);
+  });
+
+  // the edits of an editor, to one buffer, which only moves the nodes after
+  // each edit
+  std::string buffer = script;
+  buffer.reserve(script.size() + 1);
+  tokens = thing::lexing::tokenize(buffer);
+  tree = parser.parse(tokens);
+  const auto in_place = thing::benchmark::best_of(iterations, [&] {
+    for (const auto position : positions) {
+      buffer.insert(position, 1, 'x');
+      thing::benchmark::do_not_optimize(thing::parsing::reparse(parser, tree, tokens, buffer, { position, 0, "x" }));
+      buffer.erase(position, 1);
+      thing::benchmark::do_not_optimize(thing::parsing::reparse(parser, tree, tokens, buffer, { position, 1, "" }));
+    }
+    thing::benchmark::do_not_optimize(tree);
+  });
+
+  fmt::print("full parse per keystroke: {:10.3f} ms\n", full * 1000 / keystrokes);
+  fmt::print("reparse per keystroke:    {:10.3f} ms ({:.1f} statements reparsed, {} whole script)\n",
+    incremental * 1000 / keystrokes,
+    static_cast<double>(reparsed) / keystrokes,
+    whole_script);
+  fmt::print("reparse in place:         {:10.3f} ms\n", in_place * 1000 / keystrokes);
+}
@@ -0,0 +1,110 @@
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <ast.hpp>
+#include <containers.hpp>
+#include <flat_parse_tree.hpp>
+#include <lex_item.hpp>
+#include <parser.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+std::size_t allocations = 0;
+}// namespace
+
+void *operator new(const std::size_t size)
+{
+  ++allocations;
+  if (auto *result = std::malloc(size)) { return result; }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+namespace {
+template<typename Func> void report(const std::string_view name, const int count, Func &&func)
+{
+  constexpr int iterations = 5;
+  allocations = 0;
+  func();
+  const auto allocated = allocations;
+  const auto time = thing::benchmark::best_of(iterations, func);
+  fmt::print("  {:28} {:10.3f} us, {:8.2f} allocations\n",
+    name,
+    time * 1e6 / count,
+    static_cast<double>(allocated) / count);
+}
+
+// Containers of 0, 1 or 2 tokens, in the proportions of the children of parse
+// nodes: mostly leaves, then binary and prefix operators
+template<typename Container> void fill_containers(const int count)
+{
+  const thing::lexing::lex_item item{ thing::lexing::token_type::identifier, "name", {} };
+  for (int index = 0; index < count; ++index) {
+    Container container;
+    const auto size = index % 4 == 0 ? 2 : index % 4 == 1 ? 1 : 0;
+    for (int element = 0; element < size; ++element) { container.push_back(item); }
+    thing::benchmark::do_not_optimize(container);
+  }
+}
+
+// A new parser for one script, as when every script is compiled on its own
+template<template<class> class Container_Type> void parse_scripts(const std::string_view script, const int count)
+{
+  for (int index = 0; index < count; ++index) {
+    thing::parsing::basic_flat_parser<Container_Type> parser;
+    thing::benchmark::do_not_optimize(parser.parse(script));
+  }
+}
+
+// A new AST builder for the function `tree` holds
+template<template<class> class Container_Type>
+void build_functions(const thing::parsing::basic_flat_parse_tree<Container_Type> &tree, const int count)
+{
+  using tree_type = thing::parsing::basic_flat_parse_tree<Container_Type>;
+  using builder_type = thing::ast::basic_ast_builder<Container_Type, typename tree_type::node_view>;
+  for (int index = 0; index < count; ++index) {
+    builder_type builder;
+    thing::benchmark::do_not_optimize(builder.build_function_ast(tree.root()));
+  }
+}
+}// namespace
+
+// Allocations and time of small_vector against std::vector, on its own and
+// as the Container_Type of a flat parser and an AST builder. A parser that
+// builds basic_parse_nodes cannot use it, see small_vector.
+int main()
+{
+  constexpr int containers = 1000000;
+  fmt::print("per container of 0-2 tokens\n");
+  report("std::vector", containers, [] { fill_containers<std::vector<thing::lexing::lex_item>>(containers); });
+  report("small_vector<2>", containers, [] {
+    fill_containers<thing::small_vector<thing::lexing::lex_item, 2>>(containers);
+  });
+
+  constexpr int scripts = 100000;
+  constexpr std::string_view script =
+    "if (x > y && y != 5) { print(\"Hello\", (x * 15 + 0xAF12) / -(y - 3.1415e2f)); }";
+  fmt::print("per parse of a {} byte script into a flat tree, with a new parser\n", script.size());
+  report("std::vector", scripts, [&] { parse_scripts<std::vector>(script, scripts); });
+  report("small_vector_2", scripts, [&] { parse_scripts<thing::small_vector_2>(script, scripts); });
+
+  constexpr int functions = 100000;
+  constexpr std::string_view function = "auto f(auto x, auto y, auto z) { if (x > y && y != 5) {"
+                                        " while (x < z) { print(\"Hello\", x); } g(x, z, 0B1010101, 123.42E1l);"
+                                        " } else { for (auto i{ 0 }; i < z; i + 1) { print(i); } } }";
+  thing::parsing::basic_flat_parser<std::vector> vector_parser;
+  thing::parsing::basic_flat_parser<thing::small_vector_2> small_vector_parser;
+  const auto vector_tree = vector_parser.parse(function);
+  const auto small_vector_tree = small_vector_parser.parse(function);
+  fmt::print("per AST of a {} byte function, with a new builder\n", function.size());
+  report("std::vector", functions, [&] { build_functions(vector_tree, functions); });
+  report("small_vector_2", functions, [&] { build_functions(small_vector_tree, functions); });
+}
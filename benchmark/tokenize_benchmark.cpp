@@ -0,0 +1,54 @@
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <parser.hpp>
+#include <token_buffer.hpp>
+
+#include "benchmark.hpp"
+
+int main()
+{
+  constexpr int iterations = 10;
+  const auto script = thing::benchmark::make_statement_block(std::size_t{ 4 } * 1024 * 1024);
+
+  const auto tokens = thing::lexing::tokenize(script);
+  constexpr auto bytes_per_token =
+    sizeof(thing::lexing::token_type) + 2 * sizeof(std::uint32_t) + sizeof(thing::lexing::symbol_id);
+  const auto buffer_bytes = tokens.size() * bytes_per_token;
+  const auto item_bytes = tokens.size() * sizeof(thing::lexing::lex_item);
+
+  fmt::print("input: {} bytes, {} tokens\n", script.size(), tokens.size());
+  fmt::print("token memory: lex_item {} bytes, token_buffer {} bytes ({:.1f}x smaller)\n",
+    item_bytes,
+    buffer_bytes,
+    static_cast<double>(item_bytes) / static_cast<double>(buffer_bytes));
+
+  const auto lex_items = thing::benchmark::best_of(iterations, [&] {
+    std::vector<thing::lexing::lex_item> items;
+    for (auto item = thing::parsing::basic_parser<std::vector>::next_token(script);;
+         item = thing::parsing::basic_parser<std::vector>::next_token(item.remainder)) {
+      items.push_back(item);
+      if (item.type == thing::lexing::token_type::end_of_file) { break; }
+    }
+    thing::benchmark::do_not_optimize(items);
+  });
+  const auto tokenize = thing::benchmark::best_of(
+    iterations, [&] { thing::benchmark::do_not_optimize(thing::lexing::tokenize(script)); });
+
+  fmt::print("lex into vector<lex_item>: {:8.3f} ms\n", lex_items * 1000);
+  fmt::print("tokenize:                  {:8.3f} ms\n", tokenize * 1000);
+
+  const auto lazy_parse = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_parser<std::vector> parser;
+    thing::benchmark::do_not_optimize(parser.parse(script));
+  });
+  const auto buffer_parse = thing::benchmark::best_of(iterations, [&] {
+    thing::parsing::basic_parser<std::vector> parser;
+    thing::benchmark::do_not_optimize(parser.parse(tokens));
+  });
+
+  fmt::print("parse (lexing on demand):  {:8.3f} ms\n", lazy_parse * 1000);
+  fmt::print("parse (token_buffer):      {:8.3f} ms\n", buffer_parse * 1000);
+}
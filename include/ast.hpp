@@ -1,17 +1,38 @@
 #ifndef THING_AST_HPP
 #define THING_AST_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <type_traits>
 #include <variant>
-#include <vector>
 #include <string_view>
+
+#include "containers.hpp"
 #include "lex_item.hpp"
 #include "parse_node.hpp"
+#include "string_literal.hpp"
+#include "symbol_table.hpp"
 
 namespace thing::ast {
 
-// todo: I think we can remove this class altogether and use
-// function argument deduction for all of the ast_building functions
-template<template<class> class Container_Type> struct basic_ast_builder
+// Builds ASTs from parse trees, into pools that it owns.
+//
+// Every kind of node has a pool of its own, in which the nodes of that kind
+// are contiguous, and nodes refer to their children by 32-bit handles into
+// the pools: an expression or a statement is a variant of handles, and lists
+// of them are handle ranges. Nodes stay valid as long as the builder, which
+// releases all of them at once, with one deallocation per pool, or none at
+// all when its allocator draws from a parse_arena. `nodes[handle]` looks a
+// node up. The values of string literals with escapes are decoded into
+// `strings`, which the builder owns as well.
+//
+// Parse_Node is either basic_parse_node or the node_view of a
+// basic_flat_parse_tree, the builders only use the members the two share.
+template<template<class> class Container_Type, typename Parse_Node = parsing::basic_parse_node<Container_Type>>
+struct basic_ast_builder
 {
   struct variable_declaration;
   struct variable_definition;
@@ -26,19 +47,26 @@ template<template<class> class Container_Type> struct basic_ast_builder
 
   //  using allocator_type = typename container_type::allocator_type;
 
-  using parse_node = parsing::basic_parse_node<Container_Type>;
-  using allocator_type = typename parse_node::allocator_type;
+  using parse_node = Parse_Node;
+  using allocator_type = typename lexing::basic_string_arena<Container_Type>::allocator_type;
+
+  // flat tree nodes are views already, and are often temporaries
+  using node_reference = std::conditional_t<std::is_same_v<parse_node, parsing::basic_parse_node<Container_Type>>,
+    std::reference_wrapper<const parse_node>,
+    parse_node>;
 
   struct parse_error
   {
     std::string_view error_description;
-    std::reference_wrapper<const parse_node> error_location;
+    node_reference error_location;
   };
 
   struct compound_statement;
   struct literal_value
   {
     lexing::lex_item value;
+    // the value of a string literal, a view into the source or into `strings`
+    std::string_view text;
   };
 
   struct identifier
@@ -46,25 +74,29 @@ template<template<class> class Container_Type> struct basic_ast_builder
     lexing::lex_item id;
   };
 
-  using expression = std::variant<function_call, prefix_operator, infix_operator, literal_value, identifier>;
+  using expression = std::variant<handle<function_call>,
+    handle<prefix_operator>,
+    handle<infix_operator>,
+    handle<literal_value>,
+    handle<identifier>>;
 
   struct function_call
   {
-    std::unique_ptr<expression> function;
-    Container_Type<expression> parameters;
+    expression function;
+    handle_range<expression> parameters;
   };
 
   struct prefix_operator
   {
     lexing::lex_item op;
-    std::unique_ptr<expression> operand;
+    expression operand;
   };
 
   struct infix_operator
   {
-    std::unique_ptr<expression> lhs_operand;
+    expression lhs_operand;
     lexing::lex_item op;
-    std::unique_ptr<expression> rhs_operand;
+    expression rhs_operand;
   };
 
   template<typename... Types> struct merge_types
@@ -123,47 +155,13 @@ template<template<class> class Container_Type> struct basic_ast_builder
   }
 
 
-  template<typename Func> struct parser
-  {
-    Func func;
-
-    [[nodiscard]] constexpr auto parse(const parse_node &node, allocator_type alloc) const { return func(node, alloc); }
-
-    template<typename RHS> consteval auto operator|(const parser<RHS> &rhs)
-    {
-      using return_type = merge_types_t<decltype(parse(std::declval<parse_node>(), std::declval<allocator_type>())),
-        decltype(rhs.parse(std::declval<parse_node>(), std::declval<allocator_type>()))>;
-
-      auto combined = [lhs = *this, rhs](const parse_node &node, allocator_type alloc) -> return_type {
-        auto lhs_result = lhs.parse(node, alloc);
-        if (is_parse_error(lhs_result)) {
-          auto rhs_result = rhs.parse(node, alloc);
-          if (is_parse_error(rhs_result)) {
-            return parse_error{ "Unexpected expression", node };
-          } else {
-            return return_current_value<return_type>(std::move(rhs_result));
-          }
-        } else {
-          return return_current_value<return_type>(std::move(lhs_result));
-        }
-      };
-
-      return make_parser(combined);
-    }
-  };
-
-  template<typename Func> [[nodiscard]] static constexpr auto make_parser(Func &&f) noexcept
-  {
-    return parser<std::decay_t<Func>>{ std::move(f) };
-  }
-
   // we should probably remove this one and only use the visit_non_error_values version, tbd
 
   template<typename Value> static constexpr void visit_non_error_value(Value &&value, auto &&visitor)
   {
     std::visit(
       [&]<typename Inner>(Inner &&inner) -> void {
-        if constexpr (!std::is_same_v<Inner, parse_error>) { visitor(inner); }
+        if constexpr (!std::is_same_v<std::remove_cvref_t<Inner>, parse_error>) { visitor(inner); }
       },
       std::forward<Value>(value));
   }
@@ -193,47 +191,53 @@ template<template<class> class Container_Type> struct basic_ast_builder
   }
 
 
-  using statement =
-    merge_types_t<expression, variable_definition, if_statement, for_statement, while_statement, compound_statement>;
-  using init_statement = merge_types_t<expression, variable_definition>;
+  using statement = merge_types_t<expression,
+    handle<variable_definition>,
+    handle<if_statement>,
+    handle<for_statement>,
+    handle<while_statement>,
+    handle<compound_statement>>;
+  using init_statement = merge_types_t<expression, handle<variable_definition>>;
 
   struct compound_statement
   {
-    std::vector<statement> statements;
+    handle_range<statement> statements;
   };
 
   struct if_statement
   {
-    std::unique_ptr<init_statement> init;
+    std::optional<init_statement> init;
     expression condition;
-    std::unique_ptr<statement> true_case;
-    std::unique_ptr<statement> false_case;
+    statement true_case;
+    std::optional<statement> false_case;
   };
 
   struct for_statement
   {
-    std::unique_ptr<init_statement> init;
+    init_statement init;
     expression condition;
     expression loop_expression;
-    std::unique_ptr<statement> body;
+    statement body;
   };
 
   struct while_statement
   {
     expression condition;
-    std::unique_ptr<statement> body;
+    statement body;
   };
 
-  struct function_definition
+  struct variable_declaration
   {
     lexing::lex_item name;
-    Container_Type<variable_declaration> parameters;
-    std::unique_ptr<statement> body;
   };
 
-  struct variable_declaration
+  using parameter_list = handle_range<variable_declaration>;
+
+  struct function_definition
   {
     lexing::lex_item name;
+    parameter_list parameters;
+    statement body;
   };
 
   struct variable_definition
@@ -242,49 +246,186 @@ template<template<class> class Container_Type> struct basic_ast_builder
     expression initial_value;
   };
 
+  typed_pools<Container_Type,
+    function_call,
+    prefix_operator,
+    infix_operator,
+    literal_value,
+    identifier,
+    compound_statement,
+    if_statement,
+    for_statement,
+    while_statement,
+    variable_definition,
+    function_definition,
+    expression,
+    statement,
+    variable_declaration>
+    nodes;
+  lexing::basic_string_arena<Container_Type> strings;
+
+  constexpr basic_ast_builder() = default;
+  constexpr explicit basic_ast_builder(allocator_type alloc) : nodes(alloc), strings(alloc) {}
+
+  // A list that is built up before it is appended to a pool, which keeps its
+  // first Capacity elements inline and draws from the pools' memory past them
+  template<typename Type, std::size_t Capacity>
+  [[nodiscard]] constexpr small_vector<Type, Capacity, typename Container_Type<Type>::allocator_type>
+    scratch_list() const noexcept
+  {
+    return small_vector<Type, Capacity, typename Container_Type<Type>::allocator_type>(
+      nodes.template get_allocator<Type>());
+  }
+
+
+  // Which builder takes a node. Every node is handed to exactly one builder,
+  // chosen from its token type, or from the keyword for keywords; there is no
+  // trying one builder after another until something fits.
+  enum struct node_kind : std::uint8_t {
+    unsupported,
+    literal_value,
+    identifier,
+    // prefix or infix, by the number of operands
+    operator_,
+    function_call,
+    compound_statement,
+    variable_definition,
+    if_statement,
+    for_statement,
+    while_statement
+  };
+
+  [[nodiscard]] static consteval std::array<node_kind, lexing::token_type_count> make_token_kinds()
+  {
+    std::array<node_kind, lexing::token_type_count> result{};
+    const auto set = [&result](const lexing::token_type type, const node_kind kind) {
+      result[static_cast<std::size_t>(type)] = kind;
+    };
+
+    set(lexing::token_type::number, node_kind::literal_value);
+    set(lexing::token_type::string, node_kind::literal_value);
+    set(lexing::token_type::identifier, node_kind::identifier);
+    for (const auto type : { lexing::token_type::plus,
+           lexing::token_type::minus,
+           lexing::token_type::asterisk,
+           lexing::token_type::slash,
+           lexing::token_type::caret,
+           lexing::token_type::less_than,
+           lexing::token_type::less_than_or_equal,
+           lexing::token_type::greater_than,
+           lexing::token_type::greater_than_or_equal,
+           lexing::token_type::equals,
+           lexing::token_type::not_equals,
+           lexing::token_type::logical_and,
+           lexing::token_type::logical_or }) {
+      set(type, node_kind::operator_);
+    }
+    set(lexing::token_type::left_brace, node_kind::compound_statement);
+    return result;
+  }
+
+  [[nodiscard]] static consteval std::array<node_kind, lexing::keyword_names.size()> make_keyword_kinds()
+  {
+    std::array<node_kind, lexing::keyword_names.size()> result{};
+    result[lexing::symbols::auto_] = node_kind::variable_definition;
+    result[lexing::symbols::if_] = node_kind::if_statement;
+    result[lexing::symbols::for_] = node_kind::for_statement;
+    result[lexing::symbols::while_] = node_kind::while_statement;
+    return result;
+  }
+
+  static constexpr auto token_kinds = make_token_kinds();
+  static constexpr auto keyword_kinds = make_keyword_kinds();
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, variable_declaration>
-    build_variable_decl(const parse_node &node, [[maybe_unused]] allocator_type alloc)
+  // The token type of the child of `node` at `index`. The children of a flat
+  // tree node only know where their next sibling starts, so they are skipped
+  // one subtree at a time, without materializing them.
+  [[nodiscard]] static constexpr lexing::token_type child_type(const parse_node &node, const std::size_t index)
   {
-    if (node.item.type != lexing::token_type::keyword || node.item.match != "auto" || node.children.size() != 1
+    if constexpr (std::is_same_v<parse_node, parsing::basic_parse_node<Container_Type>>) {
+      return node.children[index].item.type;
+    } else {
+      auto child = node.children.begin();
+      for (std::size_t skipped = 0; skipped < index; ++skipped) { ++child; }
+      return child.position->type;
+    }
+  }
+
+  // The kind of `node`, as if it only had its first `child_count` children.
+  // The parser puts the arguments of a call, a `(` list, under the node of the
+  // callee, so that a call is told apart by its last child rather than by its
+  // own token; the only other `(` child is the header of a control statement,
+  // which comes first and never last.
+  [[nodiscard]] static constexpr node_kind kind_of(const parse_node &node, const std::size_t child_count)
+  {
+    if (node.item.type == lexing::token_type::keyword) {
+      return node.item.symbol < keyword_kinds.size() ? keyword_kinds[node.item.symbol] : node_kind::unsupported;
+    }
+    if (child_count != 0 && child_type(node, child_count - 1) == lexing::token_type::left_paren) {
+      return node_kind::function_call;
+    }
+    return token_kinds[static_cast<std::size_t>(node.item.type)];
+  }
+
+  [[nodiscard]] static constexpr node_kind kind_of(const parse_node &node)
+  {
+    return kind_of(node, node.children.size());
+  }
+
+  [[nodiscard]] static constexpr bool is_keyword(const parse_node &node, const lexing::symbol_id keyword) noexcept
+  {
+    return node.item.type == lexing::token_type::keyword && node.item.symbol == keyword;
+  }
+
+  // moves the value of a builder's result, which must not be a parse_error,
+  // into `target`
+  template<typename Target, typename Result> static constexpr void assign(Target &target, Result &&result)
+  {
+    visit_non_error_value(std::forward<Result>(result), [&target](auto &value) { target = std::move(value); });
+  }
+
+  [[nodiscard]] static constexpr merge_types_t<parse_error, variable_declaration> build_variable_decl(
+    const parse_node &node)
+  {
+    if (!is_keyword(node, lexing::symbols::auto_) || node.children.size() != 1
         || node.children[0].item.type != lexing::token_type::identifier || !node.children[0].children.empty()) {
       return parse_error{ "Expected variable declaration in the form of `auto <identifier>`", node };
     }
 
-    return variable_declaration{ node.item };
+    return variable_declaration{ node.children[0].item };
   }
 
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, Container_Type<variable_declaration>>
-    build_variable_list(const parse_node &node, allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, parameter_list> build_variable_list(const parse_node &node)
   {
     if (node.item.type != lexing::token_type::left_paren) { return parse_error{ "expected parenthesized list", node }; }
 
-    Container_Type<variable_declaration> retval(alloc);
-    retval.reserve(node.children.size());
+    // most functions take a handful of parameters, which fit inline
+    auto parameters = scratch_list<variable_declaration, 4>();
+    parameters.reserve(node.children.size());
 
     for (const auto &child : node.children) {
-      auto decl = build_variable_decl(child, alloc);
+      auto decl = build_variable_decl(child);
       if (is_parse_error(decl)) { return std::get<parse_error>(decl); }
-      retval.push_back(std::get<variable_declaration>(decl));
+      parameters.push_back(std::get<variable_declaration>(decl));
     }
 
-    return retval;
+    return nodes.append(parameters);
   }
 
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, variable_definition>
-    build_variable_definition(const parse_node &node, allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<variable_definition>> build_variable_definition(
+    const parse_node &node)
   {
-    if (node.item.type == lexing::token_type::keyword && node.item.match == "auto" && node.children.size() == 1
+    if (is_keyword(node, lexing::symbols::auto_) && node.children.size() == 1
         && node.children[0].item.type == lexing::token_type::identifier && node.children[0].children.size() == 1
         && node.children[0].children[0].item.type == lexing::token_type::left_brace
         && node.children[0].children[0].children.size() == 1) {
       const auto name = node.children[0].item;
-      auto initial_expression = build_expression(node.children[0].children[0].children[0], alloc);
-      return visit_non_error_values<std::variant<parse_error, variable_definition>>(
-        [&name](auto &&initial) {
-          return variable_definition{ name, std::move(initial) };
+      auto initial_expression = build_expression(node.children[0].children[0].children[0]);
+      return visit_non_error_values<std::variant<parse_error, handle<variable_definition>>>(
+        [this, &name](auto &&initial) {
+          return nodes.add(variable_definition{ name, std::move(initial) });
         },
         initial_expression);
     } else {
@@ -294,108 +435,365 @@ template<template<class> class Container_Type> struct basic_ast_builder
     }
   }
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, function_call> build_function_call(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<function_call>> build_function_call(
+    const parse_node &node)
   {
-    return parse_error{ "Function call parsing not yet implemented", node };
+    return build_function_call(node, node.children.size());
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, prefix_operator>
-    build_prefix_operator(const parse_node &node, [[maybe_unused]] allocator_type alloc)
+
+  // `f(a)(b)` is a call of `f(a)`: the argument lists are the `(` children at
+  // the end, and the callee is the node without them. The children are walked
+  // once, from the first, however long the chain of calls is.
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<function_call>> build_function_call(
+    const parse_node &node,
+    const std::size_t child_count)
   {
-    return parse_error{ "Prefix operator parsing not yet implemented", node };
+    if (kind_of(node, child_count) != node_kind::function_call) {
+      return parse_error{ "Expected function call syntax: `<expression>(<parameter list...>)`", node };
+    }
+
+    auto argument_lists = scratch_list<node_reference, 4>();
+    std::size_t callee_child_count = 0;
+    std::size_t index = 0;
+    for (const auto &child : node.children) {
+      if (index++ == child_count) { break; }
+      if (child.item.type == lexing::token_type::left_paren) {
+        argument_lists.push_back(child);
+      } else {
+        argument_lists.clear();
+        callee_child_count = index;
+      }
+    }
+
+    auto callee = build_expression(node, callee_child_count);
+    if (is_parse_error(callee)) { return std::get<parse_error>(std::move(callee)); }
+    expression function;
+    assign(function, std::move(callee));
+
+    handle<function_call> call{};
+    for (const auto &list : argument_lists) {
+      const parse_node &arguments = list;
+      // the arguments are built before they are added to the pool, which their
+      // own calls add to as well
+      auto parameters = scratch_list<expression, 8>();
+      parameters.reserve(arguments.children.size());
+      for (const auto &argument : arguments.children) {
+        auto value = build_expression(argument);
+        if (is_parse_error(value)) { return std::get<parse_error>(std::move(value)); }
+        assign(parameters.emplace_back(), std::move(value));
+      }
+
+      call = nodes.add(function_call{ function, nodes.append(parameters) });
+      function = call;
+    }
+    return call;
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, infix_operator> build_infix_operator(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<prefix_operator>> build_prefix_operator(
+    const parse_node &node)
   {
-    return parse_error{ "Infix operator parsing not yet implemented", node };
+    return build_prefix_operator(node, node.children.size());
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, literal_value> build_literal_value(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<prefix_operator>> build_prefix_operator(
+    const parse_node &node,
+    const std::size_t child_count)
+  {
+    if ((node.item.type != lexing::token_type::plus && node.item.type != lexing::token_type::minus)
+        || child_count != 1) {
+      return parse_error{ "Expected prefix operator syntax: `+<expression>` or `-<expression>`", node };
+    }
+
+    auto operand = build_expression(node.children[0]);
+    if (is_parse_error(operand)) { return std::get<parse_error>(std::move(operand)); }
+    prefix_operator result{ node.item, {} };
+    assign(result.operand, std::move(operand));
+    return nodes.add(std::move(result));
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<infix_operator>> build_infix_operator(
+    const parse_node &node)
+  {
+    return build_infix_operator(node, node.children.size());
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<infix_operator>> build_infix_operator(
+    const parse_node &node,
+    const std::size_t child_count)
+  {
+    if (kind_of(node, child_count) != node_kind::operator_ || child_count != 2) {
+      return parse_error{ "Expected infix operator syntax: `<expression> <operator> <expression>`", node };
+    }
+
+    auto lhs = build_expression(node.children[0]);
+    if (is_parse_error(lhs)) { return std::get<parse_error>(std::move(lhs)); }
+    auto rhs = build_expression(node.children[1]);
+    if (is_parse_error(rhs)) { return std::get<parse_error>(std::move(rhs)); }
+    infix_operator result{ {}, node.item, {} };
+    assign(result.lhs_operand, std::move(lhs));
+    assign(result.rhs_operand, std::move(rhs));
+    return nodes.add(std::move(result));
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<literal_value>> build_literal_value(
+    const parse_node &node)
+  {
+    return build_literal_value(node, node.children.size());
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<literal_value>> build_literal_value(
+    const parse_node &node,
+    const std::size_t child_count)
+  {
+    if (node.is_error() || child_count != 0) { return parse_error{ "Expected literal value", node }; }
+
+    // numbers were decoded by the lexer, the token carries the value
+    if (node.item.type == lexing::token_type::number) { return nodes.add(literal_value{ node.item, {} }); }
+    if (node.item.type == lexing::token_type::string) {
+      const auto text = lexing::string_value(node.item.match, strings);
+      if (!text) { return parse_error{ "Invalid escape sequence in string literal", node }; }
+      return nodes.add(literal_value{ node.item, *text });
+    }
+    return parse_error{ "Expected literal value", node };
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<identifier>> build_identifier(const parse_node &node)
+  {
+    return build_identifier(node, node.children.size());
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<identifier>> build_identifier(const parse_node &node,
+    const std::size_t child_count)
+  {
+    if (node.item.type == lexing::token_type::identifier && !node.is_error() && child_count == 0) {
+      return nodes.add(identifier{ node.item });
+    }
+    return parse_error{ "Expected identifier", node };
+  }
+
+  // `(<condition>)`, with `max_elements` of 2 for `(<init>; <condition>)`
+  [[nodiscard]] static constexpr bool is_control_header(const parse_node &header, const std::size_t max_elements)
+  {
+    return header.item.type == lexing::token_type::left_paren && !header.children.empty()
+           && header.children.size() <= max_elements;
+  }
+
+  [[nodiscard]] constexpr std::variant<std::monostate, parse_error> build_condition(const parse_node &node,
+    expression &condition)
   {
-    return parse_error{ "Literal value parsing not yet implemented", node };
+    auto built = build_expression(node);
+    if (is_parse_error(built)) { return std::get<parse_error>(std::move(built)); }
+    assign(condition, std::move(built));
+    return std::monostate{};
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, identifier> build_identifier(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+
+  // `(<condition>)`
+  [[nodiscard]] constexpr std::variant<std::monostate, parse_error> build_while_header(const parse_node &node,
+    expression &condition)
   {
-    return parse_error{ "Identifier parsing not yet implemented", node };
+    const auto &header = node.children[0];
+    if (!is_control_header(header, 1)) { return parse_error{ "Expected `(<condition>)`", header }; }
+    return build_condition(header.children[0], condition);
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, while_statement>
-    build_while_statement(const parse_node &node, [[maybe_unused]] allocator_type alloc)
+
+  // `(<condition>)` or `(<init>; <condition>)`
+  [[nodiscard]] constexpr std::variant<std::monostate, parse_error> build_if_header(const parse_node &node,
+    std::optional<init_statement> &init,
+    expression &condition)
   {
-    return parse_error{ "While statement parsing not yet implemented", node };
+    const auto &header = node.children[0];
+    if (!is_control_header(header, 2)) { return parse_error{ "Expected `(<condition>)`", header }; }
+
+    if (header.children.size() == 2) {
+      auto built = build_init_statement(header.children[0]);
+      if (is_parse_error(built)) { return std::get<parse_error>(std::move(built)); }
+      assign(init.emplace(), std::move(built));
+    }
+    return build_condition(header.children.back(), condition);
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, for_statement> build_for_statement(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<while_statement>> build_while_statement(
+    const parse_node &node)
   {
-    return parse_error{ "For statement parsing not yet implemented", node };
+    if (!is_keyword(node, lexing::symbols::while_) || node.children.size() != 2) {
+      return parse_error{ "Expected while statement syntax: `while (<condition>) <statement>`", node };
+    }
+
+    while_statement result;
+    if (auto header = build_while_header(node, result.condition); is_parse_error(header)) {
+      return std::get<parse_error>(std::move(header));
+    }
+    auto body = build_statement(node.children[1]);
+    if (is_parse_error(body)) { return std::get<parse_error>(std::move(body)); }
+    assign(result.body, std::move(body));
+    return nodes.add(std::move(result));
   }
-  [[nodiscard]] static constexpr merge_types_t<parse_error, if_statement> build_if_statement(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<for_statement>> build_for_statement(
+    const parse_node &node)
   {
-    return parse_error{ "If statement parsing not yet implemented", node };
+    if (!is_keyword(node, lexing::symbols::for_) || node.children.size() != 2
+        || node.children[0].item.type != lexing::token_type::left_paren || node.children[0].children.size() != 3) {
+      return parse_error{
+        "Expected for statement syntax: `for (<init>; <condition>; <loop expression>) <statement>`", node
+      };
+    }
+
+    const auto &header = node.children[0];
+    auto init = build_init_statement(header.children[0]);
+    if (is_parse_error(init)) { return std::get<parse_error>(std::move(init)); }
+    auto condition = build_expression(header.children[1]);
+    if (is_parse_error(condition)) { return std::get<parse_error>(std::move(condition)); }
+    auto loop_expression = build_expression(header.children[2]);
+    if (is_parse_error(loop_expression)) { return std::get<parse_error>(std::move(loop_expression)); }
+    auto body = build_statement(node.children[1]);
+    if (is_parse_error(body)) { return std::get<parse_error>(std::move(body)); }
+
+    for_statement result;
+    assign(result.init, std::move(init));
+    assign(result.condition, std::move(condition));
+    assign(result.loop_expression, std::move(loop_expression));
+    assign(result.body, std::move(body));
+    return nodes.add(std::move(result));
   }
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, expression> build_expression(const parse_node &node,
-    [[maybe_unused]] allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<if_statement>> build_if_statement(const parse_node &node)
   {
-    return (make_parser(build_function_call) | make_parser(build_prefix_operator) | make_parser(build_infix_operator)
-            | make_parser(build_literal_value) | make_parser(build_identifier))
-      .parse(node, alloc);
+    if (!is_keyword(node, lexing::symbols::if_) || node.children.size() < 2 || node.children.size() > 3
+        || (node.children.size() == 3
+            && (!is_keyword(node.children[2], lexing::symbols::else_) || node.children[2].children.size() != 1))) {
+      return parse_error{ "Expected if statement syntax: `if (<condition>) <statement> [else <statement>]`", node };
+    }
+
+    if_statement result;
+    if (auto header = build_if_header(node, result.init, result.condition); is_parse_error(header)) {
+      return std::get<parse_error>(std::move(header));
+    }
+    auto true_case = build_statement(node.children[1]);
+    if (is_parse_error(true_case)) { return std::get<parse_error>(std::move(true_case)); }
+    assign(result.true_case, std::move(true_case));
+
+    if (node.children.size() == 3) {
+      auto false_case = build_statement(node.children[2].children[0]);
+      if (is_parse_error(false_case)) { return std::get<parse_error>(std::move(false_case)); }
+      assign(result.false_case.emplace(), std::move(false_case));
+    }
+    return nodes.add(std::move(result));
   }
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, statement> build_statement(const parse_node &node,
-    allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, expression> build_expression(const parse_node &node)
   {
-    return (make_parser(build_expression) | make_parser(build_variable_definition) | make_parser(build_if_statement)
-            | make_parser(build_for_statement) | make_parser(build_while_statement)
-            | make_parser(build_compound_statement))
-      .parse(node, alloc);
+    return build_expression(node, node.children.size());
+  }
+
+  // `node` as if it only had its first `child_count` children
+  [[nodiscard]] constexpr merge_types_t<parse_error, expression> build_expression(const parse_node &node,
+    const std::size_t child_count)
+  {
+    using result_type = merge_types_t<parse_error, expression>;
+
+    if (node.is_error()) { return parse_error{ "Syntax error", node }; }
+    switch (kind_of(node, child_count)) {
+    case node_kind::literal_value:
+      return return_current_value<result_type>(build_literal_value(node, child_count));
+    case node_kind::identifier:
+      return return_current_value<result_type>(build_identifier(node, child_count));
+    case node_kind::operator_:
+      if (child_count == 1) { return return_current_value<result_type>(build_prefix_operator(node, child_count)); }
+      return return_current_value<result_type>(build_infix_operator(node, child_count));
+    case node_kind::function_call:
+      return return_current_value<result_type>(build_function_call(node, child_count));
+    case node_kind::unsupported:
+    case node_kind::compound_statement:
+    case node_kind::variable_definition:
+    case node_kind::if_statement:
+    case node_kind::for_statement:
+    case node_kind::while_statement:
+      break;
+    }
+    return parse_error{ "Unexpected expression", node };
   }
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, compound_statement>
-    build_compound_statement(const parse_node &node, allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, init_statement> build_init_statement(const parse_node &node)
+  {
+    using result_type = merge_types_t<parse_error, init_statement>;
+
+    if (kind_of(node) == node_kind::variable_definition) {
+      return return_current_value<result_type>(build_variable_definition(node));
+    }
+    return return_current_value<result_type>(build_expression(node));
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, statement> build_statement(const parse_node &node)
+  {
+    using result_type = merge_types_t<parse_error, statement>;
+
+    if (node.is_error()) { return parse_error{ "Syntax error", node }; }
+    switch (kind_of(node)) {
+    case node_kind::literal_value:
+    case node_kind::identifier:
+    case node_kind::operator_:
+    case node_kind::function_call:
+      return return_current_value<result_type>(build_expression(node));
+    case node_kind::compound_statement:
+      return return_current_value<result_type>(build_compound_statement(node));
+    case node_kind::variable_definition:
+      return return_current_value<result_type>(build_variable_definition(node));
+    case node_kind::if_statement:
+      return return_current_value<result_type>(build_if_statement(node));
+    case node_kind::for_statement:
+      return return_current_value<result_type>(build_for_statement(node));
+    case node_kind::while_statement:
+      return return_current_value<result_type>(build_while_statement(node));
+    case node_kind::unsupported:
+      break;
+    }
+    return parse_error{ "Unexpected statement", node };
+  }
+
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<compound_statement>> build_compound_statement(
+    const parse_node &node)
   {
     if (node.item.type != lexing::token_type::left_brace) {
       return parse_error{ "Expected compound statement syntax: `{ /* list of statements */ }`", node };
     }
 
-    Container_Type<statement> return_value(alloc);
+    // added to the pool once complete, after those of nested blocks
+    auto statements = scratch_list<statement, 8>();
+    statements.reserve(node.children.size());
 
     for (const auto &child : node.children) {
-      if (auto s = build_statement(child, alloc); !is_parse_error(s)) {
-        visit_non_error_value(std::move(s), [&](auto &&value) { return_value.push_back(std::move(value)); });
+      if (auto s = build_statement(child); !is_parse_error(s)) {
+        assign(statements.emplace_back(), std::move(s));
       } else {
         return std::get<parse_error>(std::move(s));
       }
     }
 
-    return compound_statement{ std::move(return_value) };
+    return nodes.add(compound_statement{ nodes.append(statements) });
   }
 
-  [[nodiscard]] static constexpr merge_types_t<parse_error, function_definition>
-    build_function_ast(const parse_node &node, allocator_type alloc)
+  [[nodiscard]] constexpr merge_types_t<parse_error, handle<function_definition>> build_function_ast(
+    const parse_node &node)
   {
-    if (!(node.item.type == lexing::token_type::keyword && node.item.match == "auto" && node.children.size() == 1
-          && node.children.front().item.type == lexing::token_type::identifier)) {
+    if (!(is_keyword(node, lexing::symbols::auto_) && node.children.size() == 1
+          && node.children.front().item.type == lexing::token_type::identifier
+          && node.children.front().children.size() == 2)) {
       return parse_error{
         "Expected function definition syntax: `auto <function_name> (<parameter list...>) <compound_statement>", node
       };
     }
 
-    auto parameter_list = build_variable_list(node.children[0].children[0], alloc);
-    auto function_body = build_compound_statement(node.children[0].children[1], alloc);
-
-    //  const auto retval = function_definition{
-    //    node.children[0].item,
-    //  };
+    const auto &name = node.children[0];
+    auto parameters = build_variable_list(name.children[0]);
+    if (is_parse_error(parameters)) { return std::get<parse_error>(std::move(parameters)); }
+    auto function_body = build_compound_statement(name.children[1]);
+    if (is_parse_error(function_body)) { return std::get<parse_error>(std::move(function_body)); }
 
-    return function_definition{};
+    function_definition result{ name.item, std::get<parameter_list>(parameters), {} };
+    assign(result.body, std::move(function_body));
+    return nodes.add(std::move(result));
   }
-
-  //  [[nodiscard]] static constexpr auto build_ast(const parse_node &node, allocator_type alloc = {})
-  //  {
-  //    return
-  //  }
 };
 }// namespace thing::ast
 
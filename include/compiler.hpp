@@ -0,0 +1,343 @@
+#ifndef THING_COMPILER_HPP
+#define THING_COMPILER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "lex_item.hpp"
+#include "parse_node.hpp"
+#include "parser.hpp"
+#include "thing.hpp"
+#include "token_buffer.hpp"
+
+// Lowering of scripts to Operations programs.
+//
+// A script is a sequence of top-level definitions (see
+// basic_parser::parse_definitions), each of which is either a variable,
+// `auto name{ expression }`, or an expression. Expressions are made of number
+// literals, `true` and `false`, names of earlier variables, parentheses, the
+// prefix operators `+` and `-`, the arithmetic, comparison and logical infix
+// operators, and `if (condition) a; else b;`, where each branch is one
+// expression, in braces or not. Anything else, or a syntax error, throws a
+// compile_error.
+//
+// `if` is lowered onto forward RelativeJumps. A definition ends at a `;` or
+// at its first closing `}`, so an `if` goes in a variable,
+// `auto x{ if (c) { a; } else { b; } }`. Loops are deliberately left out:
+// the grammar has no assignment, so nothing in a loop body could change its
+// condition, even though RelativeJump can jump backward as well.
+//
+// Every variable keeps a stack slot for the rest of the program, and the
+// value of the last definition is left on top of the stack. Operators are
+// calls to execBinaryOp and execUnaryOp: operands that are literals or
+// variables are passed as they are, and the others are computed into
+// temporaries first.
+//
+// compile_embedded() does all of it during constant evaluation, so that
+//
+//   static constexpr auto program = thing::compiling::compile_embedded("auto x{ 6 * 7 }; x - 2");
+//
+// is static data that costs nothing at startup, and a script with an error in
+// it does not compile.
+
+namespace thing::compiling {
+
+using script_stack = Stack<std::monostate, RelativeStackReference, std::int64_t, std::uint64_t, double, bool, Function>;
+
+struct compile_error
+{
+  std::string_view message;
+  lexing::lex_item location;
+};
+
+template<typename StackType = script_stack> struct basic_compiler
+{
+  using operations = Operations<StackType>;
+  using value_type = typename StackType::value_type;
+  using parse_node = parsing::basic_parse_node<std::vector>;
+
+  static constexpr std::size_t stack_capacity = std::tuple_size_v<decltype(StackType::values)>;
+
+  static constexpr Function binary_operator{ &execBinaryOp<StackType, std::int64_t, std::uint64_t, double, bool> };
+  static constexpr Function unary_operator{ &execUnaryOp<StackType, std::int64_t, std::uint64_t, double, bool> };
+
+  // a variable, by the symbol of its name, and the stack slot of its value
+  struct variable
+  {
+    lexing::symbol_id symbol;
+    std::size_t slot;
+  };
+
+  operations program{};
+  // the number of values on the stack at this point of the program
+  std::size_t depth{ 0 };
+  std::vector<variable> variables;
+
+  [[nodiscard]] constexpr operations compile(const std::string_view script)
+  {
+    const auto tokens = lexing::tokenize(script);
+    parsing::basic_parser<std::vector> parser;
+    const auto definitions = parser.parse_definitions(tokens);
+    for (const auto &definition : definitions) { check_syntax(definition); }
+
+    for (std::size_t index = 0; index < definitions.size(); ++index) {
+      const auto &definition = definitions[index];
+      if (definition.item.type == lexing::token_type::keyword && definition.item.symbol == lexing::symbols::auto_) {
+        define(definition);
+      } else {
+        value(definition);
+        if (index + 1 != definitions.size()) { pop(definition); }
+      }
+    }
+
+    return program;
+  }
+
+  static constexpr void check_syntax(const parse_node &root)
+  {
+    std::vector<const parse_node *> pending{ &root };
+    while (!pending.empty()) {
+      const auto *node = pending.back();
+      pending.pop_back();
+      if (node->is_error()) { throw compile_error{ "syntax error", node->item }; }
+      for (const auto &child : node->children) { pending.push_back(&child); }
+    }
+  }
+
+  // `auto name{ expression }`
+  constexpr void define(const parse_node &definition)
+  {
+    if (definition.children.size() != 1 || definition.children[0].item.type != lexing::token_type::identifier
+        || definition.children[0].children.size() != 1
+        || definition.children[0].children[0].item.type != lexing::token_type::left_brace
+        || definition.children[0].children[0].children.size() != 1) {
+      throw compile_error{ "only variables can be defined, as `auto name{ value }`", definition.item };
+    }
+
+    const auto &name = definition.children[0];
+    value(name.children[0].children[0]);
+    variables.push_back({ name.item.symbol, depth - 1 });
+  }
+
+  constexpr void emit(typename operations::Types operation, const parse_node &node)
+  {
+    // the slot after the last operation stays a Nop, which ends the program
+    if (program.idx + 1 >= program.values.size()) {
+      throw compile_error{ "the program is too long for Operations", node.item };
+    }
+    program.push_back(std::move(operation));
+  }
+
+  constexpr void push(value_type literal, const parse_node &node)
+  {
+    if (depth == stack_capacity) { throw compile_error{ "the expression is too deep for the stack", node.item }; }
+    emit(PushLiteral<value_type>{ std::move(literal) }, node);
+    ++depth;
+  }
+
+  constexpr void pop(const parse_node &node)
+  {
+    emit(Pop{}, node);
+    --depth;
+  }
+
+  // to the value in `slot`, from the slot that is pushed next
+  [[nodiscard]] constexpr RelativeStackReference reference_to(const std::size_t slot) const noexcept
+  {
+    return { static_cast<std::ptrdiff_t>(depth - slot) };
+  }
+
+  [[nodiscard]] static constexpr bool is_leaf(const parse_node &node) noexcept
+  {
+    return node.children.empty()
+           && (node.item.type == lexing::token_type::number || node.item.type == lexing::token_type::identifier);
+  }
+
+  // a literal, or a reference to a variable, as pushed next
+  [[nodiscard]] constexpr value_type leaf(const parse_node &node) const
+  {
+    if (node.item.type == lexing::token_type::number) {
+      const auto number = node.item.number;
+      switch (number.kind) {
+      case lexing::number_kind::signed_integer:
+        return number.as_signed();
+      case lexing::number_kind::unsigned_integer:
+        return number.as_unsigned();
+      case lexing::number_kind::floating_point:
+        return number.as_double();
+      default:
+        throw compile_error{ "invalid number literal", node.item };
+      }
+    }
+
+    // the latest variable of that name
+    for (auto defined = variables.rbegin(); defined != variables.rend(); ++defined) {
+      if (defined->symbol == node.item.symbol) { return reference_to(defined->slot); }
+    }
+    if (node.item.symbol == lexing::symbols::true_) { return true; }
+    if (node.item.symbol == lexing::symbols::false_) { return false; }
+    throw compile_error{ "undefined name", node.item };
+  }
+
+  [[nodiscard]] static constexpr BinaryOps binary_operation(const parse_node &node)
+  {
+    switch (node.item.type) {
+    case lexing::token_type::plus:
+      return BinaryOps::Addition;
+    case lexing::token_type::minus:
+      return BinaryOps::Subtraction;
+    case lexing::token_type::asterisk:
+      return BinaryOps::Multiplication;
+    case lexing::token_type::slash:
+      return BinaryOps::Division;
+    case lexing::token_type::equals:
+      return BinaryOps::Equal_To;
+    case lexing::token_type::not_equals:
+      return BinaryOps::Not_Equal_To;
+    case lexing::token_type::less_than:
+      return BinaryOps::Less_Than;
+    case lexing::token_type::greater_than:
+      return BinaryOps::Greater_Than;
+    case lexing::token_type::less_than_or_equal:
+      return BinaryOps::Less_Than_Or_Equal_To;
+    case lexing::token_type::greater_than_or_equal:
+      return BinaryOps::Greater_Than_Or_Equal_To;
+    case lexing::token_type::logical_and:
+      return BinaryOps::And;
+    case lexing::token_type::logical_or:
+      return BinaryOps::Or;
+    default:
+      throw compile_error{ "operator not supported by the compiler", node.item };
+    }
+  }
+
+  // pushes the value of `node`
+  constexpr void value(const parse_node &node)
+  {
+    if (is_leaf(node)) {
+      push(leaf(node), node);
+    } else if (node.children.size() == 2) {
+      call(node, binary_operator, static_cast<std::uint64_t>(binary_operation(node)));
+    } else if (node.children.size() == 1 && node.item.type == lexing::token_type::plus) {
+      call(node, unary_operator, static_cast<std::uint64_t>(UnaryOps::Plus));
+    } else if (node.children.size() == 1 && node.item.type == lexing::token_type::minus) {
+      call(node, unary_operator, static_cast<std::uint64_t>(UnaryOps::Minus));
+    } else if (node.item.type == lexing::token_type::keyword && node.item.symbol == lexing::symbols::if_) {
+      conditional(node);
+    } else {
+      throw compile_error{ "expression not supported by the compiler", node.item };
+    }
+  }
+
+  // the expression of a branch of an `if`, which is either that expression
+  // or a block of only it
+  [[nodiscard]] static constexpr const parse_node &branch(const parse_node &statement)
+  {
+    if (statement.item.type != lexing::token_type::left_brace) { return statement; }
+    if (statement.children.size() != 1) {
+      throw compile_error{ "a branch of an `if` must be a single expression", statement.item };
+    }
+    return statement.children[0];
+  }
+
+  // to the operation at `target`, from the jump at `jump`, which `pc` moves
+  // past once it has been taken
+  constexpr void patch_jump(const std::size_t jump, const bool conditional_, const std::size_t target)
+  {
+    program.values[jump] =
+      RelativeJump{ conditional_, static_cast<std::ptrdiff_t>(target) - static_cast<std::ptrdiff_t>(jump) - 1 };
+  }
+
+  // `if (condition) then_; else else_;`: the condition is pushed, and a
+  // conditional jump, which only jumps on `true`, skips to the then branch.
+  // Either branch pops the condition and pushes its value into its slot. A
+  // condition that is not a bool takes the else branch.
+  constexpr void conditional(const parse_node &node)
+  {
+    if (node.children.size() != 3 || node.children[0].children.size() != 1 || node.children[2].children.size() != 1) {
+      throw compile_error{ "an `if` needs one condition and an `else` to have a value", node.item };
+    }
+
+    value(node.children[0].children[0]);
+    const auto to_then = static_cast<std::size_t>(program.idx);
+    emit(RelativeJump{ true, 0 }, node);
+
+    pop(node);
+    value(branch(node.children[2].children[0]));
+    const auto to_end = static_cast<std::size_t>(program.idx);
+    emit(RelativeJump{ false, 0 }, node);
+
+    // the condition is on the stack in place of the else value on the way
+    // into the then branch
+    patch_jump(to_then, true, static_cast<std::size_t>(program.idx));
+    pop(node);
+    value(branch(node.children[1]));
+    patch_jump(to_end, false, static_cast<std::size_t>(program.idx));
+  }
+
+  // Calls `function` with the operands of `node`, with the same stack layout
+  // as run_summation: the result, then the function, a reference to the
+  // result, the operation, the operands and the arity. The call drops
+  // everything above the result.
+  constexpr void call(const parse_node &node, const Function function, const std::uint64_t operation)
+  {
+    const auto result = depth;
+    push(std::monostate{}, node);
+
+    std::array<std::size_t, 2> temporaries{};
+    std::size_t temporary_count = 0;
+    for (std::size_t index = 0; index < node.children.size(); ++index) {
+      if (!is_leaf(node.children[index])) {
+        value(node.children[index]);
+        temporaries[index] = depth - 1;
+        ++temporary_count;
+      }
+    }
+
+    push(function, node);
+    push(reference_to(result), node);
+    push(operation, node);
+    for (std::size_t index = 0; index < node.children.size(); ++index) {
+      const auto &operand = node.children[index];
+      push(is_leaf(operand) ? leaf(operand) : value_type{ reference_to(temporaries[index]) }, node);
+    }
+    const std::uint64_t arity = node.children.size() + 1;
+    push(arity, node);
+    emit(CallFunction{ true }, node);
+    depth -= arity + 3;
+
+    for (; temporary_count != 0; --temporary_count) { pop(node); }
+  }
+};
+
+template<typename StackType = script_stack>
+[[nodiscard]] constexpr Operations<StackType> compile(const std::string_view script)
+{
+  return basic_compiler<StackType>{}.compile(script);
+}
+
+// compile(), but always at compile time: a script with an error is a compile
+// error rather than an exception
+template<typename StackType = script_stack>
+[[nodiscard]] consteval Operations<StackType> compile_embedded(const std::string_view script)
+{
+  return compile<StackType>(script);
+}
+
+// Runs `program`, which is taken by value so that a static one can be run
+// more than once, on `stack`
+template<typename StackType> constexpr void run(Operations<StackType> program, StackType &stack)
+{
+  while (program.next(stack)) {
+    // run while we can
+  }
+}
+
+}// namespace thing::compiling
+
+#endif
@@ -2,38 +2,413 @@
 #define THING_CONTAINERS_HPP
 
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <variant>
 
 namespace thing {
 
-/*
-template<typename Type>
-struct ref
+// Refers to an element of an indexable container by position rather than by
+// address, so it stays valid while the container grows, and costs a pointer
+// and an index whatever the element type is
+template<typename Container> struct ref
 {
+  const Container *container;
   std::size_t index;
-  void *container;
 
-  Type *(*lookup)(void *, std::size_t);
+  [[nodiscard]] constexpr decltype(auto) operator*() const { return (*container)[index]; }
+  [[nodiscard]] constexpr auto operator->() const { return &(*container)[index]; }
+
+  [[nodiscard]] constexpr bool operator==(const ref &) const noexcept = default;
+};
+
+// A read only view, with the interface of a container, of elements that are
+// owned elsewhere, such as in a mapped file. Instantiating a structure that is
+// parameterized on its container with this lets it use the elements in place.
+template<typename Type> struct borrowed_vector
+{
+  using value_type = Type;
+  using allocator_type = std::allocator<Type>;
+  using const_iterator = const Type *;
+
+  const Type *elements{ nullptr };
+  std::size_t count{ 0 };
+
+  constexpr borrowed_vector() = default;
+  constexpr explicit borrowed_vector(const allocator_type &) noexcept {}
+  constexpr borrowed_vector(const Type *elements_, const std::size_t count_) noexcept
+    : elements{ elements_ }, count{ count_ }
+  {}
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+  [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+  [[nodiscard]] constexpr const Type *data() const noexcept { return elements; }
+  [[nodiscard]] constexpr const Type &operator[](const std::size_t index) const noexcept { return elements[index]; }
+  [[nodiscard]] constexpr const_iterator begin() const noexcept { return elements; }
+  [[nodiscard]] constexpr const_iterator end() const noexcept { return elements + count; }
+  [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return {}; }
+};
+
+// A vector that keeps its first `Capacity` elements inside itself, and only
+// allocates, through `Allocator`, once it grows past them. It has the parts
+// of the std::vector interface that this project uses, including the
+// allocator aware constructors, so that a pmr allocator reaches the elements.
+//
+// The elements are stored in the object, so Type must be complete where the
+// small_vector is declared, and a type cannot hold a small_vector of itself:
+// recursive structures such as parse nodes keep using std::vector for their
+// children. During constant evaluation, where the inline storage cannot be
+// used, every element is allocated.
+template<typename Type, std::size_t Capacity, typename Allocator = std::allocator<Type>> struct small_vector
+{
+  using value_type = Type;
+  using allocator_type = Allocator;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = Type &;
+  using const_reference = const Type &;
+  using pointer = Type *;
+  using const_pointer = const Type *;
+  using iterator = Type *;
+  using const_iterator = const Type *;
+
+  using traits = std::allocator_traits<Allocator>;
+
+  static constexpr std::size_t inline_capacity = Capacity;
+
+  [[no_unique_address]] allocator_type alloc;
+  // nullptr while the elements are inline
+  Type *allocated{ nullptr };
+  std::size_t count{ 0 };
+  std::size_t allocated_capacity{ 0 };
+  alignas(Type) std::array<std::byte, Capacity * sizeof(Type)> storage;
+
+  constexpr small_vector() noexcept(noexcept(allocator_type{})) : small_vector(allocator_type{}) {}
+  constexpr explicit small_vector(const allocator_type &alloc_) noexcept : alloc{ alloc_ } {}
+
+  constexpr small_vector(std::initializer_list<Type> values, const allocator_type &alloc_ = {}) : alloc{ alloc_ }
+  {
+    reserve(values.size());
+    for (const auto &value : values) { push_back(value); }
+  }
+
+  constexpr small_vector(const small_vector &other)
+    : small_vector(other, traits::select_on_container_copy_construction(other.alloc))
+  {}
+
+  constexpr small_vector(const small_vector &other, const allocator_type &alloc_) : alloc{ alloc_ }
+  {
+    reserve(other.size());
+    for (const auto &value : other) { push_back(value); }
+  }
+
+  // inline elements are moved one by one
+  constexpr small_vector(small_vector &&other) noexcept(std::is_nothrow_move_constructible_v<Type>)
+    : alloc{ other.alloc }
+  {
+    take(std::move(other));
+  }
+
+  constexpr small_vector(small_vector &&other, const allocator_type &alloc_) : alloc{ alloc_ }
+  {
+    take(std::move(other));
+  }
+
+  constexpr small_vector &operator=(const small_vector &rhs)
+  {
+    if (this != &rhs) {
+      clear();
+      if constexpr (traits::propagate_on_container_copy_assignment::value) {
+        // memory from our allocator cannot be freed by the one we take over
+        if (!traits::is_always_equal::value && !(alloc == rhs.alloc)) { release(); }
+        alloc = rhs.alloc;
+      }
+      reserve(rhs.size());
+      for (const auto &value : rhs) { push_back(value); }
+    }
+    return *this;
+  }
+
+  constexpr small_vector &operator=(small_vector &&rhs) noexcept(
+    traits::propagate_on_container_move_assignment::value || traits::is_always_equal::value)
+  {
+    if (this != &rhs) {
+      clear();
+      release();
+      if constexpr (traits::propagate_on_container_move_assignment::value) { alloc = rhs.alloc; }
+      take(std::move(rhs));
+    }
+    return *this;
+  }
+
+  constexpr ~small_vector()
+  {
+    clear();
+    release();
+  }
+
+  [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return alloc; }
+
+  [[nodiscard]] constexpr Type *data() noexcept
+  {
+    if (allocated != nullptr || std::is_constant_evaluated()) { return allocated; }
+    return std::launder(reinterpret_cast<Type *>(storage.data()));
+  }
+  [[nodiscard]] constexpr const Type *data() const noexcept
+  {
+    if (allocated != nullptr || std::is_constant_evaluated()) { return allocated; }
+    return std::launder(reinterpret_cast<const Type *>(storage.data()));
+  }
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+  [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+  [[nodiscard]] constexpr std::size_t capacity() const noexcept
+  {
+    if (allocated != nullptr || std::is_constant_evaluated()) { return allocated_capacity; }
+    return Capacity;
+  }
+  // true while no element has been allocated
+  [[nodiscard]] constexpr bool is_inline() const noexcept { return allocated == nullptr; }
+
+  [[nodiscard]] constexpr iterator begin() noexcept { return data(); }
+  [[nodiscard]] constexpr iterator end() noexcept { return data() + count; }
+  [[nodiscard]] constexpr const_iterator begin() const noexcept { return data(); }
+  [[nodiscard]] constexpr const_iterator end() const noexcept { return data() + count; }
+
+  [[nodiscard]] constexpr Type &operator[](const std::size_t index) noexcept { return data()[index]; }
+  [[nodiscard]] constexpr const Type &operator[](const std::size_t index) const noexcept { return data()[index]; }
+  [[nodiscard]] constexpr Type &front() noexcept { return data()[0]; }
+  [[nodiscard]] constexpr const Type &front() const noexcept { return data()[0]; }
+  [[nodiscard]] constexpr Type &back() noexcept { return data()[count - 1]; }
+  [[nodiscard]] constexpr const Type &back() const noexcept { return data()[count - 1]; }
 
-  Type *operator->() {
-    return lookup(container, index);
+  constexpr void reserve(const std::size_t new_capacity)
+  {
+    if (new_capacity > capacity()) { reallocate(new_capacity); }
+  }
+
+  template<typename... Param> constexpr Type &emplace_back(Param &&...param)
+  {
+    if (count == capacity()) { return grow_and_emplace_back(std::forward<Param>(param)...); }
+    traits::construct(alloc, data() + count, std::forward<Param>(param)...);
+    return data()[count++];
+  }
+
+  constexpr void push_back(const Type &value) { emplace_back(value); }
+  constexpr void push_back(Type &&value) { emplace_back(std::move(value)); }
+
+  constexpr void pop_back() noexcept { traits::destroy(alloc, data() + --count); }
+
+  constexpr void clear() noexcept
+  {
+    while (count != 0) { pop_back(); }
+  }
+
+  constexpr void resize(const std::size_t new_size)
+  {
+    while (count > new_size) { pop_back(); }
+    reserve(new_size);
+    while (count < new_size) { emplace_back(); }
+  }
+
+  // `value` is a copy, it may be one of the elements that are cleared
+  constexpr void assign(const std::size_t new_size, const Type value)
+  {
+    clear();
+    reserve(new_size);
+    while (count < new_size) { emplace_back(value); }
+  }
+
+  constexpr iterator erase(const_iterator first, const_iterator last)
+  {
+    auto *const target = begin() + (first - begin());
+    const auto removed = static_cast<std::size_t>(last - first);
+    std::move(target + removed, end(), target);
+    for (std::size_t index = 0; index < removed; ++index) { pop_back(); }
+    return target;
+  }
+
+  constexpr iterator erase(const_iterator position) { return erase(position, position + 1); }
+
+  template<typename Iterator> constexpr iterator insert(const_iterator position, Iterator first, Iterator last)
+  {
+    const auto offset = static_cast<std::size_t>(position - begin());
+    const auto old_size = count;
+    for (; first != last; ++first) { emplace_back(*first); }
+    std::rotate(begin() + offset, begin() + old_size, end());
+    return begin() + offset;
+  }
+
+  [[nodiscard]] constexpr bool operator==(const small_vector &rhs) const
+  {
+    return std::equal(begin(), end(), rhs.begin(), rhs.end());
+  }
+
+  // moves the elements of `other` here, or takes its allocation when the
+  // allocators allow it
+  constexpr void take(small_vector &&other)
+  {
+    if (other.allocated != nullptr && (traits::is_always_equal::value || alloc == other.alloc)) {
+      allocated = std::exchange(other.allocated, nullptr);
+      allocated_capacity = std::exchange(other.allocated_capacity, 0);
+      count = std::exchange(other.count, 0);
+      return;
+    }
+    reserve(other.size());
+    for (auto &value : other) { emplace_back(std::move(value)); }
+    other.clear();
+  }
+
+  // `param` may refer to one of our elements, as in `v.push_back(v[0])`, so
+  // the new element is constructed before the old ones are moved away
+  template<typename... Param> constexpr Type &grow_and_emplace_back(Param &&...param)
+  {
+    const auto new_capacity = std::max(std::size_t{ 4 }, count * 2);
+    auto *const elements = traits::allocate(alloc, new_capacity);
+    try {
+      traits::construct(alloc, elements + count, std::forward<Param>(param)...);
+    } catch (...) {
+      traits::deallocate(alloc, elements, new_capacity);
+      throw;
+    }
+    adopt(elements, new_capacity);
+    return data()[count++];
+  }
+
+  constexpr void reallocate(const std::size_t new_capacity)
+  {
+    adopt(traits::allocate(alloc, new_capacity), new_capacity);
+  }
+
+  // moves the elements to `elements`, which becomes our allocation
+  constexpr void adopt(Type *const elements, const std::size_t new_capacity)
+  {
+    for (std::size_t index = 0; index < count; ++index) {
+      traits::construct(alloc, elements + index, std::move(data()[index]));
+      traits::destroy(alloc, data() + index);
+    }
+    release();
+    allocated = elements;
+    allocated_capacity = new_capacity;
+  }
+
+  // deallocates the elements, which must have been destroyed
+  constexpr void release() noexcept
+  {
+    if (allocated != nullptr) { traits::deallocate(alloc, std::exchange(allocated, nullptr), allocated_capacity); }
+    allocated_capacity = 0;
   }
 };
 
-template<typename ... Type>
-struct allocator
+// small_vector as a Container_Type, as in basic_flat_parser<small_vector_2>.
+// Two elements hold the children of most parse nodes, but basic_parse_node
+// cannot use it: see above. Where a structure keeps one long list, such as
+// the nodes of a flat tree, the inline elements only add to its size.
+template<typename Type> using small_vector_2 = small_vector<Type, 2>;
+
+// An object in the pool of Type of a typed_pools, by position. It stays valid
+// while the pool grows and takes 32 bits.
+template<typename Type> struct handle
 {
-  using contained = std::variant<Type...>;
+  std::uint32_t index{ 0 };
 
-  std::vector<contained> data;
+  [[nodiscard]] constexpr bool operator==(const handle &) const noexcept = default;
+};
+
+// `count` consecutive objects in the pool of Type, from `first`
+template<typename Type> struct handle_range
+{
+  std::uint32_t first{ 0 };
+  std::uint32_t count{ 0 };
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+  [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+  [[nodiscard]] constexpr bool operator==(const handle_range &) const noexcept = default;
+};
+
+// Objects of each of `Types` in a container of their own, so that the objects
+// of a type are contiguous and a pass over all of them is a loop over an
+// array. Objects refer to each other by handle rather than own each other
+// through pointers, and live as long as the pools: none is freed on its own,
+// and the pools are released with one deallocation per type, or none with an
+// arena, whatever the number of objects. Types must therefore be trivially
+// destructible.
+template<template<class> class Container_Type, typename... Types> struct typed_pools
+{
+  static_assert((std::is_trivially_destructible_v<Types> && ...), "pooled objects are never destroyed one by one");
+
+  std::tuple<Container_Type<Types>...> containers;
 
-  template<typename ... Param>
-  ref<RequestedType> create(Param && ... param) {
-    data.emplace_back(std::forward<Param>(param)...);
-    return ref<RequestedType>{data.size() - 1, this, []()};
+  constexpr typed_pools() = default;
+  template<typename Allocator>
+  constexpr explicit typed_pools(const Allocator &alloc) : containers{ Container_Type<Types>(alloc)... }
+  {}
+
+  // the allocator of the pools, for a container of Type that draws from the
+  // same memory
+  template<typename Type>
+  [[nodiscard]] constexpr typename Container_Type<Type>::allocator_type get_allocator() const noexcept
+  {
+    return typename Container_Type<Type>::allocator_type(std::get<0>(containers).get_allocator());
+  }
+
+  // all the objects of Type, in the order they were added
+  template<typename Type> [[nodiscard]] constexpr const Container_Type<Type> &all() const noexcept
+  {
+    return std::get<Container_Type<Type>>(containers);
+  }
+
+  template<typename Type> [[nodiscard]] constexpr const Type &operator[](const handle<Type> position) const noexcept
+  {
+    return all<Type>()[position.index];
+  }
+
+  template<typename Type>
+  [[nodiscard]] constexpr std::span<const Type> operator[](const handle_range<Type> range) const noexcept
+  {
+    return std::span<const Type>{ all<Type>().data() + range.first, range.count };
+  }
+
+  template<typename Type> [[nodiscard]] constexpr handle<std::remove_cvref_t<Type>> add(Type &&value)
+  {
+    auto &pool = std::get<Container_Type<std::remove_cvref_t<Type>>>(containers);
+    assert(pool.size() < std::numeric_limits<std::uint32_t>::max());
+    const handle<std::remove_cvref_t<Type>> result{ static_cast<std::uint32_t>(pool.size()) };
+    pool.push_back(std::forward<Type>(value));
+    return result;
+  }
+
+  // `values`, which are copied, as consecutive objects
+  template<typename Range> [[nodiscard]] constexpr handle_range<typename Range::value_type> append(const Range &values)
+  {
+    auto &pool = std::get<Container_Type<typename Range::value_type>>(containers);
+    assert(pool.size() + values.size() <= std::numeric_limits<std::uint32_t>::max());
+    const handle_range<typename Range::value_type> result{ static_cast<std::uint32_t>(pool.size()),
+      static_cast<std::uint32_t>(values.size()) };
+    pool.insert(pool.end(), values.begin(), values.end());
+    return result;
+  }
+
+  // drops every object, keeping the memory for the next ones
+  constexpr void clear() noexcept
+  {
+    std::apply([](auto &...pool) { (pool.clear(), ...); }, containers);
   }
 };
 
+/*
 template<typename Type>
 struct list
 {
@@ -0,0 +1,338 @@
+#ifndef THING_FLAT_PARSE_TREE_HPP
+#define THING_FLAT_PARSE_TREE_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "containers.hpp"
+#include "lex_item.hpp"
+#include "number_literal.hpp"
+#include "parse_node.hpp"
+#include "parser.hpp"
+
+// A parse tree stored as one contiguous array of plain nodes, instead of one
+// allocation per basic_parse_node.
+//
+// Nodes are laid out in preorder, so the children of node `i` start at
+// `i + 1`, and each node records its child count and the end of its subtree,
+// which is where its next sibling starts. Tokens are stored as offsets into
+// the source, like in a token_buffer, and are materialized as lex_items on
+// access. As in a token_buffer, the values of number tokens are decoded once,
+// into `numbers`, and the symbol of a number node is the index of its value.
+//
+// view() gives nodes the same shape as basic_parse_node (item, error,
+// expected_token, children, is_error()), so code written against one works
+// with the other.
+
+namespace thing::parsing {
+
+// A node of a basic_flat_parse_tree, the same whatever the container, so that
+// nodes can be moved between trees and stored outside of them
+struct flat_parse_node
+{
+  using index_type = std::uint32_t;
+  using offset_type = std::uint32_t;
+
+  lexing::token_type type;
+  error_type error;
+  lexing::token_type expected_token;
+  offset_type offset;
+  offset_type length;
+  // the index of the value in `numbers` for number tokens
+  lexing::symbol_id symbol;
+  index_type child_count;
+  // one past the last node of the subtree
+  index_type subtree_end;
+};
+
+template<template<class> class Container_Type> struct basic_flat_parse_tree
+{
+  using index_type = flat_parse_node::index_type;
+  using offset_type = flat_parse_node::offset_type;
+  using error_type = parsing::error_type;
+  using node = flat_parse_node;
+
+  using allocator_type = typename Container_Type<node>::allocator_type;
+
+  struct node_view;
+
+  // the children of a node, in order
+  struct children_range
+  {
+    struct iterator
+    {
+      ref<basic_flat_parse_tree> position;
+
+      [[nodiscard]] constexpr node_view operator*() const { return position.container->view(position.index); }
+
+      constexpr iterator &operator++() noexcept
+      {
+        position.index = position->subtree_end;
+        return *this;
+      }
+
+      [[nodiscard]] constexpr bool operator==(const iterator &) const noexcept = default;
+    };
+
+    ref<basic_flat_parse_tree> first;
+    index_type count;
+    index_type end_index;
+
+    [[nodiscard]] constexpr iterator begin() const noexcept { return { first }; }
+    [[nodiscard]] constexpr iterator end() const noexcept { return { { first.container, end_index } }; }
+    [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+    [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+
+    // linear in `index`, nodes only know where their next sibling starts
+    [[nodiscard]] constexpr node_view operator[](const std::size_t index) const
+    {
+      auto child = begin();
+      for (std::size_t skipped = 0; skipped < index; ++skipped) { ++child; }
+      return *child;
+    }
+
+    [[nodiscard]] constexpr node_view front() const { return *begin(); }
+    [[nodiscard]] constexpr node_view back() const { return (*this)[count - 1]; }
+  };
+
+  struct node_view
+  {
+    ref<basic_flat_parse_tree> position;
+    lexing::lex_item item;
+    error_type error;
+    lexing::token_type expected_token;
+    children_range children;
+
+    [[nodiscard]] constexpr bool is_error() const noexcept { return error != error_type::no_error; }
+  };
+
+  // all tokens point into `source`, which must outlive the tree
+  std::string_view source;
+  Container_Type<node> nodes;
+  Container_Type<lexing::number_value> numbers;
+
+  constexpr explicit basic_flat_parse_tree(std::string_view source_, allocator_type alloc = {})
+    : source{ source_ }, nodes(alloc), numbers(alloc)
+  {}
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return nodes.size(); }
+
+  [[nodiscard]] constexpr const node &operator[](const std::size_t index) const noexcept { return nodes[index]; }
+
+  [[nodiscard]] constexpr lexing::lex_item item(const std::size_t index) const noexcept
+  {
+    const auto &entry = nodes[index];
+    // the placeholder token of an argument list, which has no text
+    if (entry.type == lexing::token_type::unknown && entry.length == 0) {
+      return lexing::lex_item{ lexing::token_type::unknown, {}, {} };
+    }
+
+    lexing::lex_item result{ entry.type,
+      source.substr(entry.offset, entry.length),
+      source.substr(std::size_t{ entry.offset } + entry.length) };
+    if (entry.type == lexing::token_type::number) {
+      result.number = numbers[entry.symbol];
+    } else {
+      result.symbol = entry.symbol;
+    }
+    return result;
+  }
+
+  [[nodiscard]] constexpr node_view view(const std::size_t index) const noexcept
+  {
+    const auto &entry = nodes[index];
+    return { { this, index },
+      item(index),
+      entry.error,
+      entry.expected_token,
+      { { this, index + 1 }, entry.child_count, entry.subtree_end } };
+  }
+
+  [[nodiscard]] constexpr node_view root() const noexcept { return view(0); }
+};
+
+// Builds a basic_flat_parse_tree for basic_parser.
+//
+// While parsing, the parser's nodes are indexes into a pending array, which
+// holds the nodes in the order they were created, with their children linked
+// into lists. The Pratt parser creates an operator's left operand before the
+// operator itself, so preorder is only known once the parse is complete;
+// finish() then lays the tree out in preorder, in a single pass.
+template<template<class> class Container_Type> struct basic_flat_tree_builder
+{
+  using tree = basic_flat_parse_tree<Container_Type>;
+  using result_type = tree;
+  using index_type = typename tree::index_type;
+  using offset_type = typename tree::offset_type;
+  using error_type = typename tree::error_type;
+  using allocator_type = typename tree::allocator_type;
+
+  static constexpr index_type none = std::numeric_limits<index_type>::max();
+
+  struct node
+  {
+    index_type index;
+  };
+
+  struct pending_node
+  {
+    typename tree::node value;
+    index_type first_child;
+    index_type last_child;
+    index_type next_sibling;
+  };
+
+  // a node being laid out by finish() and the next of its children to visit
+  struct layout_frame
+  {
+    index_type output;
+    index_type next_child;
+  };
+
+  std::string_view source;
+  Container_Type<pending_node> pending;
+  Container_Type<layout_frame> frames;
+  // handed to the tree by finish()
+  Container_Type<lexing::number_value> numbers;
+
+  constexpr explicit basic_flat_tree_builder(allocator_type alloc = {})
+    : pending(alloc), frames(alloc), numbers(alloc)
+  {}
+
+  [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return pending.get_allocator(); }
+
+  constexpr void reset(std::string_view source_)
+  {
+    if (!std::is_constant_evaluated()) {
+      assert(source_.size() <= std::numeric_limits<offset_type>::max());
+    }
+    source = source_;
+    pending.clear();
+    numbers.clear();
+  }
+
+  [[nodiscard]] constexpr offset_type offset_of(const lexing::lex_item &item) const noexcept
+  {
+    // the placeholder token of an argument list does not point anywhere
+    if (item.match.data() == nullptr) { return 0; }
+    return static_cast<offset_type>(item.match.data() - source.data());
+  }
+
+  // the symbol field of the node of `item`, storing its value if it is a number
+  [[nodiscard]] constexpr lexing::symbol_id symbol_slot(const lexing::lex_item &item)
+  {
+    if (item.type != lexing::token_type::number) { return item.symbol; }
+    numbers.push_back(item.number);
+    return static_cast<lexing::symbol_id>(numbers.size() - 1);
+  }
+
+  [[nodiscard]] constexpr node
+    error(const lexing::lex_item &item, const error_type error_, const lexing::token_type expected = {})
+  {
+    pending.push_back({ { item.type,
+                          error_,
+                          expected,
+                          offset_of(item),
+                          static_cast<offset_type>(item.match.size()),
+                          symbol_slot(item),
+                          0,
+                          0 },
+      none,
+      none,
+      none });
+    return { static_cast<index_type>(pending.size() - 1) };
+  }
+
+  [[nodiscard]] constexpr node leaf(const lexing::lex_item &item) { return error(item, error_type::no_error); }
+
+  template<typename... Children> [[nodiscard]] constexpr node branch(const lexing::lex_item &item, Children... children)
+  {
+    auto parent = leaf(item);
+    (append(parent, std::move(children)), ...);
+    return parent;
+  }
+
+  constexpr void append(node &parent, node &&child)
+  {
+    auto &entry = pending[parent.index];
+    if (entry.last_child == none) {
+      entry.first_child = child.index;
+    } else {
+      pending[entry.last_child].next_sibling = child.index;
+    }
+    entry.last_child = child.index;
+    ++entry.value.child_count;
+  }
+
+  constexpr void relabel(node &target, const lexing::lex_item &item)
+  {
+    auto &value = pending[target.index].value;
+    value.type = item.type;
+    value.offset = offset_of(item);
+    value.length = static_cast<offset_type>(item.match.size());
+    value.symbol = symbol_slot(item);
+  }
+
+  // a node the parser left out of the tree after an error, which stays in
+  // pending but is never reached by finish()
+  constexpr void discard([[maybe_unused]] node &&target) const noexcept {}
+
+  [[nodiscard]] constexpr lexing::token_type type(const node &target) const noexcept
+  {
+    return pending[target.index].value.type;
+  }
+
+  [[nodiscard]] constexpr bool is_error(const node &target) const noexcept
+  {
+    return pending[target.index].value.error != error_type::no_error;
+  }
+
+  // unknown if there are no children
+  [[nodiscard]] constexpr lexing::token_type last_child_type(const node &target) const noexcept
+  {
+    const auto last = pending[target.index].last_child;
+    return last == none ? lexing::token_type::unknown : pending[last].value.type;
+  }
+
+  [[nodiscard]] constexpr result_type finish(node &&root)
+  {
+    tree result{ source, get_allocator() };
+    // nodes the parser discarded are not part of the tree, so this may be
+    // more than needed, but never less
+    result.nodes.reserve(pending.size());
+
+    const auto emit = [&](const index_type index) {
+      result.nodes.push_back(pending[index].value);
+      frames.push_back({ static_cast<index_type>(result.nodes.size() - 1), pending[index].first_child });
+    };
+
+    frames.clear();
+    emit(root.index);
+    while (!frames.empty()) {
+      auto &frame = frames.back();
+      if (const auto child = frame.next_child; child != none) {
+        frame.next_child = pending[child].next_sibling;
+        emit(child);
+      } else {
+        result.nodes[frame.output].subtree_end = static_cast<index_type>(result.nodes.size());
+        frames.pop_back();
+      }
+    }
+
+    // the values of numbers the parser discarded stay, unreferenced
+    result.numbers = std::move(numbers);
+    return result;
+  }
+};
+
+template<template<class> class Container_Type>
+using basic_flat_parser = basic_parser<Container_Type, basic_flat_tree_builder<Container_Type>>;
+
+}// namespace thing::parsing
+
+#endif
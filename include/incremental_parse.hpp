@@ -0,0 +1,391 @@
+#ifndef THING_INCREMENTAL_PARSE_HPP
+#define THING_INCREMENTAL_PARSE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lex_item.hpp"
+#include "parse_node.hpp"
+#include "parser.hpp"
+#include "token_buffer.hpp"
+
+// Reparsing a script after an edit, without parsing it all again.
+//
+// The tree of the script before the edit is updated in place. Only the
+// statements of one compound statement are parsed again: the ones from the
+// last statement boundary before the edit, up to the first one after it at
+// which the new statements line up with the old ones again. From a statement
+// boundary on, the parser only depends on the tokens that follow, which are
+// the old ones past the edit, so every statement from there on is kept as it
+// is. If the statements never line up, for instance because the edit closes
+// the compound statement early, the compound statement around it is tried,
+// and the whole script is parsed again as a last resort.
+//
+// Kept nodes are not parsed again, and their tokens are pointed at the new
+// source. Only their place in the tree identifies them, though: when
+// `removed != inserted`, the statements of the block after the replaced ones
+// move to other addresses, and shift by `inserted - removed`, see
+// reparsed_statements. Anything that depends on a node outside of the
+// replaced statements, other than on its position in the source, is still
+// valid if it is keyed by that place rather than by the node's address.
+//
+// If the new source is the old buffer edited in place, so that the text
+// before the edit is still where it was, only the nodes from the edit on are
+// visited to point them at it, and an edit costs the reparsed statements and
+// the nodes after them. The nodes before the edit are left as they were:
+// their `remainder` still begins in the right place, which is where
+// positions are taken from (see line_table::position_of), but ends where the
+// old source did. With any other new buffer, every node of the tree is
+// pointed at it.
+//
+// The result is the tree that parsing the new source would produce, except
+// that a reparsed statement counts its nesting from the statement itself, so
+// an edit can take a statement past max_nesting without a nesting_too_deep
+// error until the next full parse.
+
+namespace thing::parsing {
+
+// Children [first, first + removed) of `block` were replaced by children
+// [first, first + inserted), and the children after them, which were kept,
+// moved from index `i` to `i - removed + inserted`. `block` is nullptr if no
+// statement had to be parsed again, or if the whole script was.
+template<template<class> class Container_Type> struct reparsed_statements
+{
+  basic_parse_node<Container_Type> *block{ nullptr };
+  std::size_t first{ 0 };
+  std::size_t removed{ 0 };
+  std::size_t inserted{ 0 };
+  bool whole_script{ false };
+};
+
+template<template<class> class Container_Type> struct basic_statement_reparser
+{
+  using parser_type = basic_parser<Container_Type>;
+  using parse_node = basic_parse_node<Container_Type>;
+  using token_buffer = lexing::basic_token_buffer<Container_Type>;
+  using result_type = reparsed_statements<Container_Type>;
+
+  static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+  // the tokens of a subtree, by offset before the edit
+  struct extent
+  {
+    std::size_t first{ none };
+    std::size_t last{ 0 };
+    bool has_error{ false };
+  };
+
+  parser_type &parser;
+  const token_buffer &tokens;
+  // the source the tree was parsed from
+  std::string_view old_source;
+  lexing::text_edit edit;
+  lexing::relexed_tokens change;
+  // old offsets at or after this one belong to tokens past the change
+  std::size_t old_tail;
+
+  constexpr basic_statement_reparser(parser_type &parser_,
+    const token_buffer &tokens_,
+    std::string_view old_source_,
+    const lexing::text_edit &edit_,
+    const lexing::relexed_tokens &change_)
+    : parser{ parser_ }, tokens{ tokens_ }, old_source{ old_source_ }, edit{ edit_ }, change{ change_ },
+      old_tail{ tokens.offsets[change.first + change.inserted] + edit.removed - edit.inserted.size() }
+  {}
+
+  [[nodiscard]] static constexpr bool has_token(const parse_node &node) noexcept
+  {
+    // the placeholder token of an argument list does not point anywhere
+    return node.item.match.data() != nullptr;
+  }
+
+  [[nodiscard]] constexpr std::size_t old_offset(const parse_node &node) const noexcept
+  {
+    return static_cast<std::size_t>(node.item.match.data() - old_source.data());
+  }
+
+  [[nodiscard]] constexpr bool before_change(const std::size_t offset) const noexcept
+  {
+    return change.first != 0 && offset <= tokens.offsets[change.first - 1];
+  }
+
+  [[nodiscard]] constexpr bool after_change(const std::size_t offset) const noexcept { return offset >= old_tail; }
+
+  // the index in the new buffer of the token at `offset` in the old one
+  [[nodiscard]] constexpr std::size_t index_of(const std::size_t offset) const noexcept
+  {
+    const auto find = [&](const std::size_t begin, const std::size_t end, const std::size_t new_offset) {
+      const auto found = std::lower_bound(std::next(tokens.offsets.begin(), static_cast<std::ptrdiff_t>(begin)),
+        std::next(tokens.offsets.begin(), static_cast<std::ptrdiff_t>(end)),
+        new_offset);
+      return static_cast<std::size_t>(std::distance(tokens.offsets.begin(), found));
+    };
+
+    if (before_change(offset)) { return find(0, change.first, offset); }
+    if (after_change(offset)) {
+      return find(change.first + change.inserted, tokens.size(), offset - edit.removed + edit.inserted.size());
+    }
+    return none;
+  }
+
+  // The first token of a subtree. Leading operands come first among the
+  // children, so it is on the leftmost path.
+  [[nodiscard]] constexpr std::size_t first_offset(const parse_node &node) const noexcept
+  {
+    auto result = none;
+    for (const auto *current = &node;; current = &current->children.front()) {
+      if (has_token(*current)) { result = std::min(result, old_offset(*current)); }
+      if (current->children.empty()) { return result; }
+    }
+  }
+
+  [[nodiscard]] constexpr extent extent_of(const parse_node &node) const
+  {
+    extent result;
+    Container_Type<const parse_node *> pending(node.get_allocator());
+    pending.push_back(&node);
+    while (!pending.empty()) {
+      const auto *current = pending.back();
+      pending.pop_back();
+      if (current->is_error()) { result.has_error = true; }
+      if (has_token(*current)) {
+        result.first = std::min(result.first, old_offset(*current));
+        result.last = std::max(result.last, old_offset(*current));
+      }
+      for (const auto &child : current->children) { pending.push_back(&child); }
+    }
+    return result;
+  }
+
+  // The index in the new buffer of the first token of statement `child` + 1
+  // of `block`, if the tokens around it are the old ones, none otherwise.
+  // `before` selects the tokens before the change, or after it.
+  //
+  // Between the last node of a statement and the first node of the next one
+  // are the closing tokens of the former, which never make nodes when they
+  // match, and the opening parentheses of the latter. Statements with errors
+  // may have dropped any token, so there is no telling.
+  [[nodiscard]] constexpr std::size_t
+    boundary(const parse_node &block, const std::size_t child, const bool before) const
+  {
+    const auto side = [&](const std::size_t offset) { return before ? before_change(offset) : after_change(offset); };
+
+    const auto previous = extent_of(block.children[child]);
+    const auto next = extent_of(block.children[child + 1]);
+    if (previous.has_error || next.has_error || previous.first == none || next.first == none) { return none; }
+    if (!side(previous.last) || !side(next.first)) { return none; }
+
+    auto index = index_of(previous.last) + 1;
+    for (const auto end = index_of(next.first); index < end; ++index) {
+      switch (tokens.types[index]) {
+      case lexing::token_type::right_paren:
+      case lexing::token_type::right_brace:
+      case lexing::token_type::semicolon:
+        break;
+      default:
+        return index;
+      }
+    }
+    return index;
+  }
+
+  // The compound statements that the change starts in, outermost first
+  [[nodiscard]] constexpr Container_Type<parse_node *> enclosing_blocks(parse_node &root) const
+  {
+    Container_Type<parse_node *> result(root.get_allocator());
+
+    auto *current = &root;
+    bool is_statement = false;
+    while (true) {
+      if (is_statement && current->item.type == lexing::token_type::left_brace && !current->is_error()) {
+        result.push_back(current);
+      }
+
+      // the last child that starts before the change
+      auto &children = current->children;
+      const auto starts_before = std::partition_point(children.begin(), children.end(), [&](const auto &child) {
+        const auto offset = first_offset(child);
+        return offset != none && before_change(offset);
+      });
+      if (starts_before == children.begin()) { return result; }
+      const auto index = static_cast<std::size_t>(std::distance(children.begin(), starts_before)) - 1;
+
+      // the children of compound statements, the body of a control block and
+      // the statement of its else are statements
+      const auto keyword =
+        current->item.type == lexing::token_type::keyword ? current->item.symbol : lexing::symbols::none;
+      const bool is_compound = is_statement && current->item.type == lexing::token_type::left_brace;
+      const bool is_control_body =
+        index == 1
+        && (keyword == lexing::symbols::if_ || keyword == lexing::symbols::while_ || keyword == lexing::symbols::for_);
+      is_statement = is_compound || is_control_body || (keyword == lexing::symbols::else_ && index == 0);
+      current = &children[index];
+    }
+  }
+
+  // Parses the statements of `block` again, from a boundary before the change
+  // to one after it. false if there are no such boundaries.
+  [[nodiscard]] constexpr bool reparse_statements(parse_node &block, result_type &result)
+  {
+    const auto count = block.children.size();
+
+    // the children that start before the change
+    std::size_t starts_before = 0;
+    while (starts_before < count) {
+      const auto offset = first_offset(block.children[starts_before]);
+      if (offset == none || !before_change(offset)) { break; }
+      ++starts_before;
+    }
+
+    // the statement that the change starts in, or the one before, if there is
+    // no telling where that one starts
+    std::size_t first = starts_before == 0 ? 0 : starts_before - 1;
+    auto start = none;
+    for (; first > 0; --first) {
+      if (start = boundary(block, first - 1, true); start != none) { break; }
+    }
+    if (first == 0) {
+      if (!before_change(old_offset(block))) { return false; }
+      start = index_of(old_offset(block)) + 1;
+    }
+
+    Container_Type<parse_node> statements(block.get_allocator());
+    const auto changed_end = change.first + change.inserted;
+    auto next_token = start;
+    // the next old statement that the new ones could line up with
+    auto kept = first + 1;
+    auto kept_start = none;
+
+    while (true) {
+      switch (tokens.types[next_token]) {
+      case lexing::token_type::right_brace:
+      case lexing::token_type::end_of_file:
+      case lexing::token_type::unknown:
+        // the block would end somewhere else
+        return false;
+      default:
+        break;
+      }
+
+      auto statement = parser.parse_statement(tokens, next_token);
+      if (parser.token_index <= next_token) { return false; }
+      statements.push_back(std::move(statement));
+      next_token = parser.token_index;
+      if (next_token < changed_end) { continue; }
+
+      while (kept < count) {
+        if (kept_start == none) { kept_start = boundary(block, kept - 1, false); }
+        if (kept_start != none && kept_start >= next_token) { break; }
+        kept_start = none;
+        ++kept;
+      }
+      if (kept >= count) { return false; }
+      if (kept_start == next_token) { break; }
+    }
+
+    const auto first_replaced = std::next(block.children.begin(), static_cast<std::ptrdiff_t>(first));
+    block.children.erase(first_replaced, std::next(block.children.begin(), static_cast<std::ptrdiff_t>(kept)));
+    block.children.insert(std::next(block.children.begin(), static_cast<std::ptrdiff_t>(first)),
+      std::make_move_iterator(statements.begin()),
+      std::make_move_iterator(statements.end()));
+
+    result = { &block, first, kept - first, statements.size() };
+    return true;
+  }
+
+  // The first child of `node` that may have tokens at or after the edit.
+  // Children are in source order, so a child followed by one that starts
+  // before the edit ends before it as well.
+  [[nodiscard]] constexpr std::size_t first_child_at_edit(const parse_node &node) const noexcept
+  {
+    const auto &children = node.children;
+    const auto starts_before = std::partition_point(children.begin(), children.end(), [&](const auto &child) {
+      const auto offset = first_offset(child);
+      return offset != none && offset < edit.offset;
+    });
+    const auto index = static_cast<std::size_t>(std::distance(children.begin(), starts_before));
+    return index == 0 ? 0 : index - 1;
+  }
+
+  // Points the tokens of the kept nodes at the new source, skipping the
+  // statements that are new. If the source was edited in place, the
+  // subtrees before the edit are skipped as well, see above.
+  constexpr void move_tokens(parse_node &root, const result_type &skipped) const
+  {
+    const auto source = tokens.source;
+    const bool in_place = source.data() == old_source.data();
+    Container_Type<parse_node *> pending(root.get_allocator());
+    pending.push_back(&root);
+    while (!pending.empty()) {
+      auto *current = pending.back();
+      pending.pop_back();
+
+      if (has_token(*current)) {
+        auto offset = old_offset(*current);
+        if (offset >= edit.offset) {
+          offset = offset - edit.removed + edit.inserted.size();
+        } else if (in_place) {
+          offset = none;
+        }
+        if (offset != none) {
+          const auto length = current->item.match.size();
+          current->item.match = source.substr(offset, length);
+          current->item.remainder = source.substr(offset + length);
+        }
+      }
+
+      for (auto index = in_place ? first_child_at_edit(*current) : 0; index < current->children.size(); ++index) {
+        if (current == skipped.block && index >= skipped.first && index < skipped.first + skipped.inserted) {
+          continue;
+        }
+        pending.push_back(&current->children[index]);
+      }
+    }
+  }
+
+  [[nodiscard]] constexpr result_type reparse(parse_node &tree)
+  {
+    result_type result;
+    if (change.removed != 0 || change.inserted != 0) {
+      const auto blocks = enclosing_blocks(tree);
+      bool reparsed = false;
+      for (auto block = blocks.rbegin(); block != blocks.rend() && !reparsed; ++block) {
+        reparsed = reparse_statements(**block, result);
+      }
+      if (!reparsed) {
+        tree = parser.parse(tokens);
+        result.whole_script = true;
+        return result;
+      }
+    }
+
+    move_tokens(tree, result);
+    return result;
+  }
+};
+
+// Updates `tree`, parsed from `tokens`, and `tokens` for `edit`. `source` is
+// the new buffer, as for lexing::relex, but the old one must still be alive:
+// the tree's tokens are found by their address in it. That is the case if
+// `source` is the old buffer edited in place, which is also what keeps the
+// cost of an edit from growing with the size of the tree; see above.
+template<template<class> class Container_Type>
+constexpr reparsed_statements<Container_Type> reparse(basic_parser<Container_Type> &parser,
+  basic_parse_node<Container_Type> &tree,
+  lexing::basic_token_buffer<Container_Type> &tokens,
+  std::string_view source,
+  const lexing::text_edit &edit)
+{
+  const auto old_source = tokens.source;
+  const auto change = lexing::relex(tokens, source, edit);
+  return basic_statement_reparser<Container_Type>{ parser, tokens, old_source, edit, change }.reparse(tree);
+}
+
+}// namespace thing::parsing
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef THING_LAZY_DEFINITIONS_HPP
+#define THING_LAZY_DEFINITIONS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <variant>
+
+#include "containers.hpp"
+#include "lex_item.hpp"
+#include "parser.hpp"
+#include "symbol_table.hpp"
+#include "token_buffer.hpp"
+
+// The top-level definitions of a script, with function bodies parsed on first
+// use.
+//
+// Construction finds where every definition ends by bracket matching alone
+// (see basic_parser::end_of_definition). Functions, `auto name(...) { ... }`,
+// only have their signature parsed, the part before the body, so that they
+// can be looked up by name and their parameters inspected; the body is
+// skipped without building anything. Every other definition is parsed right
+// away.
+//
+// definition(index) parses a function in full the first time it is asked
+// for, and from then on returns the same trees, which are the ones that
+// parse_definitions() would have produced for that part of the script: a
+// caller cannot tell whether a definition was parsed lazily.
+//
+// function_ast(index, builder) goes on from there to the AST of a function,
+// body included, which is built on first use as well and kept, by handle,
+// for the builder that built it.
+//
+// The token buffer must outlive the definitions. Parsing on demand modifies
+// the definitions, which are therefore not safe to use from several threads
+// at once.
+
+namespace thing::parsing {
+
+template<template<class> class Container_Type, typename Tree_Builder = basic_node_tree_builder<Container_Type>>
+struct basic_lazy_definitions
+{
+  using parser_type = basic_parser<Container_Type, Tree_Builder>;
+  using result_type = typename Tree_Builder::result_type;
+  using allocator_type = typename parser_type::allocator_type;
+  using token_buffer = lexing::basic_token_buffer<Container_Type>;
+
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  struct entry
+  {
+    // the tokens of the definition
+    std::size_t begin;
+    std::size_t end;
+    // the `{` of a function's body, npos for anything else
+    std::size_t body;
+    // for functions, `auto name(...)`
+    std::optional<result_type> signature;
+    // the trees of the definition, once parsed; usually just one, but tokens
+    // that are left over after an error start trees of their own
+    std::optional<Container_Type<result_type>> trees;
+    // the index of the function_definition handle, once the AST is built
+    std::optional<std::uint32_t> ast;
+  };
+
+  const token_buffer *tokens;
+  parser_type parser;
+  Container_Type<entry> entries;
+
+  constexpr basic_lazy_definitions(const parser_type &settings, const token_buffer &buffer)
+    : tokens{ &buffer }, parser{ settings, settings.alloc }, entries(settings.alloc)
+  {
+    for (std::size_t index = 0; buffer.types[index] != lexing::token_type::end_of_file;) {
+      const auto end = parser_type::end_of_definition(buffer, index);
+      auto &added = entries.emplace_back(entry{ index, end, function_body(buffer, index, end), {}, {}, {} });
+      if (added.body != npos) {
+        added.signature.emplace(parser.parse_expression(buffer, index, added.body));
+      } else {
+        parse(added);
+      }
+      index = end;
+    }
+  }
+
+  constexpr explicit basic_lazy_definitions(const token_buffer &buffer) : basic_lazy_definitions(parser_type{}, buffer)
+  {}
+
+  // The `{` that starts the body, if the definition in [begin, end) is a
+  // function: `auto`, a name, a parenthesized parameter list and a body that
+  // runs to the end of the definition
+  [[nodiscard]] static constexpr std::size_t
+    function_body(const token_buffer &buffer, const std::size_t begin, const std::size_t end)
+  {
+    if (end - begin < 5 || buffer.types[begin] != lexing::token_type::keyword
+        || buffer.symbol_ids[begin] != lexing::symbols::auto_
+        || buffer.types[begin + 1] != lexing::token_type::identifier
+        || buffer.types[begin + 2] != lexing::token_type::left_paren) {
+      return npos;
+    }
+
+    std::size_t depth = 0;
+    for (auto index = begin + 2; index < end; ++index) {
+      switch (buffer.types[index]) {
+      case lexing::token_type::left_paren:
+      case lexing::token_type::left_brace:
+        ++depth;
+        break;
+      case lexing::token_type::right_paren:
+      case lexing::token_type::right_brace:
+        --depth;
+        break;
+      default:
+        break;
+      }
+      if (depth == 0) {
+        return index + 1 < end && buffer.types[index + 1] == lexing::token_type::left_brace ? index + 1 : npos;
+      }
+    }
+    return npos;
+  }
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return entries.size(); }
+
+  [[nodiscard]] constexpr bool is_function(const std::size_t index) const noexcept
+  {
+    return entries[index].body != npos;
+  }
+
+  // the name of a function, empty for other definitions
+  [[nodiscard]] constexpr std::string_view name(const std::size_t index) const noexcept
+  {
+    return is_function(index) ? tokens->match(entries[index].begin + 1) : std::string_view{};
+  }
+
+  // `auto name(...)`, without the body, of a function
+  [[nodiscard]] constexpr const result_type &signature(const std::size_t index) const
+  {
+    return *entries[index].signature;
+  }
+
+  // the first function called `function_name`, or npos
+  [[nodiscard]] constexpr std::size_t find(const std::string_view function_name) const noexcept
+  {
+    for (std::size_t index = 0; index < entries.size(); ++index) {
+      if (is_function(index) && name(index) == function_name) { return index; }
+    }
+    return npos;
+  }
+
+  // whether definition(index) has been parsed
+  [[nodiscard]] constexpr bool is_parsed(const std::size_t index) const noexcept
+  {
+    return entries[index].trees.has_value();
+  }
+
+  // all the trees of a definition, parsed now if they were not yet
+  [[nodiscard]] constexpr const Container_Type<result_type> &trees(const std::size_t index)
+  {
+    auto &target = entries[index];
+    if (!target.trees) { parse(target); }
+    return *target.trees;
+  }
+
+  [[nodiscard]] constexpr const result_type &definition(const std::size_t index) { return trees(index).front(); }
+
+  // whether function_ast(index, ...) has been built
+  [[nodiscard]] constexpr bool is_built(const std::size_t index) const noexcept
+  {
+    return entries[index].ast.has_value();
+  }
+
+  // The AST of a function, parsed and built into `builder` now if it was not
+  // yet. Every call for a definition must pass the same builder, which owns
+  // the AST. Errors are not kept: a definition that is not a function, or
+  // that has a syntax error, is built again on every call.
+  template<typename Ast_Builder>
+  [[nodiscard]] constexpr std::variant<typename Ast_Builder::parse_error,
+    handle<typename Ast_Builder::function_definition>>
+    function_ast(const std::size_t index, Ast_Builder &builder)
+  {
+    using function_handle = handle<typename Ast_Builder::function_definition>;
+    if (const auto built = entries[index].ast; built) { return function_handle{ *built }; }
+
+    auto result = builder.build_function_ast(definition(index));
+    if (const auto *built = std::get_if<function_handle>(&result); built != nullptr) {
+      entries[index].ast = built->index;
+    }
+    return result;
+  }
+
+  constexpr void parse(entry &target)
+  {
+    target.trees.emplace(parser.alloc);
+    parser.parse_definition(*tokens, target.begin, target.end, *target.trees);
+  }
+};
+
+}// namespace thing::parsing
+
+#endif
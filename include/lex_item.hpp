@@ -1,8 +1,15 @@
 #ifndef THING_LEX_ITEM_HPP
 #define THING_LEX_ITEM_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "number_literal.hpp"
+#include "symbol_table.hpp"
+
 namespace thing::lexing {
-enum struct token_type {
+enum struct token_type : std::uint8_t {
   unknown = 0,
   identifier,
   number,
@@ -41,6 +48,9 @@ enum struct token_type {
   logical_or
 };
 
+// the number of token types, for tables indexed by them
+inline constexpr std::size_t token_type_count = static_cast<std::size_t>(token_type::logical_or) + 1;
+
 constexpr static std::string_view to_string(const token_type type) noexcept
 {
   switch (type) {
@@ -126,6 +136,17 @@ struct lex_item
   token_type type{ token_type::unknown };
   std::string_view match;
   std::string_view remainder;
+  // keywords are assigned their symbol by the lexer, identifiers once they
+  // are interned into a symbol table
+  symbol_id symbol{ symbols::none };
+  // decoded by the lexer, for number tokens
+  number_value number{};
+
+  // false for tokens that could not be lexed or decoded
+  [[nodiscard]] constexpr explicit operator bool() const noexcept
+  {
+    return type != token_type::unknown && number.kind != number_kind::invalid;
+  }
 };
 
 }// namespace thing::lexing
@@ -1,99 +1,223 @@
 #ifndef THING_LEXER_HPP
 #define THING_LEXER_HPP
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
 #include "lex_item.hpp"
-#include <ctre.hpp>
+#include "simd_scan.hpp"
+
+namespace thing::lexing {
 
-// Helper function for concatenating two different ct11::fixed_strings
-template<std::size_t N1, std::size_t N2>
-constexpr auto operator+(const ctll::fixed_string<N1> &lhs, const ctll::fixed_string<N2> &rhs)
+// The lexer is a single pass DFA. Every byte value is assigned a class at
+// compile time, the class of the first byte selects the sub-automaton
+// (whitespace run, identifier, number, quoted string, operator) and that
+// sub-automaton walks the input exactly once to find the end of the token.
+//
+// The accepted language is the same as the original regex based lexer:
+//
+//   whitespace:  \s+
+//   identifier:  [_a-zA-Z]+[_0-9a-zA-Z]*
+//   string:      "([^"\\]|\\.)*"
+//   float:       [0-9]+[.][0-9]*([eEpP][0-9]+)?[lLfF]?
+//   integer:     [0-9][_a-zA-Z0-9]*
+//
+// Number tokens are decoded as they are lexed, see number_literal.hpp.
+
+enum struct char_class : std::uint8_t { other, whitespace, identifier_start, digit, quote, punctuation };
+
+struct byte_entry
 {
-  char32_t result[N1 + N2 - 1]{};
+  char_class type{ char_class::other };
+  // token produced if this byte stands alone
+  token_type single{ token_type::unknown };
+  // optional two byte operator starting with this byte
+  char second{};
+  token_type pair{ token_type::unknown };
+};
+
+using operator_token = std::pair<std::string_view, token_type>;
+
+static constexpr std::array operator_tokens{ operator_token{ "++", token_type::increment },
+  operator_token{ "--", token_type::decrement },
+  operator_token{ ">=", token_type::greater_than_or_equal },
+  operator_token{ "<=", token_type::less_than_or_equal },
+  operator_token{ "!=", token_type::not_equals },
+  operator_token{ "==", token_type::equals },
+  operator_token{ "||", token_type::logical_or },
+  operator_token{ "&&", token_type::logical_and },
+  operator_token{ "<", token_type::less_than },
+  operator_token{ ">", token_type::greater_than },
+  operator_token{ ":", token_type::colon },
+  operator_token{ ",", token_type::comma },
+  operator_token{ "=", token_type::assign },
+  operator_token{ "+", token_type::plus },
+  operator_token{ "-", token_type::minus },
+  operator_token{ "*", token_type::asterisk },
+  operator_token{ "/", token_type::slash },
+  operator_token{ "^", token_type::caret },
+  operator_token{ "~", token_type::tilde },
+  operator_token{ "%", token_type::percent },
+  operator_token{ "!", token_type::bang },
+  operator_token{ "?", token_type::question },
+  operator_token{ "(", token_type::left_paren },
+  operator_token{ ")", token_type::right_paren },
+  operator_token{ "{", token_type::left_brace },
+  operator_token{ "}", token_type::right_brace },
+  operator_token{ "[", token_type::left_bracket },
+  operator_token{ "]", token_type::right_bracket },
+  operator_token{ ";", token_type::semicolon } };
+
+[[nodiscard]] consteval std::array<byte_entry, 256> make_byte_table()
+{
+  std::array<byte_entry, 256> table{};
+
+  const auto entry = [&table](const char c) -> byte_entry & { return table[static_cast<unsigned char>(c)]; };
+
+  for (const char c : std::string_view{ " \t\n\v\f\r" }) { entry(c).type = char_class::whitespace; }
+  for (char c = 'a'; c <= 'z'; ++c) { entry(c).type = char_class::identifier_start; }
+  for (char c = 'A'; c <= 'Z'; ++c) { entry(c).type = char_class::identifier_start; }
+  entry('_').type = char_class::identifier_start;
+  for (char c = '0'; c <= '9'; ++c) { entry(c).type = char_class::digit; }
+  entry('"').type = char_class::quote;
+
+  for (const auto &[text, type] : operator_tokens) {
+    auto &first = entry(text[0]);
+    first.type = char_class::punctuation;
+    if (text.size() == 1) {
+      first.single = type;
+    } else {
+      // the DFA only has room for a single two byte continuation per byte
+      if (text.size() != 2 || first.pair != token_type::unknown) { throw "unsupported operator token"; }
+      first.second = text[1];
+      first.pair = type;
+    }
+  }
 
-  auto iter = std::begin(result);
-  iter = std::copy(lhs.begin(), lhs.end(), iter);
-  std::copy(rhs.begin(), rhs.end(), iter);
-  return ctll::fixed_string(result);
+  return table;
 }
 
-namespace thing::lexing {
+static constexpr auto byte_table = make_byte_table();
 
-[[nodiscard]] static constexpr lex_item lexer(std::string_view v) noexcept
+[[nodiscard]] constexpr char_class classify(const char c) noexcept
 {
-  if (v.empty()) { return lex_item{ token_type::end_of_file, v, v }; }
+  return byte_table[static_cast<unsigned char>(c)].type;
+}
 
-  // prefix with ^ so that the regex search only matches the start of the
-  // string. Hana assures me this is efficient ;) (at runtime that is)
-  constexpr auto make_token = [](const auto &s) { return ctll::fixed_string{ "^" } + ctll::fixed_string{ s }; };
+[[nodiscard]] constexpr bool is_digit(const char c) noexcept { return classify(c) == char_class::digit; }
 
-  const auto ret = [v](const token_type type, std::string_view found) -> lex_item {
-    return { type, v.substr(0, found.size()), v.substr(found.size()) };
-  };
+[[nodiscard]] constexpr bool is_identifier_char(const char c) noexcept
+{
+  const auto type = classify(c);
+  return type == char_class::identifier_start || type == char_class::digit;
+}
 
-  constexpr auto identifier{ make_token("[_a-zA-Z]+[_0-9a-zA-Z]*") };
-  constexpr auto quoted_string{ make_token(R"("([^"\\]|\\.)*")") };
-  constexpr auto floatingpoint_number{ make_token("[0-9]+[.][0-9]*([eEpP][0-9]+)?[lLfF]?") };
-  // if it starts with an int, it's an int
-  // parsing will happen later to determine if it's valid
-  constexpr auto integral_number{ make_token("[0-9][_a-zA-Z0-9]*") };
-  constexpr auto whitespace{ make_token("\\s+") };
-
-  using token = std::pair<std::string_view, token_type>;
-  constexpr std::array tokens{ token{ "++", token_type::increment },
-    token{ "--", token_type::decrement },
-    token{ ">=", token_type::greater_than_or_equal },
-    token{ "<=", token_type::less_than_or_equal },
-    token{ "!=", token_type::not_equals },
-    token{ "==", token_type::equals },
-    token{ "||", token_type::logical_or },
-    token{ "&&", token_type::logical_and },
-    token{ "<", token_type::less_than },
-    token{ ">", token_type::greater_than },
-    token{ ":", token_type::colon },
-    token{ ",", token_type::comma },
-    token{ "=", token_type::assign },
-    token{ "+", token_type::plus },
-    token{ "-", token_type::minus },
-    token{ "*", token_type::asterisk },
-    token{ "/", token_type::slash },
-    token{ "^", token_type::caret },
-    token{ "~", token_type::tilde },
-    token{ "%", token_type::percent },
-    token{ "!", token_type::bang },
-    token{ "?", token_type::question },
-    token{ "(", token_type::left_paren },
-    token{ ")", token_type::right_paren },
-    token{ "{", token_type::left_brace },
-    token{ "}", token_type::right_brace },
-    token{ "[", token_type::left_bracket },
-    token{ "]", token_type::right_bracket },
-    token{ ";", token_type::semicolon } };
-
-  constexpr std::array keywords{
-    std::string_view{ "auto" }, std::string_view{ "for" }, std::string_view{ "if" }, std::string_view{ "else" }
-  };
+// Each scan_* function returns the index one past the end of the run that
+// starts at `pos`. The two hot runs, whitespace and identifiers, are handed to
+// the vectorized scanners at runtime.
+[[nodiscard]] constexpr std::size_t scan_whitespace(std::string_view v, std::size_t pos) noexcept
+{
+  if (!std::is_constant_evaluated()) { return simd::scan_whitespace(v, pos); }
+  while (pos < v.size() && classify(v[pos]) == char_class::whitespace) { ++pos; }
+  return pos;
+}
+
+[[nodiscard]] constexpr std::size_t scan_identifier(std::string_view v, std::size_t pos) noexcept
+{
+  if (!std::is_constant_evaluated()) { return simd::scan_identifier(v, pos); }
+  while (pos < v.size() && is_identifier_char(v[pos])) { ++pos; }
+  return pos;
+}
+
+[[nodiscard]] constexpr std::size_t scan_digits(std::string_view v, std::size_t pos) noexcept
+{
+  while (pos < v.size() && is_digit(v[pos])) { ++pos; }
+  return pos;
+}
+
+// returns 0 if the string is not terminated
+[[nodiscard]] constexpr std::size_t scan_quoted_string(std::string_view v) noexcept
+{
+  for (std::size_t pos = 1; pos < v.size(); ++pos) {
+    if (v[pos] == '"') {
+      return pos + 1;
+    } else if (v[pos] == '\\') {
+      // skip escaped character, which cannot terminate the string
+      ++pos;
+    }
+  }
+  return 0;
+}
 
-  if (auto result = ctre::search<whitespace>(v); result) { return ret(token_type::whitespace, result); }
+[[nodiscard]] constexpr std::size_t scan_number(std::string_view v) noexcept
+{
+  auto pos = scan_digits(v, 1);
 
-  for (const auto &oper : tokens) {
-    if (v.starts_with(oper.first)) { return ret(oper.second, oper.first); }
+  if (pos == v.size() || v[pos] != '.') {
+    // if it starts with an int, it's an int
+    // decode_number determines if it's valid
+    return scan_identifier(v, pos);
   }
 
-  if (auto id_result = ctre::search<identifier>(v); id_result) {
-    const auto is_keyword = std::any_of(
-      begin(keywords), end(keywords), [id = std::string_view{ id_result }](const auto &rhs) { return id == rhs; });
-    return ret(is_keyword ? token_type::keyword : token_type::identifier, id_result);
-  } else if (auto string_result = ctre::search<quoted_string>(v); string_result) {
-    return ret(token_type::string, string_result);
-  } else if (auto float_result = ctre::search<floatingpoint_number>(v); float_result) {
-    return ret(token_type::number, float_result);
-  } else if (auto int_result = ctre::search<integral_number>(v); int_result) {
-    return ret(token_type::number, int_result);
+  pos = scan_digits(v, pos + 1);
+
+  constexpr auto is_exponent = [](const char c) { return c == 'e' || c == 'E' || c == 'p' || c == 'P'; };
+  constexpr auto is_suffix = [](const char c) { return c == 'l' || c == 'L' || c == 'f' || c == 'F'; };
+
+  if (pos + 1 < v.size() && is_exponent(v[pos]) && is_digit(v[pos + 1])) { pos = scan_digits(v, pos + 2); }
+  if (pos < v.size() && is_suffix(v[pos])) { ++pos; }
+
+  return pos;
+}
+
+// The lexer never reads more than this many bytes past the end of a token,
+// when scan_number checks for an exponent. A token followed by at least this
+// many bytes is therefore final, whatever comes after them.
+static constexpr std::size_t max_lookahead = 2;
+
+[[nodiscard]] static constexpr lex_item lexer(std::string_view v) noexcept
+{
+  if (v.empty()) { return lex_item{ token_type::end_of_file, v, v }; }
+
+  const auto ret = [v](const token_type type, const std::size_t length) -> lex_item {
+    return { type, v.substr(0, length), v.substr(length) };
+  };
+
+  const auto &entry = byte_table[static_cast<unsigned char>(v[0])];
+
+  switch (entry.type) {
+  case char_class::whitespace:
+    return ret(token_type::whitespace, scan_whitespace(v, 1));
+  case char_class::identifier_start: {
+    const auto length = scan_identifier(v, 1);
+    if (const auto keyword = keyword_lookup(v.substr(0, length)); keyword != symbols::none) {
+      return { token_type::keyword, v.substr(0, length), v.substr(length), keyword };
+    }
+    return ret(token_type::identifier, length);
+  }
+  case char_class::digit: {
+    auto item = ret(token_type::number, scan_number(v));
+    item.number = decode_number(item.match);
+    return item;
+  }
+  case char_class::quote:
+    if (const auto length = scan_quoted_string(v); length != 0) { return ret(token_type::string, length); }
+    break;
+  case char_class::punctuation:
+    if (entry.pair != token_type::unknown && v.size() > 1 && v[1] == entry.second) { return ret(entry.pair, 2); }
+    if (entry.single != token_type::unknown) { return ret(entry.single, 1); }
+    break;
+  case char_class::other:
+    break;
   }
 
-  return lex_item{token_type::unknown, v, v.substr(v.size())};
+  return lex_item{ token_type::unknown, v, v.substr(v.size()) };
 }
 
 }// namespace thing::lexing
 
-#endif
\ No newline at end of file
+#endif
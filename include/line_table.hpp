@@ -0,0 +1,76 @@
+#ifndef THING_LINE_TABLE_HPP
+#define THING_LINE_TABLE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include "lex_item.hpp"
+
+namespace thing {
+
+// Offsets of the first byte of every line of a source buffer, built once so
+// that any diagnostic can be mapped to (line, column) with a binary search
+// instead of rescanning the input.
+template<template<class> class Container_Type> struct basic_line_table
+{
+  using offset_type = std::uint32_t;
+  using allocator_type = typename Container_Type<offset_type>::allocator_type;
+
+  // zero based
+  struct position
+  {
+    std::size_t line;
+    std::size_t column;
+  };
+
+  std::string_view source;
+  Container_Type<offset_type> line_starts;
+
+  constexpr explicit basic_line_table(std::string_view source_, allocator_type alloc = {})
+    : source{ source_ }, line_starts(alloc)
+  {
+    line_starts.push_back(0);
+    // find() is a memchr at runtime, which is vectorized by every libc we care about
+    for (auto newline = source.find('\n'); newline != std::string_view::npos;
+         newline = source.find('\n', newline + 1)) {
+      line_starts.push_back(static_cast<offset_type>(newline + 1));
+    }
+  }
+
+  [[nodiscard]] constexpr std::size_t line_count() const noexcept { return line_starts.size(); }
+
+  [[nodiscard]] constexpr position position_of(const std::size_t offset) const noexcept
+  {
+    const auto next_line = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    const auto line = static_cast<std::size_t>(std::distance(line_starts.begin(), next_line)) - 1;
+    return { line, offset - line_starts[line] };
+  }
+
+  // `view` must point into `source`
+  [[nodiscard]] constexpr std::size_t offset_of(std::string_view view) const noexcept
+  {
+    return static_cast<std::size_t>(view.data() - source.data());
+  }
+
+  // Errors are reported at the end of the offending token, which is where
+  // its remainder begins
+  [[nodiscard]] constexpr position position_of(const lexing::lex_item &item) const noexcept
+  {
+    return position_of(offset_of(item.remainder));
+  }
+
+  // the text of a line, without its newline
+  [[nodiscard]] constexpr std::string_view line(const std::size_t index) const noexcept
+  {
+    const auto start = std::size_t{ line_starts[index] };
+    const auto end = index + 1 < line_starts.size() ? std::size_t{ line_starts[index + 1] } - 1 : source.size();
+    return source.substr(start, end - start);
+  }
+};
+
+}// namespace thing
+
+#endif
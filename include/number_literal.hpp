@@ -0,0 +1,253 @@
+#ifndef THING_NUMBER_LITERAL_HPP
+#define THING_NUMBER_LITERAL_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+// Number tokens are decoded once, by the lexer, so that nothing downstream
+// has to look at their digits again.
+//
+//   integer:  decimal, 0x hex, 0b binary or 0 prefixed octal, with an
+//             optional u, l, ll, ul, lu, ull or llu suffix in any case
+//   float:    digits '.' digits, with an optional decimal (e, E) or binary
+//             (p, P) exponent, then an optional f, F, l or L suffix
+//
+// Integers that fit in int64 and have no u suffix are signed, others are
+// unsigned. Like C++, an unsuffixed decimal literal that does not fit in
+// int64 is an error, where hex, binary and octal ones become unsigned. An f
+// suffix rounds the value to float, long double is treated as double.
+
+namespace thing::lexing {
+
+enum struct number_kind : std::uint8_t { none, signed_integer, unsigned_integer, floating_point, invalid };
+
+struct number_value
+{
+  number_kind kind{ number_kind::none };
+  // integers as their 64 bit pattern, floating point values as a double
+  std::uint64_t bits{ 0 };
+
+  [[nodiscard]] constexpr bool is_valid() const noexcept
+  {
+    return kind != number_kind::none && kind != number_kind::invalid;
+  }
+
+  [[nodiscard]] constexpr std::int64_t as_signed() const noexcept { return static_cast<std::int64_t>(bits); }
+  [[nodiscard]] constexpr std::uint64_t as_unsigned() const noexcept { return bits; }
+  [[nodiscard]] constexpr double as_double() const noexcept { return std::bit_cast<double>(bits); }
+
+  [[nodiscard]] constexpr bool operator==(const number_value &) const noexcept = default;
+};
+
+static constexpr number_value invalid_number{ number_kind::invalid, 0 };
+
+[[nodiscard]] constexpr unsigned digit_value(const char c) noexcept
+{
+  if (c >= '0' && c <= '9') { return static_cast<unsigned>(c - '0'); }
+  if (c >= 'a' && c <= 'z') { return static_cast<unsigned>(c - 'a') + 10; }
+  if (c >= 'A' && c <= 'Z') { return static_cast<unsigned>(c - 'A') + 10; }
+  // not a digit in any base
+  return 36;
+}
+
+// nullopt if `digits` is empty, has a digit outside of `base` or overflows
+[[nodiscard]] constexpr std::optional<std::uint64_t> parse_digits(std::string_view digits, const unsigned base) noexcept
+{
+  if (digits.empty()) { return std::nullopt; }
+
+  if (!std::is_constant_evaluated()) {
+    std::uint64_t value{};
+    const auto end = digits.data() + digits.size();
+    const auto [ptr, error] = std::from_chars(digits.data(), end, value, static_cast<int>(base));
+    if (error != std::errc{} || ptr != end) { return std::nullopt; }
+    return value;
+  }
+
+  std::uint64_t value = 0;
+  for (const char c : digits) {
+    const auto digit = digit_value(c);
+    if (digit >= base || value > (std::numeric_limits<std::uint64_t>::max() - digit) / base) { return std::nullopt; }
+    value = value * base + digit;
+  }
+  return value;
+}
+
+[[nodiscard]] constexpr number_value decode_integer(std::string_view text) noexcept
+{
+  constexpr auto is_suffix = [](const char c) { return c == 'u' || c == 'U' || c == 'l' || c == 'L'; };
+
+  std::size_t suffix_length = 0;
+  while (suffix_length < 3 && suffix_length < text.size() && is_suffix(text[text.size() - suffix_length - 1])) {
+    ++suffix_length;
+  }
+
+  std::array<char, 3> suffix{};
+  for (std::size_t index = 0; index < suffix_length; ++index) {
+    const auto c = text[text.size() - suffix_length + index];
+    suffix[index] = c == 'U' ? 'u' : c == 'L' ? 'l' : c;
+  }
+
+  const auto suffix_text = std::string_view{ suffix.data(), suffix_length };
+  constexpr std::array<std::string_view, 8> valid_suffixes{ "", "u", "l", "ll", "ul", "lu", "ull", "llu" };
+  if (std::find(valid_suffixes.begin(), valid_suffixes.end(), suffix_text) == valid_suffixes.end()) {
+    return invalid_number;
+  }
+
+  auto digits = text.substr(0, text.size() - suffix_length);
+  unsigned base = 10;
+  if (digits.starts_with("0x") || digits.starts_with("0X")) {
+    base = 16;
+    digits.remove_prefix(2);
+  } else if (digits.starts_with("0b") || digits.starts_with("0B")) {
+    base = 2;
+    digits.remove_prefix(2);
+  } else if (digits.size() > 1 && digits.front() == '0') {
+    base = 8;
+    digits.remove_prefix(1);
+  }
+
+  const auto value = parse_digits(digits, base);
+  if (!value) { return invalid_number; }
+
+  auto is_unsigned = suffix_text.find('u') != std::string_view::npos;
+  if (!is_unsigned && *value > static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())) {
+    if (base == 10) { return invalid_number; }
+    is_unsigned = true;
+  }
+
+  return { is_unsigned ? number_kind::unsigned_integer : number_kind::signed_integer, *value };
+}
+
+// Compile time conversion. Exact for up to 19 significant digits with a
+// power of ten up to 22 (Clinger's fast path), which covers the literals
+// scripts use in practice; beyond that the last bit may differ from the
+// correctly rounded runtime result.
+[[nodiscard]] constexpr std::optional<double>
+  constexpr_to_double(std::string_view mantissa, const std::uint64_t exponent, const bool binary_exponent) noexcept
+{
+  std::uint64_t digits = 0;
+  std::int64_t scale = 0;
+  std::size_t significant = 0;
+  bool fraction = false;
+  for (const char c : mantissa) {
+    if (c == '.') {
+      fraction = true;
+    } else if (significant < 19) {
+      digits = digits * 10 + digit_value(c);
+      if (digits != 0) { ++significant; }
+      if (fraction) { --scale; }
+    } else if (!fraction) {
+      // digits that no longer fit only contribute their magnitude
+      ++scale;
+    }
+  }
+
+  constexpr auto max = std::numeric_limits<double>::max();
+  auto value = static_cast<double>(digits);
+  if (value == 0) { return value; }
+
+  // stays clear of overflow, which is not a constant expression
+  const auto scale_by = [&value](const double factor) {
+    if (value > max / factor) { return false; }
+    value *= factor;
+    return true;
+  };
+
+  // powers of ten up to 1e22 are exact in a double
+  constexpr auto exact_powers = [] {
+    std::array<double, 23> powers{};
+    double power = 1;
+    for (auto &entry : powers) {
+      entry = power;
+      power *= 10;
+    }
+    return powers;
+  }();
+
+  if (binary_exponent) {
+    for (auto power = exponent; power > 0; --power) {
+      if (!scale_by(2)) { return std::nullopt; }
+    }
+  } else {
+    if (exponent > 400) { return std::nullopt; }
+    scale += static_cast<std::int64_t>(exponent);
+  }
+
+  for (; scale > 22; scale -= 22) {
+    if (!scale_by(exact_powers[22])) { return std::nullopt; }
+  }
+  for (; scale < -22; scale += 22) { value /= exact_powers[22]; }
+  if (scale < 0) {
+    value /= exact_powers[static_cast<std::size_t>(-scale)];
+  } else if (!scale_by(exact_powers[static_cast<std::size_t>(scale)])) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+[[nodiscard]] constexpr number_value decode_float(std::string_view text) noexcept
+{
+  bool single_precision = false;
+  if (text.ends_with('f') || text.ends_with('F')) {
+    single_precision = true;
+    text.remove_suffix(1);
+  } else if (text.ends_with('l') || text.ends_with('L')) {
+    text.remove_suffix(1);
+  }
+
+  const auto exponent_start = text.find_first_of("eEpP");
+  const auto mantissa = text.substr(0, exponent_start);
+  const auto binary_exponent =
+    exponent_start != std::string_view::npos && (text[exponent_start] == 'p' || text[exponent_start] == 'P');
+
+  std::uint64_t exponent = 0;
+  if (exponent_start != std::string_view::npos) {
+    // an exponent too large for 64 bits is out of range anyway
+    exponent = parse_digits(text.substr(exponent_start + 1), 10).value_or(std::numeric_limits<std::uint64_t>::max());
+  }
+
+  std::optional<double> value;
+  if (std::is_constant_evaluated()) {
+    value = constexpr_to_double(mantissa, exponent, binary_exponent);
+  } else {
+    double result{};
+    const auto decimal = binary_exponent ? mantissa : text;
+    const auto end = decimal.data() + decimal.size();
+    if (const auto [ptr, error] = std::from_chars(decimal.data(), end, result); error == std::errc{} && ptr == end) {
+      if (binary_exponent) {
+        // any exponent past the range of double overflows, or stays zero
+        result = std::ldexp(result, static_cast<int>(std::min(exponent, std::uint64_t{ 4096 })));
+      }
+      value = result;
+    }
+  }
+
+  constexpr auto max = std::numeric_limits<double>::max();
+  if (!value || !(*value <= max)) { return invalid_number; }
+
+  if (single_precision) {
+    if (*value > static_cast<double>(std::numeric_limits<float>::max())) { return invalid_number; }
+    value = static_cast<double>(static_cast<float>(*value));
+  }
+
+  return { number_kind::floating_point, std::bit_cast<std::uint64_t>(*value) };
+}
+
+// `text` is the match of a number token
+[[nodiscard]] constexpr number_value decode_number(std::string_view text) noexcept
+{
+  return text.find('.') == std::string_view::npos ? decode_integer(text) : decode_float(text);
+}
+
+}// namespace thing::lexing
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef THING_PARALLEL_LEXER_HPP
+#define THING_PARALLEL_LEXER_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "lex_item.hpp"
+#include "lexer.hpp"
+#include "symbol_table.hpp"
+#include "token_buffer.hpp"
+
+// Lexing of large buffers on several threads.
+//
+// The buffer is split into one chunk per thread, each starting just after a
+// newline, which is a token boundary unless it is inside a string literal.
+// Every chunk is lexed on its own thread as if it started at a token
+// boundary. The chunks are then stitched together in order: the sequential
+// lexer continues from the end of the previous chunk until it produces a
+// token that starts where one of the chunk's tokens starts. The lexer carries
+// no state between tokens, so from there on the chunk's tokens are exactly
+// the sequential ones. A chunk that started inside a string literal is
+// relexed from the true boundary until the two agree, at worst all of it.
+//
+// The result is identical to tokenize(), including symbol ids: each chunk
+// interns into its own table and the tables are merged in chunk order, as
+// are the decoded numbers.
+
+namespace thing::lexing {
+
+// Runs func(0) ... func(count - 1) concurrently, on the calling thread and
+// count - 1 new ones
+template<typename Func> void parallel_for(const std::size_t count, Func &&func)
+{
+  std::vector<std::jthread> threads;
+  threads.reserve(count);
+  for (std::size_t index = 1; index < count; ++index) { threads.emplace_back(func, index); }
+  if (count != 0) { func(std::size_t{ 0 }); }
+}
+
+template<template<class> class Container_Type> struct lexed_chunk
+{
+  using allocator_type = typename basic_token_buffer<Container_Type>::allocator_type;
+
+  // lexed speculatively, on the chunk's thread
+  basic_token_buffer<Container_Type> tokens;
+  // lexed sequentially while stitching, they precede tokens[reuse_from]
+  Container_Type<lex_item> fresh;
+  std::size_t reuse_from{ 0 };
+  // local symbol id to final symbol id
+  Container_Type<symbol_id> remap;
+  // index in the result's numbers of the chunk's first reused number, and
+  // the chunk's own index for it
+  std::size_t numbers_output{ 0 };
+  std::size_t first_number{ 0 };
+  // index of the chunk's first token in the result
+  std::size_t output{ 0 };
+
+  constexpr lexed_chunk(std::string_view source, allocator_type alloc)
+    : tokens{ source, alloc }, fresh(alloc), remap(alloc)
+  {}
+};
+
+template<template<class> class Container_Type = std::vector>
+[[nodiscard]] basic_token_buffer<Container_Type> parallel_tokenize(std::string_view source,
+  std::size_t thread_count = std::thread::hardware_concurrency(),
+  typename basic_token_buffer<Container_Type>::allocator_type alloc = {})
+{
+  using offset_type = typename basic_token_buffer<Container_Type>::offset_type;
+  assert(source.size() <= std::numeric_limits<offset_type>::max());
+
+  // below this, starting a thread costs more than lexing the chunk
+  constexpr std::size_t min_chunk_size = 64 * 1024;
+  thread_count = std::min(thread_count, source.size() / min_chunk_size);
+  if (thread_count <= 1) { return tokenize<Container_Type>(source, alloc); }
+
+  // chunk `index` owns the tokens starting in [starts[index], starts[index + 1]),
+  // the last one also owns the end_of_file token
+  Container_Type<std::size_t> starts(alloc);
+  starts.push_back(0);
+  for (std::size_t index = 1; index < thread_count; ++index) {
+    const auto newline = source.find('\n', std::max(starts.back(), source.size() / thread_count * index));
+    starts.push_back(newline == std::string_view::npos ? source.size() : newline + 1);
+  }
+  starts.push_back(source.size() + 1);
+
+  Container_Type<lexed_chunk<Container_Type>> chunks(alloc);
+  chunks.reserve(thread_count);
+  for (std::size_t index = 0; index < thread_count; ++index) { chunks.emplace_back(source, alloc); }
+
+  parallel_for(thread_count, [&](const std::size_t index) {
+    auto &tokens = chunks[index].tokens;
+    tokens.reserve((std::min(starts[index + 1], source.size()) - starts[index]) / 4 + 1);
+    for (auto remainder = source.substr(starts[index]);;) {
+      const auto item = lexer(remainder);
+      if (static_cast<std::size_t>(item.match.data() - source.data()) >= starts[index + 1]) { break; }
+      if (item.type != token_type::whitespace) { tokens.push_back(item); }
+      if (item.type == token_type::end_of_file) { break; }
+      remainder = item.remainder;
+    }
+  });
+
+  basic_token_buffer<Container_Type> result{ source, alloc };
+
+  // Stitching is sequential, but normally each chunk agrees with the
+  // sequential lexer on its first token
+  std::size_t position = 0;
+  std::size_t total = 0;
+  bool finished = false;
+  for (auto &chunk : chunks) {
+    const auto &tokens = chunk.tokens;
+    chunk.output = total;
+    chunk.reuse_from = tokens.size();
+
+    for (std::size_t next = 0; !finished;) {
+      while (next < tokens.size() && tokens.offsets[next] < position) { ++next; }
+      // the sequential lexer has passed the whole chunk
+      if (next == tokens.size()) { break; }
+
+      auto item = lexer(source.substr(position));
+      position = source.size() - item.remainder.size();
+      if (item.type == token_type::whitespace) { continue; }
+
+      const auto start = static_cast<std::size_t>(item.match.data() - source.data());
+      while (next < tokens.size() && tokens.offsets[next] < start) { ++next; }
+      if (next < tokens.size() && tokens.offsets[next] == start) {
+        chunk.reuse_from = next;
+        position = tokens.end(tokens.size() - 1);
+        finished = tokens.types[tokens.size() - 1] == token_type::end_of_file;
+        break;
+      }
+
+      // the symbol_ids entry, as the result will store it
+      item.symbol = result.symbol_slot(item);
+      chunk.fresh.push_back(item);
+      finished = item.type == token_type::end_of_file;
+    }
+
+    // intern the chunk's names in the order in which the sequential lexer
+    // would have seen them
+    chunk.remap.resize(tokens.symbols.size());
+    for (symbol_id id = 0; id < first_identifier; ++id) { chunk.remap[id] = id; }
+    if (chunk.reuse_from == 0) {
+      // the chunk's own table is in that order already
+      for (auto id = first_identifier; id < tokens.symbols.size(); ++id) {
+        chunk.remap[id] = result.symbols.intern(tokens.symbols.name(id));
+      }
+    } else {
+      for (auto index = chunk.reuse_from; index < tokens.size(); ++index) {
+        if (tokens.types[index] == token_type::identifier) {
+          chunk.remap[tokens.symbol_ids[index]] = result.symbols.intern(tokens.match(index));
+        }
+      }
+    }
+
+    // the chunk's numbers are in token order, so the reused ones are a suffix
+    chunk.first_number = tokens.numbers.size();
+    for (auto index = chunk.reuse_from; index < tokens.size(); ++index) {
+      if (tokens.types[index] == token_type::number) {
+        chunk.first_number = tokens.symbol_ids[index];
+        break;
+      }
+    }
+    chunk.numbers_output = result.numbers.size();
+    result.numbers.insert(result.numbers.end(),
+      std::next(tokens.numbers.begin(), static_cast<std::ptrdiff_t>(chunk.first_number)),
+      tokens.numbers.end());
+
+    total += chunk.fresh.size() + (tokens.size() - chunk.reuse_from);
+  }
+
+  result.types.resize(total);
+  result.offsets.resize(total);
+  result.lengths.resize(total);
+  result.symbol_ids.resize(total);
+
+  parallel_for(thread_count, [&](const std::size_t index) {
+    const auto &chunk = chunks[index];
+    auto output = chunk.output;
+
+    for (const auto &item : chunk.fresh) {
+      result.types[output] = item.type;
+      result.offsets[output] = static_cast<offset_type>(item.match.data() - source.data());
+      result.lengths[output] = static_cast<offset_type>(item.match.size());
+      result.symbol_ids[output] = item.symbol;
+      ++output;
+    }
+
+    const auto &tokens = chunk.tokens;
+    for (auto token = chunk.reuse_from; token < tokens.size(); ++token, ++output) {
+      result.types[output] = tokens.types[token];
+      result.offsets[output] = tokens.offsets[token];
+      result.lengths[output] = tokens.lengths[token];
+      result.symbol_ids[output] = tokens.types[token] == token_type::number
+                                    ? static_cast<symbol_id>(
+                                      tokens.symbol_ids[token] - chunk.first_number + chunk.numbers_output)
+                                    : chunk.remap[tokens.symbol_ids[token]];
+    }
+  });
+
+  return result;
+}
+
+}// namespace thing::lexing
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef THING_PARALLEL_PARSER_HPP
+#define THING_PARALLEL_PARSER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+
+#include "lex_item.hpp"
+#include "parallel_lexer.hpp"
+#include "parser.hpp"
+#include "token_buffer.hpp"
+
+// Parsing the top-level definitions of a script on several threads.
+//
+// Definitions are parsed independently of each other, each as if it was all
+// of the script, and where one ends only depends on bracket matching (see
+// basic_parser::end_of_definition). A pre-pass over the token types finds
+// these boundaries and cuts the script at some of them into tasks of about
+// the same number of tokens, several per thread. The threads take the next
+// unclaimed task until none are left, so that one that drew long definitions
+// does not hold up the others, and the definitions of each task are then
+// moved into the result in order.
+//
+// The result, error nodes included, is identical to parse_definitions() with
+// the same parser settings, so errors are reported in the same order. Every
+// thread allocates its nodes with the parser's allocator, which must be
+// thread-safe: not one that draws from a parse_arena.
+
+namespace thing::parsing {
+
+template<template<class> class Container_Type, typename Tree_Builder> struct parse_task
+{
+  using result_type = typename Tree_Builder::result_type;
+  using allocator_type = typename basic_parser<Container_Type, Tree_Builder>::allocator_type;
+
+  // whole definitions, from the one at token `begin` to the one that ends at `end`
+  std::size_t begin;
+  std::size_t end;
+  Container_Type<result_type> definitions;
+
+  constexpr parse_task(const std::size_t begin_, const std::size_t end_, allocator_type alloc)
+    : begin{ begin_ }, end{ end_ }, definitions(alloc)
+  {}
+};
+
+template<template<class> class Container_Type, typename Tree_Builder>
+[[nodiscard]] Container_Type<typename Tree_Builder::result_type>
+  parallel_parse_definitions(const basic_parser<Container_Type, Tree_Builder> &settings,
+    const lexing::basic_token_buffer<Container_Type> &tokens,
+    std::size_t thread_count = std::thread::hardware_concurrency())
+{
+  using parser_type = basic_parser<Container_Type, Tree_Builder>;
+  const auto alloc = settings.alloc;
+
+  // below this, starting a thread costs more than parsing its share
+  constexpr std::size_t min_tokens_per_thread = 16 * 1024;
+  constexpr std::size_t tasks_per_thread = 8;
+  thread_count = std::min(thread_count, tokens.size() / min_tokens_per_thread);
+  if (thread_count <= 1) { return parser_type{ settings, alloc }.parse_definitions(tokens); }
+
+  // every task ends at the first definition boundary past its share of the tokens
+  const auto task_size = tokens.size() / (thread_count * tasks_per_thread) + 1;
+  Container_Type<parse_task<Container_Type, Tree_Builder>> tasks(alloc);
+  tasks.reserve(thread_count * tasks_per_thread);
+  for (std::size_t begin = 0, end = 0; tokens.types[begin] != lexing::token_type::end_of_file; begin = end) {
+    while (end - begin < task_size && tokens.types[end] != lexing::token_type::end_of_file) {
+      end = parser_type::end_of_definition(tokens, end);
+    }
+    tasks.emplace_back(begin, end, alloc);
+  }
+
+  std::atomic<std::size_t> next_task{ 0 };
+  lexing::parallel_for(thread_count, [&](std::size_t) {
+    parser_type parser{ settings, alloc };
+    for (auto task = next_task++; task < tasks.size(); task = next_task++) {
+      auto &parsed = tasks[task];
+      for (auto index = parsed.begin; index < parsed.end;) {
+        const auto end = parser_type::end_of_definition(tokens, index);
+        parser.parse_definition(tokens, index, end, parsed.definitions);
+        index = end;
+      }
+    }
+  });
+
+  std::size_t total = 0;
+  for (const auto &parsed : tasks) { total += parsed.definitions.size(); }
+  Container_Type<typename Tree_Builder::result_type> result(alloc);
+  result.reserve(total);
+  for (auto &parsed : tasks) {
+    result.insert(result.end(),
+      std::make_move_iterator(parsed.definitions.begin()),
+      std::make_move_iterator(parsed.definitions.end()));
+  }
+  return result;
+}
+
+}// namespace thing::parsing
+
+#endif
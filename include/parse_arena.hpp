@@ -0,0 +1,56 @@
+#ifndef THING_PARSE_ARENA_HPP
+#define THING_PARSE_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include "parser.hpp"
+
+// Parsing many short scripts, one after the other, without a call to malloc
+// and free per node.
+//
+// A parser, token_buffer or tree built on std::pmr::vector with the arena's
+// allocator takes all of its memory from one monotonic_buffer_resource.
+// Deallocation is a no-op, and reset() hands the whole buffer out again. That
+// is O(1) as long as a parse fits in the initial buffer; memory requested
+// beyond it comes from `upstream` and is returned to it on reset().
+//
+//   thing::parsing::parse_arena arena;
+//   for (const auto script : scripts) {
+//     {
+//       thing::parsing::pmr_parser parser{ arena.allocator() };
+//       const auto tree = parser.parse(script);
+//       ...
+//     }
+//     arena.reset();
+//   }
+//
+// Everything allocated from the arena, parsers included, must be destroyed
+// before reset(), as their destructors still walk the memory they own.
+
+namespace thing::parsing {
+
+using pmr_parser = basic_parser<std::pmr::vector>;
+
+struct parse_arena
+{
+  static constexpr std::size_t default_capacity = std::size_t{ 256 } * 1024;
+
+  std::unique_ptr<std::byte[]> buffer;
+  std::pmr::monotonic_buffer_resource resource;
+
+  explicit parse_arena(const std::size_t capacity = default_capacity,
+    std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+    : buffer{ std::make_unique<std::byte[]>(capacity) }, resource{ buffer.get(), capacity, upstream }
+  {}
+
+  [[nodiscard]] std::pmr::polymorphic_allocator<std::byte> allocator() noexcept { return &resource; }
+
+  void reset() noexcept { resource.release(); }
+};
+
+}// namespace thing::parsing
+
+#endif
@@ -0,0 +1,458 @@
+#ifndef THING_PARSE_CACHE_HPP
+#define THING_PARSE_CACHE_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "containers.hpp"
+#include "flat_parse_tree.hpp"
+#include "parser.hpp"
+#include "source_file.hpp"
+#include "token_buffer.hpp"
+
+// A cache of flat parse trees on disk, so that scripts that were parsed once
+// are not lexed and parsed again by the next process.
+//
+// Entries are named after a hash of the source text and hold a header, the
+// values of the tree's number literals, the names of its identifiers and its
+// nodes, exactly as they are laid out in memory, with padding zeroed so that
+// the same source always gives the same bytes, and last the source itself. Loading an entry maps it and
+// views the numbers and nodes where they are, through a
+// basic_flat_parse_tree<borrowed_vector>; nothing is copied or rebuilt but
+// the symbol table, which is interned again from the names, as offsets into
+// the source, so that the symbols of identifiers resolve on a hit as well.
+//
+// An entry is only used if its header matches this build (format version,
+// node size and byte order) and the source (hash and size), if its copy of
+// the source is the same byte for byte, so that sources whose hashes collide
+// never share an entry, if the checksums of its numbers, names and nodes are
+// right, if every node stays within the tree, the numbers, the names and the
+// source, and if the children of every node are `child_count` siblings that
+// end exactly where its subtree does.
+// The checksums only catch accidents; it is the structural checks that keep
+// a doctored entry from leading the tree's iterators out of its nodes.
+// Anything else, including a truncated or otherwise corrupt file, is treated
+// as a miss: the source is parsed again and the entry replaced.
+//
+// Entries are written to a temporary file and renamed into place, so that
+// processes sharing a cache directory never see half of one. Failing to write
+// an entry is not an error, the tree is then used from memory.
+
+namespace thing {
+
+// 64-bit hash in the manner of xxh64, over a single lane rather than four.
+// Every word goes through a multiply and rotate of its own before it is
+// mixed in, and the result through xxh64's avalanche, so that every input
+// bit can reach every output bit.
+[[nodiscard]] inline std::uint64_t content_hash(const void *data, const std::size_t size) noexcept
+{
+  constexpr std::uint64_t prime_1 = 0x9E3779B185EBCA87ull;
+  constexpr std::uint64_t prime_2 = 0xC2B2AE3D27D4EB4Full;
+  constexpr std::uint64_t prime_3 = 0x165667B19E3779F9ull;
+  constexpr std::uint64_t prime_4 = 0x85EBCA77C2B2AE63ull;
+  constexpr std::uint64_t prime_5 = 0x27D4EB2F165667C5ull;
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  std::uint64_t result = prime_5 + size;
+
+  std::size_t index = 0;
+  for (; index + sizeof(std::uint64_t) <= size; index += sizeof(std::uint64_t)) {
+    std::uint64_t word{};
+    std::memcpy(&word, bytes + index, sizeof(word));
+    result ^= std::rotl(word * prime_2, 31) * prime_1;
+    result = std::rotl(result, 27) * prime_1 + prime_4;
+  }
+  for (; index < size; ++index) {
+    result ^= bytes[index] * prime_5;
+    result = std::rotl(result, 11) * prime_1;
+  }
+
+  result ^= result >> 33;
+  result *= prime_2;
+  result ^= result >> 29;
+  result *= prime_3;
+  result ^= result >> 32;
+  return result;
+}
+
+[[nodiscard]] inline std::uint64_t content_hash(const std::string_view text) noexcept
+{
+  return content_hash(text.data(), text.size());
+}
+
+using cached_parse_tree = parsing::basic_flat_parse_tree<borrowed_vector>;
+
+// A tree, and whatever holds its nodes: the mapped cache entry, or the
+// nodes of a fresh parse when the entry could not be used. tree stays valid
+// across moves.
+struct cached_parse
+{
+  using node = cached_parse_tree::node;
+
+#ifdef THING_HAS_MMAP
+  mapped_region region;
+#endif
+  std::vector<lexing::number_value> numbers;
+  std::vector<node> nodes;
+  cached_parse_tree tree{ {} };
+  // resolves the symbols of the tree's identifiers
+  lexing::basic_symbol_table<std::vector> symbols;
+  // true if the tree was loaded from the cache
+  bool hit{ false };
+};
+
+struct parse_cache
+{
+  // bump whenever the parser's output or the layout of the nodes changes
+  static constexpr std::uint32_t format_version = 4;
+  static constexpr std::array<char, 8> magic{ 't', 'h', 'i', 'n', 'g', 'p', 't', '\0' };
+  static constexpr std::uint32_t byte_order = 0x01020304;
+
+  using node = cached_parse_tree::node;
+  using number = lexing::number_value;
+
+  // the name of the symbol `first_identifier + i`, as the i-th of these
+  struct symbol_name
+  {
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+
+  struct header
+  {
+    std::array<char, 8> magic;
+    std::uint32_t format_version;
+    std::uint32_t byte_order;
+    std::uint64_t node_size;
+    std::uint64_t source_hash;
+    std::uint64_t source_size;
+    std::uint64_t node_count;
+    std::uint64_t node_checksum;
+    std::uint64_t number_count;
+    std::uint64_t number_checksum;
+    std::uint64_t name_count;
+    std::uint64_t name_checksum;
+  };
+
+  // the numbers follow the header, the names the numbers, the nodes the
+  // names and the source the nodes
+  static_assert(sizeof(header) % alignof(number) == 0);
+  static_assert(sizeof(number) % alignof(symbol_name) == 0);
+  static_assert(sizeof(symbol_name) % alignof(node) == 0);
+
+  std::filesystem::path directory;
+
+  explicit parse_cache(std::filesystem::path directory_) : directory{ std::move(directory_) }
+  {
+    std::filesystem::create_directories(directory);
+  }
+
+  [[nodiscard]] std::filesystem::path entry_path(const std::uint64_t source_hash) const
+  {
+    constexpr std::string_view digits = "0123456789abcdef";
+    std::string name(16, '0');
+    for (std::size_t digit = 0; digit < name.size(); ++digit) {
+      name[name.size() - 1 - digit] = digits[(source_hash >> (4 * digit)) & 0xF];
+    }
+    return directory / (name + ".tree");
+  }
+
+  // The tree of `source`, which must outlive it, from the cache if possible
+  [[nodiscard]] cached_parse parse(const std::string_view source) const
+  {
+    const auto source_hash = content_hash(source);
+    const auto path = entry_path(source_hash);
+
+    cached_parse result;
+    if (load(path, source, source_hash, result)) {
+      result.hit = true;
+      return result;
+    }
+
+    parsing::basic_flat_parser<std::vector> parser;
+    auto tokens = lexing::tokenize(source);
+    auto parsed = parser.parse(tokens);
+    store(path, source, source_hash, parsed.numbers, tokens.symbols, parsed.nodes);
+
+    result.symbols = std::move(tokens.symbols);
+    result.numbers = std::move(parsed.numbers);
+    result.nodes = std::move(parsed.nodes);
+    result.tree = cached_parse_tree{ source };
+    result.tree.numbers = { result.numbers.data(), result.numbers.size() };
+    result.tree.nodes = { result.nodes.data(), result.nodes.size() };
+    return result;
+  }
+
+  // true if an entry of `entry_size` bytes is exactly the header and the
+  // numbers, names, nodes and source that it counts
+  [[nodiscard]] static bool fits(const header &entry, const std::size_t entry_size) noexcept
+  {
+    if (entry_size < sizeof(header) || entry.number_count > entry_size / sizeof(number)
+        || entry.name_count > entry_size / sizeof(symbol_name) || entry.node_count > entry_size / sizeof(node)
+        || entry.source_size > entry_size) {
+      return false;
+    }
+    return sizeof(header) + entry.number_count * sizeof(number) + entry.name_count * sizeof(symbol_name)
+             + entry.node_count * sizeof(node) + entry.source_size
+           == entry_size;
+  }
+
+  // true if the children of `nodes[index]`, which stays within the tree,
+  // are `child_count` siblings that end exactly at its `subtree_end`
+  [[nodiscard]] static bool children_fit(const node *nodes, const std::size_t index) noexcept
+  {
+    const auto &parent = nodes[index];
+    auto child = index + 1;
+    for (std::size_t count = 0; count < parent.child_count; ++count) {
+      if (child >= parent.subtree_end || nodes[child].subtree_end > parent.subtree_end) { return false; }
+      child = nodes[child].subtree_end;
+    }
+    return child == parent.subtree_end;
+  }
+
+  // the header, numbers, names, nodes and source must agree; see above. The
+  // entry must fit() its size.
+  [[nodiscard]] static bool valid(const header &entry,
+    const number *numbers,
+    const symbol_name *names,
+    const node *nodes,
+    const char *stored_source,
+    const std::string_view source,
+    const std::uint64_t source_hash) noexcept
+  {
+    if (entry.magic != magic || entry.format_version != format_version || entry.byte_order != byte_order
+        || entry.node_size != sizeof(node) || entry.source_hash != source_hash || entry.source_size != source.size()
+        || entry.node_count == 0) {
+      return false;
+    }
+
+    if (std::string_view{ stored_source, entry.source_size } != source) { return false; }
+
+    if (content_hash(numbers, entry.number_count * sizeof(number)) != entry.number_checksum
+        || content_hash(names, entry.name_count * sizeof(symbol_name)) != entry.name_checksum
+        || content_hash(nodes, entry.node_count * sizeof(node)) != entry.node_checksum) {
+      return false;
+    }
+
+    for (std::size_t index = 0; index < entry.name_count; ++index) {
+      if (names[index].length == 0 || std::size_t{ names[index].offset } + names[index].length > source.size()) {
+        return false;
+      }
+    }
+
+    const auto symbol_count = lexing::first_identifier + entry.name_count;
+    for (std::size_t index = 0; index < entry.node_count; ++index) {
+      const auto &current = nodes[index];
+      if (current.subtree_end <= index || current.subtree_end > entry.node_count
+          || std::size_t{ current.offset } + current.length > source.size()
+          || current.symbol >= (current.type == lexing::token_type::number ? entry.number_count : symbol_count)) {
+        return false;
+      }
+    }
+    if (nodes[0].subtree_end != entry.node_count) { return false; }
+
+    // every node's subtree is within the tree now, so the walks stay in it
+    for (std::size_t index = 0; index < entry.node_count; ++index) {
+      if (!children_fit(nodes, index)) { return false; }
+    }
+    return true;
+  }
+
+  // interns `names` into `symbols`, which is fresh, true if each gets the id
+  // that the tree refers to it by
+  [[nodiscard]] static bool restore_symbols(const symbol_name *names,
+    const std::size_t name_count,
+    const std::string_view source,
+    lexing::basic_symbol_table<std::vector> &symbols)
+  {
+    for (std::size_t index = 0; index < name_count; ++index) {
+      const auto id = symbols.intern(source.substr(names[index].offset, names[index].length));
+      if (id != lexing::first_identifier + index) { return false; }
+    }
+    return true;
+  }
+
+  [[nodiscard]] static bool load(const std::filesystem::path &path,
+    const std::string_view source,
+    const std::uint64_t source_hash,
+    cached_parse &result)
+  {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) { return false; }
+
+    try {
+#ifdef THING_HAS_MMAP
+      const file_descriptor file{ path };
+      const auto size = file.size(path);
+      if (size < sizeof(header)) { return false; }
+      result.region = mapped_region{ path, file, 0, size };
+
+      header entry{};
+      std::memcpy(&entry, result.region.address, sizeof(entry));
+      if (!fits(entry, size)) {
+        result.region = mapped_region{};
+        return false;
+      }
+      const auto *numbers =
+        reinterpret_cast<const number *>(static_cast<const char *>(result.region.address) + sizeof(header));
+      const auto *names = reinterpret_cast<const symbol_name *>(numbers + entry.number_count);
+      const auto *nodes = reinterpret_cast<const node *>(names + entry.name_count);
+      const auto *stored_source = reinterpret_cast<const char *>(nodes + entry.node_count);
+      if (!valid(entry, numbers, names, nodes, stored_source, source, source_hash)
+          || !restore_symbols(names, entry.name_count, source, result.symbols)) {
+        result.region = mapped_region{};
+        result.symbols = lexing::basic_symbol_table<std::vector>{};
+        return false;
+      }
+#else
+      std::ifstream file{ path, std::ios::binary };
+      header entry{};
+      if (!file.read(reinterpret_cast<char *>(&entry), sizeof(entry))) { return false; }
+      const auto size = static_cast<std::size_t>(std::filesystem::file_size(path));
+      if (!fits(entry, size)) { return false; }
+      std::vector<symbol_name> names(entry.name_count);
+      std::string stored_source(entry.source_size, '\0');
+      result.numbers.resize(entry.number_count);
+      result.nodes.resize(entry.node_count);
+      if (!file.read(reinterpret_cast<char *>(result.numbers.data()),
+            static_cast<std::streamsize>(entry.number_count * sizeof(number)))
+          || !file.read(reinterpret_cast<char *>(names.data()),
+            static_cast<std::streamsize>(entry.name_count * sizeof(symbol_name)))
+          || !file.read(reinterpret_cast<char *>(result.nodes.data()),
+            static_cast<std::streamsize>(entry.node_count * sizeof(node)))
+          || !file.read(stored_source.data(), static_cast<std::streamsize>(stored_source.size()))
+          || !valid(entry,
+            result.numbers.data(),
+            names.data(),
+            result.nodes.data(),
+            stored_source.data(),
+            source,
+            source_hash)
+          || !restore_symbols(names.data(), entry.name_count, source, result.symbols)) {
+        result.numbers.clear();
+        result.nodes.clear();
+        result.symbols = lexing::basic_symbol_table<std::vector>{};
+        return false;
+      }
+      const auto *numbers = result.numbers.data();
+      const auto *nodes = result.nodes.data();
+#endif
+
+      result.tree = cached_parse_tree{ source };
+      result.tree.numbers = { numbers, entry.number_count };
+      result.tree.nodes = { nodes, entry.node_count };
+      return true;
+    } catch (const std::system_error &) {
+      // removed or made unreadable since we looked, parse it again
+      return false;
+    }
+  }
+
+  // Copies of the nodes and numbers, field by field into zeroed memory, so
+  // that their padding, which is written and hashed along with them, is the
+  // same every time
+  [[nodiscard]] static std::vector<node> canonical(const std::vector<node> &nodes)
+  {
+    std::vector<node> result(nodes.size());
+    std::memset(static_cast<void *>(result.data()), 0, result.size() * sizeof(node));
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+      auto &copy = result[index];
+      const auto &original = nodes[index];
+      copy.type = original.type;
+      copy.error = original.error;
+      copy.expected_token = original.expected_token;
+      copy.offset = original.offset;
+      copy.length = original.length;
+      copy.symbol = original.symbol;
+      copy.child_count = original.child_count;
+      copy.subtree_end = original.subtree_end;
+    }
+    return result;
+  }
+
+  [[nodiscard]] static std::vector<number> canonical(const std::vector<number> &numbers)
+  {
+    std::vector<number> result(numbers.size());
+    std::memset(static_cast<void *>(result.data()), 0, result.size() * sizeof(number));
+    for (std::size_t index = 0; index < numbers.size(); ++index) {
+      result[index].kind = numbers[index].kind;
+      result[index].bits = numbers[index].bits;
+    }
+    return result;
+  }
+
+  // the names of the identifiers of `symbols`, which point into `source`
+  [[nodiscard]] static std::vector<symbol_name> names_of(const lexing::basic_symbol_table<std::vector> &symbols,
+    const std::string_view source)
+  {
+    std::vector<symbol_name> result;
+    result.reserve(symbols.size() - lexing::first_identifier);
+    for (auto id = lexing::first_identifier; id < symbols.size(); ++id) {
+      const auto text = symbols.name(id);
+      result.push_back({ static_cast<std::uint32_t>(text.data() - source.data()),
+        static_cast<std::uint32_t>(text.size()) });
+    }
+    return result;
+  }
+
+  static void store(const std::filesystem::path &path,
+    const std::string_view source,
+    const std::uint64_t source_hash,
+    const std::vector<number> &numbers_,
+    const lexing::basic_symbol_table<std::vector> &symbols,
+    const std::vector<node> &nodes_)
+  {
+    const auto numbers = canonical(numbers_);
+    const auto names = names_of(symbols, source);
+    const auto nodes = canonical(nodes_);
+    const auto number_bytes = numbers.size() * sizeof(number);
+    const auto name_bytes = names.size() * sizeof(symbol_name);
+    const auto bytes = nodes.size() * sizeof(node);
+    const header entry{ magic,
+      format_version,
+      byte_order,
+      sizeof(node),
+      source_hash,
+      source.size(),
+      nodes.size(),
+      content_hash(nodes.data(), bytes),
+      numbers.size(),
+      content_hash(numbers.data(), number_bytes),
+      names.size(),
+      content_hash(names.data(), name_bytes) };
+
+    auto temporary = path;
+    temporary += ".tmp" + std::to_string(std::random_device{}());
+    {
+      std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+      file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+      file.write(reinterpret_cast<const char *>(numbers.data()), static_cast<std::streamsize>(number_bytes));
+      file.write(reinterpret_cast<const char *>(names.data()), static_cast<std::streamsize>(name_bytes));
+      file.write(reinterpret_cast<const char *>(nodes.data()), static_cast<std::streamsize>(bytes));
+      file.write(source.data(), static_cast<std::streamsize>(source.size()));
+      if (!file.flush()) {
+        file.close();
+        std::error_code error;
+        std::filesystem::remove(temporary, error);
+        return;
+      }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) { std::filesystem::remove(temporary, error); }
+  }
+};
+
+}// namespace thing
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef THING_PARSE_EVENTS_HPP
+#define THING_PARSE_EVENTS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "lex_item.hpp"
+#include "parse_node.hpp"
+#include "parser.hpp"
+
+// Parsing into a stream of events instead of a tree.
+//
+// basic_event_builder is a tree builder for basic_parser that builds nothing:
+// its nodes are small values that live in the parser's frames while they are
+// open, and a handler is told about each of them as it is completed. Memory
+// use is the frames, O(nesting depth), whatever the size of the script.
+//
+// Nodes are reported once they are complete, which is after their children.
+// A Pratt parser only learns the parent of an expression after it has parsed
+// it (in `a + b`, `a` comes before the `+` that it becomes a child of), so
+// there is no event on entering a node, and a node can wait on a frame while
+// other subtrees are completed (the left operand of `/` in `(a + b) / c`
+// while `c` is parsed). Every node therefore carries an id, unique within a
+// parse, and is reported with the id of its parent and its position among
+// the children. The handler's members are
+//
+//   leave_node(const event_node &)    a node of the tree is complete, after
+//                                     all of its child_count children
+//   error(const event_node &)         an error node, when the parser creates
+//                                     it, so before its leave_node
+//   discard_node(const event_node &)  a node that the parser dropped after an
+//                                     error; it has no leave_node, and neither
+//                                     it nor its children are part of the tree
+//
+// parse_event_handler has empty versions of all of them, to derive from.
+// Every parse that finds an error reports at least one through error().
+//
+// basic_node_tree_handler rebuilds the basic_parse_node tree from the events,
+// and produces the same tree as basic_node_tree_builder.
+
+namespace thing::parsing {
+
+// a node, as seen by the parser and the handler
+struct event_node
+{
+  static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+  lexing::lex_item item;
+  std::size_t id{ none };
+  // none for the root, and for nodes that are not in the tree (yet)
+  std::size_t parent{ none };
+  // among the children of parent
+  std::size_t index{ 0 };
+  error_type error{ error_type::no_error };
+  lexing::token_type expected_token{};
+  std::size_t child_count{ 0 };
+  lexing::token_type last_child_type{ lexing::token_type::unknown };
+
+  [[nodiscard]] constexpr bool is_error() const noexcept { return error != error_type::no_error; }
+};
+
+struct parse_event_handler
+{
+  constexpr void leave_node([[maybe_unused]] const event_node &node) noexcept {}
+  constexpr void error([[maybe_unused]] const event_node &node) noexcept {}
+  constexpr void discard_node([[maybe_unused]] const event_node &node) noexcept {}
+};
+
+template<typename Handler> struct basic_event_builder
+{
+  using node = event_node;
+  // the root, which was the last node reported
+  using result_type = event_node;
+
+  Handler handler;
+  // the id of the next node
+  std::size_t next_id{ 0 };
+
+  constexpr basic_event_builder() = default;
+
+  // nothing is allocated, the parser's allocator is not needed
+  template<typename Allocator> constexpr explicit basic_event_builder([[maybe_unused]] const Allocator &alloc) {}
+
+  constexpr void reset([[maybe_unused]] std::string_view source) noexcept { next_id = 0; }
+
+  [[nodiscard]] constexpr node leaf(const lexing::lex_item &item) noexcept
+  {
+    node result{ item };
+    result.id = next_id++;
+    return result;
+  }
+
+  [[nodiscard]] constexpr node
+    error(const lexing::lex_item &item, const error_type error_, const lexing::token_type expected = {})
+  {
+    auto result = leaf(item);
+    result.error = error_;
+    result.expected_token = expected;
+    handler.error(std::as_const(result));
+    return result;
+  }
+
+  template<typename... Children> [[nodiscard]] constexpr node branch(const lexing::lex_item &item, Children... children)
+  {
+    auto parent = leaf(item);
+    (append(parent, std::move(children)), ...);
+    return parent;
+  }
+
+  constexpr void append(node &parent, node &&child)
+  {
+    child.parent = parent.id;
+    child.index = parent.child_count++;
+    parent.last_child_type = child.item.type;
+    handler.leave_node(std::as_const(child));
+  }
+
+  constexpr void relabel(node &target, const lexing::lex_item &item) const noexcept { target.item = item; }
+
+  constexpr void discard(node &&target) { handler.discard_node(std::as_const(target)); }
+
+  [[nodiscard]] static constexpr lexing::token_type type(const node &target) noexcept { return target.item.type; }
+
+  [[nodiscard]] static constexpr bool is_error(const node &target) noexcept { return target.is_error(); }
+
+  [[nodiscard]] static constexpr lexing::token_type last_child_type(const node &target) noexcept
+  {
+    return target.last_child_type;
+  }
+
+  [[nodiscard]] constexpr result_type finish(node &&root)
+  {
+    handler.leave_node(std::as_const(root));
+    return std::move(root);
+  }
+};
+
+template<template<class> class Container_Type, typename Handler>
+using basic_event_parser = basic_parser<Container_Type, basic_event_builder<Handler>>;
+
+// Builds the basic_parse_node tree from the events. Completed subtrees wait
+// until their parent takes them.
+template<template<class> class Container_Type> struct basic_node_tree_handler : parse_event_handler
+{
+  using parse_node = basic_parse_node<Container_Type>;
+  using allocator_type = typename parse_node::allocator_type;
+
+  struct subtree
+  {
+    std::size_t parent;
+    parse_node root;
+  };
+
+  Container_Type<subtree> completed;
+
+  constexpr explicit basic_node_tree_handler(allocator_type alloc = {}) : completed(alloc) {}
+
+  // the children of `node` are the last completed subtrees of that parent,
+  // apart from those that are still waiting for a parent of their own
+  constexpr void leave_node(const event_node &node)
+  {
+    parse_node result{ node.item, node.error, node.expected_token, completed.get_allocator() };
+    result.children.resize(node.child_count);
+    take_children(
+      node, [&](subtree &child, const std::size_t index) { result.children[index] = std::move(child.root); });
+    completed.push_back({ node.parent, std::move(result) });
+  }
+
+  constexpr void discard_node(const event_node &node)
+  {
+    take_children(node, []([[maybe_unused]] subtree &child, [[maybe_unused]] const std::size_t index) {});
+  }
+
+  template<typename Take> constexpr void take_children(const event_node &node, Take &&take)
+  {
+    const auto is_child = [&](const subtree &entry) { return entry.parent == node.id; };
+    auto index = node.child_count;
+    auto first = completed.end();
+    while (index != 0) {
+      --first;
+      if (is_child(*first)) { take(*first, --index); }
+    }
+    completed.erase(std::remove_if(first, completed.end(), is_child), completed.end());
+  }
+
+  // the tree of the last parse
+  [[nodiscard]] constexpr parse_node take_root()
+  {
+    auto root = std::move(completed.back().root);
+    completed.clear();
+    return root;
+  }
+};
+
+}// namespace thing::parsing
+
+#endif
@@ -2,14 +2,27 @@
 #define THING_PARSE_NODE_HPP
 
 #include "lex_item.hpp"
+#include <cstdint>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 
 namespace thing::parsing {
 
+// shared by every kind of parse tree, whatever its containers
+enum struct error_type : std::uint8_t {
+  no_error,
+  wrong_token_type,
+  unexpected_prefix_token,
+  unexpected_infix_token,
+  invalid_number_literal,
+  nesting_too_deep
+};
+
 template<template<class> class Container_Type> struct basic_parse_node
 {
-  enum struct error_type { no_error, wrong_token_type, unexpected_prefix_token, unexpected_infix_token };
+  using error_type = parsing::error_type;
 
   using container_type = Container_Type<basic_parse_node>;
 
@@ -26,9 +39,19 @@ template<template<class> class Container_Type> struct basic_parse_node
 
   [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return children.get_allocator(); }
 
-  constexpr explicit basic_parse_node(lexing::lex_item item_,
-    container_type &&children_ = {},
-    allocator_type alloc = {})
+  // Every constructor that takes an allocator uses it for the whole node,
+  // and the copy and move constructors keep every member. Containers with
+  // scoped allocators, like std::pmr::vector, construct their elements
+  // through the allocator extended overloads, so this is what keeps a whole
+  // tree on one memory resource.
+  constexpr explicit basic_parse_node(lexing::lex_item item_, container_type &&children_ = {})
+    : item{ std::move(item_) }, children{ std::move(children_) }
+  {}
+
+  constexpr basic_parse_node(lexing::lex_item item_, allocator_type alloc) : item{ std::move(item_) }, children{ alloc }
+  {}
+
+  constexpr basic_parse_node(lexing::lex_item item_, container_type &&children_, allocator_type alloc)
     : item{ std::move(item_) }, children{ std::move(children_), alloc }
   {}
 
@@ -41,14 +64,81 @@ template<template<class> class Container_Type> struct basic_parse_node
 
   constexpr basic_parse_node() : basic_parse_node(allocator_type{}) {}
   constexpr explicit basic_parse_node(allocator_type alloc) : children(alloc) {}
+
+  constexpr basic_parse_node(const basic_parse_node &) = default;
+  constexpr basic_parse_node(const basic_parse_node &other, allocator_type alloc)
+    : item{ other.item }, children{ other.children, alloc }, error{ other.error },
+      expected_token{ other.expected_token }
+  {}
+
   constexpr basic_parse_node(basic_parse_node &&) noexcept = default;
-  constexpr basic_parse_node(const basic_parse_node &other, allocator_type alloc = {}) : children( other.children, alloc ) {}
-  ~basic_parse_node() = default;
-  constexpr basic_parse_node(basic_parse_node &&other, allocator_type alloc) : children( std::move(other.children), alloc ) {}
-  basic_parse_node &operator=(basic_parse_node &&) noexcept = default;
-  basic_parse_node &operator=(const basic_parse_node &) = default;
+  constexpr basic_parse_node(basic_parse_node &&other, allocator_type alloc)
+    : item{ std::move(other.item) }, children{ std::move(other.children), alloc }, error{ other.error },
+      expected_token{ other.expected_token }
+  {}
+
+  constexpr ~basic_parse_node() = default;
+  constexpr basic_parse_node &operator=(basic_parse_node &&) noexcept = default;
+  constexpr basic_parse_node &operator=(const basic_parse_node &) = default;
 };
 
+// basic_parser builds its output through a tree builder. This one builds
+// trees of basic_parse_nodes, each node owning its children; see
+// flat_parse_tree.hpp for one that builds a single node array per parse.
+//
+// `node` is what the parser passes around while parsing, `finish` turns the
+// root into the result of the parse.
+template<template<class> class Container_Type> struct basic_node_tree_builder
+{
+  using node = basic_parse_node<Container_Type>;
+  using result_type = node;
+  using allocator_type = typename node::allocator_type;
+  using error_type = typename node::error_type;
+
+  allocator_type alloc;
+
+  constexpr explicit basic_node_tree_builder(allocator_type alloc_ = {}) : alloc{ alloc_ } {}
+
+  constexpr void reset([[maybe_unused]] std::string_view source) noexcept {}
+
+  [[nodiscard]] constexpr node leaf(const lexing::lex_item &item) const { return node{ item, alloc }; }
+
+  [[nodiscard]] constexpr node
+    error(const lexing::lex_item &item, const error_type error_, const lexing::token_type expected = {}) const
+  {
+    return node{ item, error_, expected, alloc };
+  }
+
+  // Children are moved in. Braced lists of children would go through an
+  // initializer_list, which can only be copied from.
+  template<typename... Children>
+  [[nodiscard]] constexpr node branch(const lexing::lex_item &item, Children &&...children) const
+  {
+    typename node::container_type nodes(alloc);
+    nodes.reserve(sizeof...(Children));
+    (nodes.push_back(std::forward<Children>(children)), ...);
+    return node{ item, std::move(nodes), alloc };
+  }
+
+  constexpr void append(node &parent, node &&child) const { parent.children.push_back(std::move(child)); }
+
+  constexpr void relabel(node &target, const lexing::lex_item &item) const { target.item = item; }
+
+  // a node the parser left out of the tree after an error
+  constexpr void discard([[maybe_unused]] node &&target) const noexcept {}
+
+  [[nodiscard]] static constexpr lexing::token_type type(const node &target) noexcept { return target.item.type; }
+
+  [[nodiscard]] static constexpr bool is_error(const node &target) noexcept { return target.is_error(); }
+
+  // unknown if there are no children
+  [[nodiscard]] static constexpr lexing::token_type last_child_type(const node &target) noexcept
+  {
+    return target.children.empty() ? lexing::token_type::unknown : target.children.back().item.type;
+  }
+
+  [[nodiscard]] constexpr result_type finish(node &&root) const { return std::move(root); }
+};
 
 }// namespace thing::parsing
 #endif// MYPROJECT_PARSE_NODE_HPP
@@ -1,16 +1,19 @@
 #ifndef THING_PARSER_HPP
 #define THING_PARSER_HPP
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <optional>
 #include <utility>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <string_view>
 
 #include "parse_node.hpp"
 #include "lexer.hpp"
+#include "token_buffer.hpp"
 
 // We are attempting to implement a "Pratt Parser" here, using
 // these references:
@@ -26,23 +29,155 @@
 namespace thing::parsing {
 
 
-template<template<class> class Container_Type> struct basic_parser
+template<template<class> class Container_Type, typename Tree_Builder = basic_node_tree_builder<Container_Type>>
+struct basic_parser
 {
 
   using parse_node = basic_parse_node<Container_Type>;
 
-  using allocator_type = typename parse_node::allocator_type;
+  // rebound to each container of the parser and its builder. Taken from the
+  // symbol table rather than parse_node, which a Container_Type such as
+  // small_vector_2 cannot hold, and which a flat or event builder never uses.
+  using allocator_type = typename lexing::basic_symbol_table<Container_Type>::allocator_type;
+
+  using tree_builder = Tree_Builder;
+  // the builder's handle to a node while it is being built
+  using node = typename tree_builder::node;
+
+  using token_buffer = lexing::basic_token_buffer<Container_Type>;
 
   allocator_type alloc;
 
   lexing::lex_item next_lexed_token;
 
-  constexpr explicit basic_parser(allocator_type alloc_) : alloc{ alloc_ } {}
+  // when parsing from a pre-lexed token_buffer, tokens are pulled from here
+  // instead of lexing the remainder of the input on demand
+  const token_buffer *tokens{ nullptr };
+  std::size_t token_index{ 0 };
+  // the parse ends at the token at token_end, which is read as end_token: the
+  // end_of_file token, or an empty one in its place when only a part of the
+  // buffer is parsed
+  std::size_t token_end{ 0 };
+  lexing::lex_item end_token;
+
+  // identifiers lexed on demand are interned here, token_buffers carry
+  // their own symbols
+  lexing::basic_symbol_table<Container_Type> symbols;
+
+  tree_builder builder;
+
+  // The grammar is recursive:
+  //
+  //   expression(rbp)    := prefix, then infix operators while rbp < lbp(next token)
+  //   prefix             := number | identifier | string | control_block | `(` expression `)`
+  //                       | keyword expression(prefix) | `+` expression(prefix) | `-` expression(prefix)
+  //   infix              := binary_operator expression(lbp) | `^` expression(lbp - 1) | `!`
+  //                       | `(` call_arguments `)` | `{` expression `}`
+  //   control_block      := if/for/while `(` header `)` statement [ `else` statement ]
+  //   statement          := compound_statement | expression [ `;` ]
+  //   compound_statement := `{` statement... `}`
+  //
+  // but the parser is not: a construct that needs a nested one pushes a frame,
+  // holding its partial node and what is left to do with the nested node once
+  // it is complete (its continuation), and the nested construct is started.
+  // A complete node is handed to the continuation on top of the stack.
+  //
+  // The stack is driven by a single loop, left_denotation(), which keeps the
+  // binding power and the left operand of the innermost expression in
+  // locals, and parses prefixes and infix operators in place. An expression
+  // only gets a frame once an infix operator binds its prefix, or its prefix
+  // has a nested expression, so most operands never touch the stack. The
+  // frame is then shared by all of its operators in turn. List elements and
+  // statements share the frame of their list or compound statement as well.
+  //
+  // Deeply nested input therefore costs heap memory rather than call stack,
+  // and once `max_nesting` frames are open, the next construct is replaced by
+  // a nesting_too_deep error node instead, which keeps the depth of the tree
+  // bounded as well.
+
+  // what run() parses, which completes as one node
+  enum struct construct : std::uint8_t { expression, statement };
+
+  // what a frame does with the nested node, once it is complete
+  enum struct continuation : std::uint8_t {
+    // the operand of the prefix operator or keyword `item`
+    prefix_operand,
+    // the expression inside parentheses
+    parenthesized,
+    // the header, then the body, of the control block `item`
+    control_header,
+    control_body,
+    // the else statement of the control block `first`, `second` is the else keyword
+    else_body,
+    // the right operand of `item`, `first` is the left one
+    infix_operand,
+    // the arguments of a call to `first`
+    call_arguments,
+    // the expression inside `item`, a left brace that follows `first`
+    brace_initializer,
+    // the next element of the list `first`, separated by `delimiter`
+    list_element,
+    // a statement's expression
+    statement_end,
+    // the next statement of the compound statement `first`, a compound
+    // statement, or just its expression
+    compound_element,
+    compound_expression
+  };
+
+  // The operator or keyword a frame holds on to, which is a lex_item without
+  // a number and with the rest of the input as its remainder
+  struct held_token
+  {
+    lexing::token_type type{ lexing::token_type::unknown };
+    lexing::symbol_id symbol{ lexing::symbols::none };
+    std::string_view match;
+  };
+
+  struct frame
+  {
+    continuation next{ continuation::statement_end };
+    lexing::token_type delimiter{ lexing::token_type::unknown };
+    // of the expression the frame belongs to, if any
+    int rbp{ 0 };
+    held_token item{};
+    // emplaced rather than assigned, so that they keep the allocator of the
+    // nodes they are given: a std::pmr::vector does not take it over on move
+    // assignment, and would copy the whole subtree instead
+    std::optional<node> first;
+    std::optional<node> second;
+  };
+
+  // about one frame per level of parentheses, braces or operator precedence
+  static constexpr std::size_t default_max_nesting = 1024;
+
+  std::size_t max_nesting{ default_max_nesting };
+
+  // enough for typical scripts, so that a new parser allocates its frames once
+  static constexpr std::size_t initial_frames = 32;
+
+  Container_Type<frame> frames;
+
+  constexpr explicit basic_parser(allocator_type alloc_)
+    : alloc{ alloc_ }, symbols{ alloc_ }, builder{ alloc_ }, frames(alloc_)
+  {}
 
   constexpr basic_parser() : basic_parser(allocator_type{}) {}
-  constexpr basic_parser(const basic_parser &, allocator_type alloc_ = {}) : alloc(alloc_) {}
+
+  // the builder and the frames only hold the scratch state of a parse, which is not carried over
+  constexpr basic_parser(const basic_parser &other, allocator_type alloc_ = {})
+    : alloc{ alloc_ }, next_lexed_token{ other.next_lexed_token }, tokens{ other.tokens },
+      token_index{ other.token_index }, token_end{ other.token_end }, end_token{ other.end_token },
+      symbols{ other.symbols, alloc_ }, builder{ alloc_ },
+      max_nesting{ other.max_nesting }, frames(alloc_)
+  {}
   constexpr basic_parser(basic_parser &&) noexcept = default;
-  constexpr basic_parser(basic_parser &&other, allocator_type alloc_) : next_lexed_token{other.next_lexed_token}, alloc(alloc_) {}
+  constexpr basic_parser(basic_parser &&other, allocator_type alloc_)
+    : alloc{ alloc_ }, next_lexed_token{ other.next_lexed_token }, tokens{ other.tokens },
+      token_index{ other.token_index }, token_end{ other.token_end }, end_token{ other.end_token },
+      symbols{ std::move(other.symbols), alloc_ }, builder{ alloc_ },
+      max_nesting{ other.max_nesting }, frames(alloc_)
+  {}
   constexpr basic_parser &operator=(const basic_parser &rhs)= default;
   constexpr basic_parser &operator=(basic_parser &&rhs) noexcept = default;
   constexpr ~basic_parser() = default;
@@ -50,13 +185,108 @@ template<template<class> class Container_Type> struct basic_parser
 
   [[nodiscard]] constexpr auto parse(std::string_view v)
   {
-    next_lexed_token = next_token(v);
-    return expression();
+    tokens = nullptr;
+    builder.reset(v);
+    next_lexed_token = intern(next_token(v));
+    return builder.finish(run({ construct::expression }));
+  }
+
+  static constexpr std::size_t to_end_of_buffer = std::numeric_limits<std::size_t>::max();
+
+  // `buffer` must outlive the parse
+  [[nodiscard]] constexpr auto parse(const token_buffer &buffer)
+  {
+    seek(buffer, 0, to_end_of_buffer);
+    return builder.finish(run({ construct::expression }));
+  }
+
+  // One expression of `buffer`, starting at the token at `index`, which ends
+  // before the token at `end` if it gets that far. token_index is left at the
+  // token that follows the expression.
+  [[nodiscard]] constexpr auto
+    parse_expression(const token_buffer &buffer, const std::size_t index, const std::size_t end = to_end_of_buffer)
+  {
+    seek(buffer, index, end);
+    return builder.finish(run({ construct::expression }));
+  }
+
+  // One statement of `buffer`, starting at the token at `index`. token_index
+  // is left at the token that follows the statement.
+  [[nodiscard]] constexpr auto parse_statement(const token_buffer &buffer, const std::size_t index)
+  {
+    seek(buffer, index, to_end_of_buffer);
+    return builder.finish(run({ construct::statement }));
+  }
+
+  // A script is a sequence of top-level definitions, `auto name(...) { ... }`
+  // and the like. Where one ends is found by bracket matching alone: after a
+  // `}` that closes the last open bracket, and a `;` that follows it, or after
+  // a `;` outside of brackets. A definition with an unclosed bracket therefore
+  // runs on until the brackets balance again, if ever, but the definitions
+  // before it are not affected.
+  [[nodiscard]] static constexpr std::size_t end_of_definition(const token_buffer &buffer, std::size_t index)
+  {
+    for (std::size_t depth = 0;; ++index) {
+      switch (buffer.types[index]) {
+      case lexing::token_type::end_of_file:
+        return index;
+      case lexing::token_type::left_paren:
+      case lexing::token_type::left_brace:
+        ++depth;
+        break;
+      case lexing::token_type::right_paren:
+        if (depth != 0) { --depth; }
+        break;
+      case lexing::token_type::right_brace:
+        if (depth > 1) {
+          --depth;
+        } else {
+          return buffer.types[index + 1] == lexing::token_type::semicolon ? index + 2 : index + 1;
+        }
+        break;
+      case lexing::token_type::semicolon:
+        if (depth == 0) { return index + 1; }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  // The top-level definition in [index, end), an expression with an optional
+  // `;`, parsed as if it was all of the script. Tokens that are left over
+  // start another expression.
+  constexpr void parse_definition(const token_buffer &buffer,
+    std::size_t index,
+    const std::size_t end,
+    Container_Type<typename tree_builder::result_type> &definitions)
+  {
+    while (index < end) {
+      definitions.push_back(parse_expression(buffer, index, end));
+      auto next = token_index;
+      if (next < end && buffer.types[next] == lexing::token_type::semicolon) { ++next; }
+      // a token that cannot start an expression is only in the error node for it
+      index = std::max(next, index + 1);
+    }
   }
 
-  [[nodiscard]] constexpr bool peek(const lexing::token_type type, const std::string_view value = "") const noexcept
+  // All of the top-level definitions of `buffer`, in order
+  [[nodiscard]] constexpr Container_Type<typename tree_builder::result_type> parse_definitions(
+    const token_buffer &buffer)
   {
-    return next_lexed_token.type == type && (value.empty() || next_lexed_token.match == value);
+    Container_Type<typename tree_builder::result_type> result(alloc);
+    for (std::size_t index = 0; buffer.types[index] != lexing::token_type::end_of_file;) {
+      const auto end = end_of_definition(buffer, index);
+      parse_definition(buffer, index, end, result);
+      index = end;
+    }
+    return result;
+  }
+
+  [[nodiscard]] constexpr bool peek(const lexing::token_type type,
+    const lexing::symbol_id symbol = lexing::symbols::none) const noexcept
+  {
+    return next_lexed_token.type == type && (symbol == lexing::symbols::none || next_lexed_token.symbol == symbol);
   }
 
   [[nodiscard]] constexpr bool next_token_is_valid() const noexcept
@@ -70,135 +300,509 @@ template<template<class> class Container_Type> struct basic_parser
     }
   }
 
-  // if a match is not possible, an error node is returned.
-  [[nodiscard]] constexpr parse_node consume_match(const lexing::token_type type)
+  // if a match is not possible, an error node is returned. A missing `)`, `}`
+  // or `;` is recovered from by skipping ahead, see resynchronize().
+  [[nodiscard]] constexpr node consume_match(const lexing::token_type type)
   {
-    if (next_lexed_token.type != type) {
-      return parse_node{ std::exchange(next_lexed_token, next()), parse_node::error_type::wrong_token_type, type };
-    }
-    return parse_node{ std::exchange(next_lexed_token, next()), {} };
+    if (next_lexed_token.type != type && is_closer(type)) { return resynchronize(type); }
+    const auto item = take();
+    if (item.type != type) { return builder.error(item, error_type::wrong_token_type, type); }
+    return builder.leaf(item);
   }
 
-  [[nodiscard]] constexpr parse_node list(const bool consume_opener,
-    const lexing::token_type opener,
-    const lexing::token_type closer,
-    const lexing::token_type delimiter)
+  [[nodiscard]] static constexpr bool is_closer(const lexing::token_type type) noexcept
   {
-    auto result = [&]() {
-      if (consume_opener) {
-        return consume_match(opener);
-      } else {
-        return parse_node{ lexing::lex_item{ lexing::token_type::unknown, {}, {} } };
+    return type == lexing::token_type::right_paren || type == lexing::token_type::right_brace
+           || type == lexing::token_type::semicolon;
+  }
+
+  // Panic-mode recovery from a missing `expected` closer, reported at the
+  // token found in its place. Tokens are skipped, brackets matched, up to
+  // the expected one, which is consumed, or up to a `;` or `}` that belongs
+  // to an enclosing construct, which is left for it, or past a block. Parsing then carries on
+  // as if the closer had been there, so that a mistake costs one error node
+  // rather than a cascade of them, and the errors after it are still found.
+  [[nodiscard]] constexpr node resynchronize(const lexing::token_type expected)
+  {
+    auto result = builder.error(next_lexed_token, error_type::wrong_token_type, expected);
+    std::size_t depth = 0;
+    for (; next_token_is_valid(); advance()) {
+      const auto type = next_lexed_token.type;
+      if (depth == 0 && type == expected) {
+        advance();
+        return result;
+      }
+      switch (type) {
+      case lexing::token_type::left_paren:
+      case lexing::token_type::left_brace:
+        ++depth;
+        break;
+      case lexing::token_type::right_paren:
+        if (depth != 0) { --depth; }
+        break;
+      case lexing::token_type::right_brace:
+        if (depth == 0) { return result; }
+        // a block ends the statement or definition that it is part of, see
+        // end_of_definition(), so that an unclosed `(` does not take every
+        // definition after it along
+        if (--depth == 0 && expected != lexing::token_type::right_brace) {
+          advance();
+          return result;
+        }
+        break;
+      case lexing::token_type::semicolon:
+        if (depth == 0) { return result; }
+        break;
+      default:
+        break;
       }
-    }();
+    }
+    return result;
+  }
 
-    while (!peek(closer)) {
-      result.children.push_back(expression());
-      if (peek(delimiter)) {
-        // can discard, we know it will consume_match, we peeked
-        [[maybe_unused]] const auto match_result = consume_match(delimiter);
-      } else {
+  // the frames open
+  [[nodiscard]] constexpr std::size_t nesting() const noexcept { return frames.size(); }
+
+  // `what`, without recursion
+  [[nodiscard]] constexpr node run(const construct what)
+  {
+    frames.clear();
+    frames.reserve(initial_frames);
+
+    // a statement can be complete as soon as it is started, such as an empty
+    // compound statement
+    if (what == construct::statement) {
+      if (auto started = statement()) { return left_denotation(std::move(*started), unbound, false); }
+    }
+    int rbp = 0;
+    auto prefix_ = prefix(rbp);
+    return left_denotation(std::move(prefix_), rbp, false);
+  }
+
+  // a frame that waits with `next` for a nested node, on top of the stack.
+  // What else `next` needs is filled in by the caller, in place: a frame
+  // that is built elsewhere and copied is written and read back at different
+  // widths, which stalls store forwarding.
+  constexpr frame &push(const continuation next, const int rbp = 0)
+  {
+    auto &top = frames.emplace_back();
+    top.next = next;
+    top.rbp = rbp;
+    return top;
+  }
+
+  [[nodiscard]] static constexpr held_token hold(const lexing::lex_item &item) noexcept
+  {
+    return { item.type, item.symbol, item.match };
+  }
+
+  [[nodiscard]] constexpr lexing::lex_item held(const held_token &token) const noexcept
+  {
+    const auto *const end = next_lexed_token.remainder.data() + next_lexed_token.remainder.size();
+    const auto *const rest = token.match.data() + token.match.size();
+    return { token.type, token.match, { rest, static_cast<std::size_t>(end - rest) }, token.symbol };
+  }
+
+  // hands `result` to the frame below the top one, which is discarded
+  [[nodiscard]] constexpr node complete(node &&result)
+  {
+    auto completed = std::move(result);
+    frames.pop_back();
+    return completed;
+  }
+
+  // In place of a construct that would open more than max_nesting frames. The
+  // rest of the construct is skipped, up to the token that ends it or closes
+  // the construct around it, which is left for that one: otherwise what
+  // follows would nest the tree just as deep, only as a chain of errors.
+  [[nodiscard]] constexpr node too_deep()
+  {
+    auto result = builder.error(next_lexed_token, error_type::nesting_too_deep);
+    std::size_t depth = 0;
+    for (; next_token_is_valid(); advance()) {
+      switch (next_lexed_token.type) {
+      case lexing::token_type::left_paren:
+      case lexing::token_type::left_brace:
+        ++depth;
+        break;
+      case lexing::token_type::right_paren:
+      case lexing::token_type::right_brace:
+        if (depth == 0) { return result; }
+        --depth;
+        break;
+      case lexing::token_type::semicolon:
+      case lexing::token_type::comma:
+        if (depth == 0) { return result; }
+        break;
+      default:
         break;
       }
     }
+    return result;
+  }
 
+  // `opener` is the list so far, closed by a right paren, whose elements
+  // are parsed next. Their frame is on top.
+  constexpr void list(node &&opener, const lexing::token_type delimiter)
+  {
+    auto &top = push(continuation::list_element);
+    top.delimiter = delimiter;
+    top.first.emplace(std::move(opener));
+  }
+
+  [[nodiscard]] constexpr node close_list()
+  {
+    auto &top = frames.back();
     // a failed match is useful information, so we save it for later reporting
-    if (const auto match_result = consume_match(closer); match_result.is_error()) {
-      result.children.push_back(match_result);
+    if (auto match_result = consume_match(lexing::token_type::right_paren); builder.is_error(match_result)) {
+      builder.append(*top.first, std::move(match_result));
     }
+    return complete(std::move(*top.first));
+  }
 
-    return result;
+  // Starts a statement, on top of the stack. nullopt if its expression is
+  // parsed next, or else the statement, which is complete already.
+  [[nodiscard]] constexpr std::optional<node> statement()
+  {
+    if (nesting() >= max_nesting) { return too_deep(); }
+
+    if (!peek(lexing::token_type::left_brace)) {
+      push(continuation::statement_end);
+      return std::nullopt;
+    }
+    // cannot fail, we peeked
+    push(continuation::compound_element).first.emplace(consume_match(lexing::token_type::left_brace));
+    return next_statement();
   }
 
-  [[nodiscard]] constexpr parse_node control_block(const lexing::lex_item &item)
+  // Starts the next statement of the compound statement on top, as
+  // statement() does, or closes it. The statements share its frame, unless
+  // they are compound statements themselves, which are opened right here.
+  [[nodiscard]] constexpr std::optional<node> next_statement()
   {
-    parse_node result{ item,
-      { list(true, lexing::token_type::left_paren, lexing::token_type::right_paren, lexing::token_type::semicolon),
-        statement() } };
-    if (peek(lexing::token_type::keyword, "else")) {
-      result.children.push_back(parse_node{ consume_match(lexing::token_type::keyword).item, { statement() } });
+    while (peek(lexing::token_type::left_brace)) {
+      frames.back().next = continuation::compound_element;
+      if (nesting() >= max_nesting) { return too_deep(); }
+      push(continuation::compound_element).first.emplace(consume_match(lexing::token_type::left_brace));
     }
-    return result;
+    if (peek(lexing::token_type::right_brace) || !next_token_is_valid()) { return close_compound(); }
+
+    // the statement's semicolon is consumed by the frame, even if it is too deep
+    frames.back().next = continuation::compound_expression;
+    if (nesting() >= max_nesting) { return too_deep(); }
+    return std::nullopt;
+  }
+
+  constexpr void end_statement(node &statement_)
+  {
+    if (builder.type(statement_) == lexing::token_type::left_brace
+        || builder.last_child_type(statement_) == lexing::token_type::left_brace) {
+      // our last matched item was a compound statement of some sort, so we won't require a closing semicolon
+    } else if (auto match_result = consume_match(lexing::token_type::semicolon); builder.is_error(match_result)) {
+      builder.append(statement_, std::move(match_result));
+    }
+  }
+
+  [[nodiscard]] constexpr node close_compound()
+  {
+    auto &top = frames.back();
+    if (auto right_brace = consume_match(lexing::token_type::right_brace); builder.is_error(right_brace)) {
+      builder.append(*top.first, std::move(right_brace));
+    }
+    return complete(std::move(*top.first));
+  }
+
+  // prefixes that are complete on their own
+  [[nodiscard]] static constexpr bool is_leaf(const lexing::token_type type) noexcept
+  {
+    return type == lexing::token_type::number || type == lexing::token_type::identifier
+           || type == lexing::token_type::string;
   }
 
-  // prefix nodes
-  [[nodiscard]] constexpr parse_node null_denotation(const lexing::lex_item &item)
+  [[nodiscard]] constexpr node leaf(const lexing::lex_item &item)
+  {
+    if (item.type == lexing::token_type::number && !item) {
+      return builder.error(item, error_type::invalid_number_literal);
+    }
+    return builder.leaf(item);
+  }
+
+  // the binding power of a complete node that no infix operator takes
+  static constexpr int unbound = std::numeric_limits<int>::max();
+
+  // Prefixes of an expression(rbp), up to one that is complete on its own.
+  // Prefix operators and parentheses push a frame each and carry on with
+  // their operand, whose binding power `rbp` is set to, and so do control
+  // blocks, with the first element of their header.
+  [[nodiscard]] constexpr node prefix(int &rbp)
   {
     constexpr auto prefix_precedence = static_cast<int>(precedence::prefix);
 
-    switch (item.type) {
-    case lexing::token_type::identifier:
-    case lexing::token_type::number:
-    case lexing::token_type::string:
-      return parse_node{ item };
-    case lexing::token_type::keyword:
-      if (item.match == "if" || item.match == "for" || item.match == "while") {
-        return control_block(item);
-      } else {
-        return parse_node{ item, { parse_node{ expression(prefix_precedence) } } };
-      }
-    case lexing::token_type::plus:
-    case lexing::token_type::minus:
-      return parse_node{ item, { parse_node{ expression(prefix_precedence) } } };
-    case lexing::token_type::left_paren: {
-      // not const because of two different return paths, we don't want to
-      // disable automatic moves
-      auto result = expression();
-      if (auto match_result = consume_match(lexing::token_type::right_paren); match_result.is_error()) {
-        return match_result;
+    while (true) {
+      if (nesting() >= max_nesting) { return too_deep(); }
+
+      // a closer is left for the construct that it ends
+      if (is_closer(next_lexed_token.type)) {
+        return builder.error(next_lexed_token, error_type::unexpected_prefix_token);
       }
 
-      return result;
+      const auto item = take();
+      switch (item.type) {
+      case lexing::token_type::number:
+      case lexing::token_type::identifier:
+      case lexing::token_type::string:
+        return leaf(item);
+      case lexing::token_type::keyword:
+        if (item.symbol == lexing::symbols::if_ || item.symbol == lexing::symbols::for_
+            || item.symbol == lexing::symbols::while_) {
+          // the header is a list of expressions, whose first prefix is
+          // parsed next, unless the header is empty, and complete
+          push(continuation::control_header, rbp).item = hold(item);
+          list(consume_match(lexing::token_type::left_paren), lexing::token_type::semicolon);
+          if (peek(lexing::token_type::right_paren)) {
+            rbp = unbound;
+            return close_list();
+          }
+          rbp = 0;
+          break;
+        }
+        push(continuation::prefix_operand, rbp).item = hold(item);
+        rbp = prefix_precedence;
+        break;
+      case lexing::token_type::plus:
+      case lexing::token_type::minus:
+        push(continuation::prefix_operand, rbp).item = hold(item);
+        rbp = prefix_precedence;
+        break;
+      case lexing::token_type::left_paren:
+        push(continuation::parenthesized, rbp);
+        rbp = 0;
+        break;
+      default:
+        return builder.error(item, error_type::unexpected_prefix_token);
+      };
     }
-    default:
-      return parse_node{ item, parse_node::error_type::unexpected_prefix_token };
-    };
   }
 
-  // infix processing
-  [[nodiscard]] constexpr parse_node left_denotation(const lexing::lex_item &item, const parse_node &left)
-  {
-    switch (item.type) {
-    case lexing::token_type::plus:
-    case lexing::token_type::minus:
-    case lexing::token_type::asterisk:
-    case lexing::token_type::slash:
-    case lexing::token_type::less_than:
-    case lexing::token_type::less_than_or_equal:
-    case lexing::token_type::greater_than:
-    case lexing::token_type::greater_than_or_equal:
-    case lexing::token_type::logical_and:
-    case lexing::token_type::logical_or:
-    case lexing::token_type::equals:
-    case lexing::token_type::not_equals:
-      return parse_node{ item, { left, expression(lbp(item.type)) } };
-    case lexing::token_type::bang:
-      return parse_node{ item, { left } };
-    case lexing::token_type::left_paren: {
-      auto result = left;
-      result.children.emplace_back(item,
-        list(false, lexing::token_type::left_paren, lexing::token_type::right_paren, lexing::token_type::comma)
-          .children);
-      return result;
-    }
-    case lexing::token_type::left_brace: {
-      auto result = left;
-      result.children.push_back(parse_node{ item, { expression() } });
-      if (auto match_result = consume_match(lexing::token_type::right_brace); match_result.is_error()) {
-        return match_result;
+  // what hand_over() did with a complete node
+  enum struct handed : std::uint8_t {
+    // it is the prefix of the expression on top of the stack, see below
+    to_expression,
+    // the construct on top takes an expression, which is parsed next
+    expression_next,
+    // it is what run() was asked for
+    to_caller
+  };
+
+  // Hands the complete node `value` to the frame on top, which either
+  // completes as well, and is handed on in turn, or needs more input. An
+  // operand is replaced by the expression it completes the prefix of, and
+  // `rbp` by that expression's binding power. The frame then belongs to the
+  // expression.
+  [[nodiscard]] constexpr handed hand_over(node &value, int &rbp)
+  {
+    // a statement that is started as a construct is complete, or its
+    // expression is parsed next
+    const auto started = [&](std::optional<node> &&statement_) {
+      if (!statement_) { return false; }
+      value = std::move(*statement_);
+      return true;
+    };
+
+    while (!frames.empty()) {
+      auto &top = frames.back();
+      switch (top.next) {
+      case continuation::prefix_operand:
+        value = builder.branch(held(top.item), std::move(value));
+        break;
+      case continuation::parenthesized:
+        if (auto match_result = consume_match(lexing::token_type::right_paren); builder.is_error(match_result)) {
+          builder.discard(std::move(value));
+          value = std::move(match_result);
+        }
+        break;
+      case continuation::control_header:
+        top.first.emplace(std::move(value));
+        top.next = continuation::control_body;
+        if (started(statement())) { continue; }
+        return handed::expression_next;
+      case continuation::control_body: {
+        auto result = builder.branch(held(top.item), std::move(*top.first), std::move(value));
+        if (!peek(lexing::token_type::keyword, lexing::symbols::else_)) {
+          value = std::move(result);
+          break;
+        }
+        top.first.emplace(std::move(result));
+        top.second.emplace(consume_match(lexing::token_type::keyword));
+        top.next = continuation::else_body;
+        if (started(statement())) { continue; }
+        return handed::expression_next;
+      }
+      case continuation::else_body:
+        builder.append(*top.second, std::move(value));
+        builder.append(*top.first, std::move(*top.second));
+        value = std::move(*top.first);
+        break;
+      case continuation::infix_operand:
+        value = builder.branch(held(top.item), std::move(*top.first), std::move(value));
+        break;
+      case continuation::call_arguments:
+        builder.relabel(value, held(top.item));
+        builder.append(*top.first, std::move(value));
+        value = std::move(*top.first);
+        break;
+      case continuation::brace_initializer: {
+        // a missing `}` is reported in the initializer, which keeps the errors
+        // inside of it, such as those in the body of a function
+        auto initializer = builder.branch(held(top.item), std::move(value));
+        if (auto match_result = consume_match(lexing::token_type::right_brace); builder.is_error(match_result)) {
+          builder.append(initializer, std::move(match_result));
+        }
+        builder.append(*top.first, std::move(initializer));
+        value = std::move(*top.first);
+        break;
       }
-      return result;
+      case continuation::list_element:
+        builder.append(*top.first, std::move(value));
+        if (peek(top.delimiter)) {
+          // can discard, we know it will consume_match, we peeked
+          [[maybe_unused]] const auto match_result = consume_match(top.delimiter);
+          if (!peek(lexing::token_type::right_paren)) { return handed::expression_next; }
+        }
+        value = close_list();
+        continue;
+      case continuation::statement_end:
+        end_statement(value);
+        value = complete(std::move(value));
+        continue;
+      case continuation::compound_element:
+        builder.append(*top.first, std::move(value));
+        if (started(next_statement())) { continue; }
+        return handed::expression_next;
+      case continuation::compound_expression:
+        end_statement(value);
+        builder.append(*top.first, std::move(value));
+        if (started(next_statement())) { continue; }
+        return handed::expression_next;
+      }
+      rbp = top.rbp;
+      return handed::to_expression;
     }
-    case lexing::token_type::caret:
-      // caret, as an infix, is right-associative, so we decrease its
-      // precedence slightly
-      // https://github.com/munificent/bantam/blob/8b0b06a1543b7d9e84ba2bb8d916979459971b2d/src/com/stuffwithstuff/bantam/parselets/BinaryOperatorParselet.java#L20-L27
-      // note that this https://eli.thegreenplace.net/2010/01/02/top-down-operator-precedence-parsing
-      // example disagrees slightly, it provides a gap in precedence, where
-      // the bantam example notches it down to share with other levels
-      return parse_node{ item, { left, expression(lbp(item.type) - 1) } };
-    default:
-      return parse_node{ item, parse_node::error_type::unexpected_infix_token };
+    return handed::to_caller;
+  }
+
+  // Infix processing of the expression(rbp) that `left` is the prefix of,
+  // which has the frame on top if it is `framed`. `left` is moved into the
+  // result rather than copied, so that a chain of n operators costs O(n) and
+  // not O(n^2). Operands and call arguments are parsed in this loop as well,
+  // and once the innermost construct is complete, it is handed over to the
+  // one that waits for it, until the one that run() started is complete.
+  [[nodiscard]] constexpr node left_denotation(node left, int rbp, bool framed)
+  {
+    while (true) {
+      if (rbp >= lbp(next_lexed_token.type)) {
+        if (framed) { frames.pop_back(); }
+        switch (hand_over(left, rbp)) {
+        case handed::to_expression:
+          framed = true;
+          continue;
+        case handed::expression_next:
+          break;
+        case handed::to_caller:
+          return left;
+        }
+        rbp = 0;
+        left = prefix(rbp);
+        framed = false;
+        continue;
+      }
+
+      if (!framed) {
+        push(continuation::infix_operand, rbp);
+        framed = true;
+      }
+      // the frame waits for the operand of `item`, which follows `left`
+      auto &top = frames.back();
+      const auto item = take();
+      auto next = continuation::infix_operand;
+      int operand_rbp = 0;
+      switch (item.type) {
+      case lexing::token_type::plus:
+      case lexing::token_type::minus:
+      case lexing::token_type::asterisk:
+      case lexing::token_type::slash:
+      case lexing::token_type::less_than:
+      case lexing::token_type::less_than_or_equal:
+      case lexing::token_type::greater_than:
+      case lexing::token_type::greater_than_or_equal:
+      case lexing::token_type::logical_and:
+      case lexing::token_type::logical_or:
+      case lexing::token_type::equals:
+      case lexing::token_type::not_equals:
+        operand_rbp = lbp(item.type);
+        break;
+      case lexing::token_type::bang:
+        left = builder.branch(item, std::move(left));
+        continue;
+      case lexing::token_type::left_paren: {
+        // the arguments have no token of their own until they are relabeled
+        auto arguments = builder.leaf(lexing::lex_item{ lexing::token_type::unknown, {}, {} });
+        if (peek(lexing::token_type::right_paren)) {
+          [[maybe_unused]] const auto match_result = consume_match(lexing::token_type::right_paren);
+          builder.relabel(arguments, item);
+          builder.append(left, std::move(arguments));
+          continue;
+        }
+        top.next = continuation::call_arguments;
+        top.item = hold(item);
+        top.first.emplace(std::move(left));
+        list(std::move(arguments), lexing::token_type::comma);
+        break;
+      }
+      case lexing::token_type::left_brace:
+        next = continuation::brace_initializer;
+        break;
+      case lexing::token_type::caret:
+        // caret, as an infix, is right-associative, so we decrease its
+        // precedence slightly
+        // https://github.com/munificent/bantam/blob/8b0b06a1543b7d9e84ba2bb8d916979459971b2d/src/com/stuffwithstuff/bantam/parselets/BinaryOperatorParselet.java#L20-L27
+        // note that this https://eli.thegreenplace.net/2010/01/02/top-down-operator-precedence-parsing
+        // example disagrees slightly, it provides a gap in precedence, where
+        // the bantam example notches it down to share with other levels
+        operand_rbp = lbp(item.type) - 1;
+        break;
+      default:
+        builder.discard(std::move(left));
+        left = builder.error(item, error_type::unexpected_infix_token);
+        continue;
+      }
+
+      if (item.type != lexing::token_type::left_paren) {
+        // The right operand of a binary operator is most often a leaf, which
+        // the operator takes as it is, unless it is the prefix of an
+        // expression that continues on a frame of its own, above this one.
+        if (next == continuation::infix_operand && is_leaf(next_lexed_token.type) && nesting() < max_nesting) {
+          auto right = leaf(take());
+          if (operand_rbp >= lbp(next_lexed_token.type)) {
+            left = builder.branch(item, std::move(left), std::move(right));
+            continue;
+          }
+          top.next = next;
+          top.item = hold(item);
+          top.first.emplace(std::move(left));
+          left = std::move(right);
+          rbp = operand_rbp;
+          framed = false;
+          continue;
+        }
+
+        top.next = next;
+        top.item = hold(item);
+        top.first.emplace(std::move(left));
+      }
+      rbp = operand_rbp;
+      left = prefix(rbp);
+      framed = false;
     }
   }
 
@@ -215,8 +819,7 @@ template<template<class> class Container_Type> struct basic_parser
     exponent = 7,
     prefix = 8,
     postfix = 9,
-    call = 10,
-    keyword = 11
+    call = 10
   };
 
   // this is for infix precedence values
@@ -243,9 +846,6 @@ template<template<class> class Container_Type> struct basic_parser
       case lexing::token_type::left_paren:
         return precedence::call;
 
-      case lexing::token_type::keyword:
-        return precedence::keyword;
-
       case lexing::token_type::less_than_or_equal:
       case lexing::token_type::less_than:
       case lexing::token_type::greater_than_or_equal:
@@ -265,6 +865,10 @@ template<template<class> class Container_Type> struct basic_parser
         // all of the remaining do not have a left binding power
         // we are leaving them here as explicit cases so that we know if we add
         // a new token_type that should have an LBP but forget to add it
+      // a keyword after a complete expression starts the next statement or
+      // definition, or is an error for the construct that expected something
+      // else, which then recovers from it
+      case lexing::token_type::keyword:
       case lexing::token_type::right_paren:// right_paren will be parsed but not consumed when matching
       case lexing::token_type::end_of_file:
       case lexing::token_type::unknown:
@@ -290,56 +894,53 @@ template<template<class> class Container_Type> struct basic_parser
     }());
   }
 
-  [[nodiscard]] constexpr parse_node statement()
+  // consumes next_lexed_token
+  [[nodiscard]] constexpr lexing::lex_item take()
   {
-    if (peek(lexing::token_type::left_brace)) { return compound_statement(); }
-    auto result = expression();
+    auto item = next_lexed_token;
+    advance();
+    return item;
+  }
 
-    if (result.item.type == lexing::token_type::left_brace
-        || (!result.children.empty() && result.children.back().item.type == lexing::token_type::left_brace)) {
-      // our last matched item was a compound statement of some sort, so we won't require a closing semicolon
+  // starts reading `buffer` at the token at `index`, up to the one at `end`
+  constexpr void seek(const token_buffer &buffer, const std::size_t index, const std::size_t end)
+  {
+    tokens = &buffer;
+    token_end = std::min(end, buffer.size() - 1);
+    if (token_end == buffer.size() - 1) {
+      end_token = buffer[token_end];
     } else {
-      if (auto match_result = consume_match(lexing::token_type::semicolon); match_result.is_error()) {
-        result.children.push_back(match_result);
-      }
+      const auto rest = buffer.source.substr(buffer.offsets[token_end]);
+      end_token = lexing::lex_item{ lexing::token_type::end_of_file, rest.substr(0, 0), rest };
     }
-    return result;
+    token_index = index;
+    builder.reset(buffer.source);
+    next_lexed_token = index < token_end ? buffer[index] : end_token;
   }
 
-  [[nodiscard]] constexpr parse_node compound_statement()
+  // replaces next_lexed_token with the token that follows it
+  constexpr void advance()
   {
-    auto result = consume_match(lexing::token_type::left_brace);
-    if (result.is_error()) { return result; }
-
-    while (!peek(lexing::token_type::right_brace) && next_token_is_valid()) {
-      result.children.emplace_back(statement());
-    }
-
-    if (auto right_brace = consume_match(lexing::token_type::right_brace); right_brace.is_error()) {
-      result.children.push_back(right_brace);
+    if (tokens != nullptr) {
+      // the end token is returned for as long as it is asked for
+      if (token_index + 1 < token_end) {
+        next_lexed_token = (*tokens)[++token_index];
+      } else {
+        token_index = token_end;
+        next_lexed_token = end_token;
+      }
+    } else {
+      next_lexed_token = intern(next_token(next_lexed_token.remainder));
     }
-    return result;
   }
 
-  [[nodiscard]] constexpr parse_node expression(const int rbp = 0)
-  {
-    // parse prefix next_lexed_token
-    const auto prefix = next_lexed_token;
-    next_lexed_token = next();
-    auto left = null_denotation(prefix);
-
-    // parse infix / postfix tokens
-    while (rbp < lbp(next_lexed_token.type)) {
-      const auto t = next_lexed_token;
-      next_lexed_token = next();
-      left = left_denotation(t, left);
-    }
 
-    return left;
+  [[nodiscard]] constexpr lexing::lex_item intern(lexing::lex_item item)
+  {
+    if (item.type == lexing::token_type::identifier) { item.symbol = symbols.intern(item.match); }
+    return item;
   }
 
-  [[nodiscard]] constexpr lexing::lex_item next() const noexcept { return next_token(next_lexed_token.remainder); }
-
   [[nodiscard]] static constexpr lexing::lex_item next_token(std::string_view v) noexcept
   {
     while (true) {
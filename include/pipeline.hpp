@@ -0,0 +1,260 @@
+#ifndef THING_PIPELINE_HPP
+#define THING_PIPELINE_HPP
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "lex_item.hpp"
+#include "lexer.hpp"
+#include "parallel_lexer.hpp"
+#include "parser.hpp"
+#include "symbol_table.hpp"
+#include "token_buffer.hpp"
+
+// Lexing, parsing and lowering a script as a pipeline, one thread per stage.
+//
+// The lexer thread cuts the token stream into chunks of whole top-level
+// definitions, using the same bracket matching as
+// basic_parser::end_of_definition, and hands them to the parser thread, which
+// parses each chunk with parse_definitions() and hands the trees on to the
+// calling thread. That one runs `lower` on every definition, in order, while
+// the next chunks are being lexed and parsed.
+//
+// Stages are connected by bounded queues: a stage that gets ahead of the next
+// one waits for room, so that at most a few chunks of tokens and trees exist
+// at a time, whatever the size of the script. Chunks are passed rather than
+// single tokens or definitions so that the stages synchronize once per chunk.
+//
+// The trees are identical to those of parse_definitions(tokenize(source)),
+// error nodes and symbol ids included: a chunk is a token buffer over the
+// whole source that ends with an end_of_file token where the next chunk
+// starts, which the parser reads exactly like the end of a definition, and
+// identifiers are interned into one table, in the order of the script.
+//
+// Memory moves between threads, so the parser's allocator must be
+// thread-safe: not one that draws from a parse_arena.
+
+namespace thing::parsing {
+
+// keeps the two ends of a queue from sharing a cache line
+inline constexpr std::size_t cache_line_size = 64;
+
+// A bounded queue between one producer thread and one consumer thread,
+// without locks. push() waits while the queue is full and pop() while it is
+// empty, yielding to other threads.
+//
+// close() ends the stream: pop() still returns what is queued, then nothing.
+// The consumer may close the queue as well, to give up, and push() then fails.
+template<typename Type, std::size_t Capacity> struct spsc_ring
+{
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  std::array<std::optional<Type>, Capacity> slots;
+  // the number of values popped, written by the consumer
+  alignas(cache_line_size) std::atomic<std::size_t> head{ 0 };
+  // the number of values pushed, written by the producer
+  alignas(cache_line_size) std::atomic<std::size_t> tail{ 0 };
+  alignas(cache_line_size) std::atomic<bool> closed{ false };
+
+  // false, and `value` is dropped, if the queue was closed
+  bool push(Type &&value)
+  {
+    const auto position = tail.load(std::memory_order_relaxed);
+    while (position - head.load(std::memory_order_acquire) == Capacity) {
+      if (closed.load(std::memory_order_acquire)) { return false; }
+      std::this_thread::yield();
+    }
+    if (closed.load(std::memory_order_acquire)) { return false; }
+
+    slots[position % Capacity].emplace(std::move(value));
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // nothing once the queue is closed and empty
+  [[nodiscard]] std::optional<Type> pop()
+  {
+    const auto position = head.load(std::memory_order_relaxed);
+    while (tail.load(std::memory_order_acquire) == position) {
+      // values pushed before the queue was closed are visible once it is
+      if (closed.load(std::memory_order_acquire) && tail.load(std::memory_order_acquire) == position) { return {}; }
+      std::this_thread::yield();
+    }
+
+    auto &slot = slots[position % Capacity];
+    std::optional<Type> result{ std::move(slot) };
+    slot.reset();
+    head.store(position + 1, std::memory_order_release);
+    return result;
+  }
+
+  void close() noexcept { closed.store(true, std::memory_order_release); }
+};
+
+// Where the lexer may end a chunk: the first token after a top-level
+// definition, by the same rule as basic_parser::end_of_definition
+struct definition_boundaries
+{
+  std::size_t depth{ 0 };
+  // a `}` closed the definition, which takes a `;` that follows
+  bool closed_by_brace{ false };
+  // the definition is complete
+  bool ended{ false };
+
+  // whether a definition ends before a token of type `type`, which is then
+  // accounted for
+  [[nodiscard]] constexpr bool starts_definition(const lexing::token_type type) noexcept
+  {
+    if (closed_by_brace) {
+      closed_by_brace = false;
+      ended = true;
+      if (type == lexing::token_type::semicolon) { return false; }
+    }
+
+    const auto result = ended;
+    if (ended) {
+      ended = false;
+      depth = 0;
+    }
+
+    switch (type) {
+    case lexing::token_type::left_paren:
+    case lexing::token_type::left_brace:
+      ++depth;
+      break;
+    case lexing::token_type::right_paren:
+      if (depth != 0) { --depth; }
+      break;
+    case lexing::token_type::right_brace:
+      if (depth > 1) {
+        --depth;
+      } else {
+        closed_by_brace = true;
+      }
+      break;
+    case lexing::token_type::semicolon:
+      if (depth == 0) { ended = true; }
+      break;
+    default:
+      break;
+    }
+    return result;
+  }
+};
+
+// Lexes, parses and lowers `source` on three threads, see above. `lower` is
+// called on the calling thread with every top-level definition, in order, as
+// an rvalue. Chunks are cut at the first definition boundary after
+// `chunk_tokens` tokens, and Queue_Capacity chunks at most wait between two
+// stages.
+//
+// Returns the names of the symbols in the trees. An exception thrown by any
+// of the stages stops all of them and is rethrown here, once they have.
+template<std::size_t Queue_Capacity = 4,
+  template<class>
+  class Container_Type,
+  typename Tree_Builder,
+  typename Lower>
+lexing::basic_symbol_table<Container_Type> pipelined_parse_definitions(
+  const basic_parser<Container_Type, Tree_Builder> &settings,
+  const std::string_view source,
+  Lower &&lower,
+  const std::size_t chunk_tokens = 16 * 1024)
+{
+  using parser_type = basic_parser<Container_Type, Tree_Builder>;
+  using token_buffer = lexing::basic_token_buffer<Container_Type>;
+  using definitions = Container_Type<typename Tree_Builder::result_type>;
+
+  assert(source.size() <= std::numeric_limits<typename token_buffer::offset_type>::max());
+
+  const auto alloc = settings.alloc;
+  lexing::basic_symbol_table<Container_Type> symbols(alloc);
+  spsc_ring<token_buffer, Queue_Capacity> chunks;
+  spsc_ring<definitions, Queue_Capacity> trees;
+
+  const auto lex = [&] {
+    const auto new_chunk = [&] {
+      token_buffer chunk{ source, alloc };
+      chunk.reserve(chunk_tokens + chunk_tokens / 8);
+      return chunk;
+    };
+    const auto append = [&](token_buffer &chunk, const lexing::lex_item &item) {
+      chunk.types.push_back(item.type);
+      chunk.offsets.push_back(static_cast<typename token_buffer::offset_type>(item.match.data() - source.data()));
+      chunk.lengths.push_back(static_cast<typename token_buffer::offset_type>(item.match.size()));
+      chunk.symbol_ids.push_back(
+        item.type == lexing::token_type::identifier ? symbols.intern(item.match) : chunk.symbol_slot(item));
+    };
+
+    auto chunk = new_chunk();
+    definition_boundaries boundaries;
+    for (auto remainder = source;;) {
+      const auto item = lexing::lexer(remainder);
+      remainder = item.remainder;
+      if (item.type == lexing::token_type::whitespace) { continue; }
+
+      if (boundaries.starts_definition(item.type) && chunk.size() >= chunk_tokens) {
+        // the end of the chunk, as the parser reads the end of a definition
+        const auto rest = source.substr(static_cast<std::size_t>(item.match.data() - source.data()));
+        append(chunk, lexing::lex_item{ lexing::token_type::end_of_file, rest.substr(0, 0), rest });
+        if (!chunks.push(std::move(chunk))) { return; }
+        chunk = new_chunk();
+      }
+
+      append(chunk, item);
+      if (item.type == lexing::token_type::end_of_file) {
+        chunks.push(std::move(chunk));
+        return;
+      }
+    }
+  };
+
+  const auto parse = [&] {
+    parser_type parser{ settings, alloc };
+    while (auto chunk = chunks.pop()) {
+      if (!trees.push(parser.parse_definitions(*chunk))) { return; }
+    }
+  };
+
+  std::array<std::exception_ptr, 3> errors;
+  lexing::parallel_for(errors.size(), [&](const std::size_t stage) {
+    try {
+      switch (stage) {
+      case 0:
+        while (auto parsed = trees.pop()) {
+          for (auto &definition : *parsed) { lower(std::move(definition)); }
+        }
+        break;
+      case 1:
+        lex();
+        chunks.close();
+        break;
+      default:
+        parse();
+        trees.close();
+        break;
+      }
+    } catch (...) {
+      errors[stage] = std::current_exception();
+      chunks.close();
+      trees.close();
+    }
+  });
+
+  for (const auto &error : errors) {
+    if (error) { std::rethrow_exception(error); }
+  }
+  return symbols;
+}
+
+}// namespace thing::parsing
+
+#endif
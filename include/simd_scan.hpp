@@ -0,0 +1,201 @@
+#ifndef THING_SIMD_SCAN_HPP
+#define THING_SIMD_SCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define THING_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Runtime (non-constexpr) scanners for the long runs of bytes that dominate
+// our scripts: whitespace and identifier characters. Each scanner returns the
+// index one past the end of the run starting at `pos`.
+//
+// The best implementation for the running CPU is selected once at startup.
+// The lexer only calls into here when not constant evaluated, the constexpr
+// path keeps its scalar loops.
+
+namespace thing::simd {
+
+enum struct isa { scalar, sse42, avx2 };
+
+using scan_function = std::size_t (*)(std::string_view, std::size_t) noexcept;
+
+struct scanners
+{
+  isa instruction_set;
+  scan_function whitespace;
+  scan_function identifier;
+};
+
+[[nodiscard]] constexpr bool is_whitespace_byte(const char c) noexcept
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+[[nodiscard]] constexpr bool is_identifier_byte(const char c) noexcept
+{
+  return c == '_' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+[[nodiscard]] inline std::size_t scalar_whitespace(std::string_view v, std::size_t pos) noexcept
+{
+  while (pos < v.size() && is_whitespace_byte(v[pos])) { ++pos; }
+  return pos;
+}
+
+[[nodiscard]] inline std::size_t scalar_identifier(std::string_view v, std::size_t pos) noexcept
+{
+  while (pos < v.size() && is_identifier_byte(v[pos])) { ++pos; }
+  return pos;
+}
+
+#ifdef THING_SIMD_X86
+
+// SSE4.2 string instructions do the classification for us, with explicit
+// lengths so that embedded '\0' bytes are not treated as terminators
+__attribute__((target("sse4.2"))) [[nodiscard]] inline std::size_t sse42_whitespace(std::string_view v,
+  std::size_t pos) noexcept
+{
+  const __m128i set = _mm_setr_epi8(' ', '\t', '\n', '\v', '\f', '\r', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  constexpr int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+
+  while (pos + 16 <= v.size()) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v.data() + pos));
+    const auto index = _mm_cmpestri(set, 6, block, 16, mode);
+    pos += static_cast<std::size_t>(index);
+    if (index != 16) { return pos; }
+  }
+  return scalar_whitespace(v, pos);
+}
+
+__attribute__((target("sse4.2"))) [[nodiscard]] inline std::size_t sse42_identifier(std::string_view v,
+  std::size_t pos) noexcept
+{
+  const __m128i ranges = _mm_setr_epi8('_', '_', '0', '9', 'a', 'z', 'A', 'Z', 0, 0, 0, 0, 0, 0, 0, 0);
+  constexpr int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+
+  while (pos + 16 <= v.size()) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v.data() + pos));
+    const auto index = _mm_cmpestri(ranges, 8, block, 16, mode);
+    pos += static_cast<std::size_t>(index);
+    if (index != 16) { return pos; }
+  }
+  return scalar_identifier(v, pos);
+}
+
+// lo <= x <= hi, using signed compares, which conveniently rejects every
+// byte >= 0x80
+__attribute__((target("avx2"))) [[nodiscard]] inline __m256i avx2_in_range(const __m256i x,
+  const char lo,
+  const char hi) noexcept
+{
+  return _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+    _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), x));
+}
+
+__attribute__((target("avx2"))) [[nodiscard]] inline std::size_t avx2_whitespace(std::string_view v,
+  std::size_t pos) noexcept
+{
+  while (pos + 32 <= v.size()) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v.data() + pos));
+    const __m256i matches =
+      _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')), avx2_in_range(block, '\t', '\r'));
+    const auto mismatches = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(matches));
+    if (mismatches != 0) { return pos + static_cast<std::size_t>(__builtin_ctz(mismatches)); }
+    pos += 32;
+  }
+  return sse42_whitespace(v, pos);
+}
+
+__attribute__((target("avx2"))) [[nodiscard]] inline std::size_t avx2_identifier(std::string_view v,
+  std::size_t pos) noexcept
+{
+  while (pos + 32 <= v.size()) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v.data() + pos));
+    // setting bit 5 folds 'A'-'Z' onto 'a'-'z' without creating other letters
+    const __m256i folded = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+    const __m256i matches =
+      _mm256_or_si256(_mm256_or_si256(avx2_in_range(folded, 'a', 'z'), avx2_in_range(block, '0', '9')),
+        _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_')));
+    const auto mismatches = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(matches));
+    if (mismatches != 0) { return pos + static_cast<std::size_t>(__builtin_ctz(mismatches)); }
+    pos += 32;
+  }
+  return sse42_identifier(v, pos);
+}
+
+#endif
+
+[[nodiscard]] inline bool is_supported(const isa instruction_set) noexcept
+{
+  switch (instruction_set) {
+  case isa::scalar:
+    return true;
+#ifdef THING_SIMD_X86
+  case isa::sse42:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+  case isa::avx2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2");
+#else
+  case isa::sse42:
+  case isa::avx2:
+    return false;
+#endif
+  }
+  return false;
+}
+
+// Returns the scanners for a specific instruction set, which must be
+// supported. Mostly useful for testing the implementations against each other.
+[[nodiscard]] inline scanners scanners_for(const isa instruction_set) noexcept
+{
+  switch (instruction_set) {
+#ifdef THING_SIMD_X86
+  case isa::avx2:
+    return { isa::avx2, avx2_whitespace, avx2_identifier };
+  case isa::sse42:
+    return { isa::sse42, sse42_whitespace, sse42_identifier };
+#else
+  case isa::avx2:
+  case isa::sse42:
+#endif
+  case isa::scalar:
+    break;
+  }
+  return { isa::scalar, scalar_whitespace, scalar_identifier };
+}
+
+[[nodiscard]] inline scanners select_scanners() noexcept
+{
+  for (const auto instruction_set : { isa::avx2, isa::sse42 }) {
+    if (is_supported(instruction_set)) { return scanners_for(instruction_set); }
+  }
+  return scanners_for(isa::scalar);
+}
+
+// function local static, so that lexing during static initialization is safe
+[[nodiscard]] inline const scanners &active_scanners() noexcept
+{
+  static const scanners selected = select_scanners();
+  return selected;
+}
+
+[[nodiscard]] inline std::size_t scan_whitespace(std::string_view v, std::size_t pos) noexcept
+{
+  return active_scanners().whitespace(v, pos);
+}
+
+[[nodiscard]] inline std::size_t scan_identifier(std::string_view v, std::size_t pos) noexcept
+{
+  return active_scanners().identifier(v, pos);
+}
+
+}// namespace thing::simd
+
+#endif
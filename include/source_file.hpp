@@ -0,0 +1,286 @@
+#ifndef THING_SOURCE_FILE_HPP
+#define THING_SOURCE_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#define THING_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "lexer.hpp"
+#include "token_buffer.hpp"
+
+// Script files are memory mapped read only, so that lex_items, parse_nodes
+// and diagnostics point straight into the page cache and the file is never
+// copied. Where mmap is not available the file is read into memory instead,
+// behind the same interface.
+//
+// Mapped files must not be modified while they are in use.
+
+namespace thing {
+
+#ifdef THING_HAS_MMAP
+
+[[noreturn]] inline void throw_file_error(const std::filesystem::path &path)
+{
+  throw std::system_error(errno, std::generic_category(), path.string());
+}
+
+struct file_descriptor
+{
+  int handle;
+
+  explicit file_descriptor(const std::filesystem::path &path) : handle{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) }
+  {
+    if (handle == -1) { throw_file_error(path); }
+  }
+
+  file_descriptor(const file_descriptor &) = delete;
+  file_descriptor(file_descriptor &&other) noexcept : handle{ std::exchange(other.handle, -1) } {}
+  file_descriptor &operator=(const file_descriptor &) = delete;
+  file_descriptor &operator=(file_descriptor &&other) noexcept
+  {
+    std::swap(handle, other.handle);
+    return *this;
+  }
+  ~file_descriptor()
+  {
+    if (handle != -1) { ::close(handle); }
+  }
+
+  [[nodiscard]] std::size_t size(const std::filesystem::path &path) const
+  {
+    struct stat status{};
+    if (::fstat(handle, &status) == -1) { throw_file_error(path); }
+    return static_cast<std::size_t>(status.st_size);
+  }
+};
+
+// A read only, private mapping of `size` bytes of a file starting at
+// `offset`, which must be a multiple of the page size
+struct mapped_region
+{
+  void *address{ nullptr };
+  std::size_t size{ 0 };
+
+  mapped_region() = default;
+
+  mapped_region(const std::filesystem::path &path,
+    const file_descriptor &file,
+    const std::size_t offset,
+    const std::size_t size_)
+    : size{ size_ }
+  {
+    // mapping nothing is an error, but an empty file is not
+    if (size == 0) { return; }
+
+    address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.handle, static_cast<off_t>(offset));
+    if (address == MAP_FAILED) {
+      address = nullptr;
+      throw_file_error(path);
+    }
+
+    // Both are hints and failing them is harmless. We read front to back
+    // once, so the kernel can read ahead aggressively and drop pages behind
+    // us. Huge pages only take effect where the kernel supports them for the
+    // page cache, but save a lot of TLB misses on large scripts when it does.
+    ::madvise(address, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    ::madvise(address, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  mapped_region(const mapped_region &) = delete;
+  mapped_region(mapped_region &&other) noexcept
+    : address{ std::exchange(other.address, nullptr) }, size{ std::exchange(other.size, 0) }
+  {}
+  mapped_region &operator=(const mapped_region &) = delete;
+  mapped_region &operator=(mapped_region &&other) noexcept
+  {
+    std::swap(address, other.address);
+    std::swap(size, other.size);
+    return *this;
+  }
+  ~mapped_region()
+  {
+    if (address != nullptr) { ::munmap(address, size); }
+  }
+
+  [[nodiscard]] std::string_view text() const noexcept
+  {
+    return { static_cast<const char *>(address), address == nullptr ? 0 : size };
+  }
+};
+
+[[nodiscard]] inline std::size_t page_size() noexcept
+{
+  static const auto size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+#endif
+
+// A whole script, loaded read only. text() stays valid, at the same address,
+// for as long as the source_file exists, including across moves.
+struct source_file
+{
+  std::filesystem::path path;
+#ifdef THING_HAS_MMAP
+  mapped_region region;
+#else
+  std::vector<char> contents;
+#endif
+
+  explicit source_file(std::filesystem::path path_) : path{ std::move(path_) }
+  {
+#ifdef THING_HAS_MMAP
+    const file_descriptor file{ path };
+    region = mapped_region{ path, file, 0, file.size(path) };
+#else
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) { throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), path.string()); }
+    contents.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+#endif
+  }
+
+  [[nodiscard]] std::string_view text() const noexcept
+  {
+#ifdef THING_HAS_MMAP
+    return region.text();
+#else
+    return { contents.data(), contents.size() };
+#endif
+  }
+};
+
+// Reads a file that may be larger than memory through a sliding window, so
+// that only the window is mapped at any time
+struct source_stream
+{
+  static constexpr std::size_t default_window_size = std::size_t{ 64 } * 1024 * 1024;
+
+  std::filesystem::path path;
+  std::size_t window_size;
+#ifdef THING_HAS_MMAP
+  file_descriptor file;
+  std::size_t size;
+  mapped_region region;
+#else
+  std::ifstream file;
+  std::size_t size;
+  std::vector<char> buffer;
+#endif
+
+  explicit source_stream(std::filesystem::path path_, const std::size_t window_size_ = default_window_size)
+#ifdef THING_HAS_MMAP
+    : path{ std::move(path_) }, window_size{ window_size_ }, file{ path }, size{ file_size() }
+#else
+    : path{ std::move(path_) }, window_size{ window_size_ }, file{ path, std::ios::binary }, size{ file_size() }
+#endif
+  {}
+
+  [[nodiscard]] std::size_t file_size() const
+  {
+#ifdef THING_HAS_MMAP
+    return file.size(path);
+#else
+    if (!file) { throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), path.string()); }
+    return std::filesystem::file_size(path);
+#endif
+  }
+
+  // Makes the `length` bytes at `offset` available, fewer at the end of the
+  // file. The returned text is valid until the next call. Without mmap, a
+  // file that got shorter since it was opened ends where the read stopped.
+  [[nodiscard]] std::string_view window(const std::size_t offset, const std::size_t length)
+  {
+    const auto end = std::min(size, offset + length);
+#ifdef THING_HAS_MMAP
+    const auto mapped_offset = offset - offset % page_size();
+    region = mapped_region{};
+    region = mapped_region{ path, file, mapped_offset, end - mapped_offset };
+    return region.text().substr(offset - mapped_offset);
+#else
+    buffer.resize(end - offset);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+    const auto read = static_cast<std::size_t>(file.gcount());
+    if (read < buffer.size()) {
+      buffer.resize(read);
+      size = offset + read;
+    }
+    return { buffer.data(), buffer.size() };
+#endif
+  }
+};
+
+// Tokenizes a file of any size one window at a time. `consume` is called with
+// the token_buffer of each chunk and the file offset its source starts at;
+// both are only valid during the call, and symbol ids are per chunk.
+//
+// Chunks end on token boundaries and only the last one ends with an
+// end_of_file token. A token that does not fit in the window grows the
+// window. Note that unterminated strings and unknown tokens run to the end of
+// the file, so those are only supported for files that fit in memory.
+template<template<class> class Container_Type = std::vector, typename Consumer>
+void tokenize_stream(source_stream &stream, Consumer &&consume)
+{
+  auto window_size = std::max(stream.window_size, std::size_t{ 1 });
+
+  for (std::size_t offset = 0;;) {
+    const auto text = stream.window(offset, window_size);
+    const auto last = offset + text.size() == stream.size;
+
+    lexing::basic_token_buffer<Container_Type> tokens{ text };
+    tokens.reserve(text.size() / 4 + 1);
+
+    // end of the last token that the rest of the file cannot change
+    std::size_t end = 0;
+    for (auto remainder = text;;) {
+      const auto item = lexing::lexer(remainder);
+      if (item.type == lexing::token_type::end_of_file) {
+        if (last) { tokens.push_back(item); }
+        break;
+      }
+
+      const auto item_end = text.size() - item.remainder.size();
+      if (!last && item_end + lexing::max_lookahead > text.size()) { break; }
+
+      if (item.type != lexing::token_type::whitespace) { tokens.push_back(item); }
+      end = item_end;
+      remainder = item.remainder;
+    }
+
+    if (last) {
+      consume(std::as_const(tokens), offset);
+      return;
+    }
+
+    if (end == 0) {
+      window_size *= 2;
+      continue;
+    }
+
+    tokens.source = text.substr(0, end);
+    consume(std::as_const(tokens), offset);
+    offset += end;
+  }
+}
+
+}// namespace thing
+
+#endif
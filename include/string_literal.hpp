@@ -0,0 +1,168 @@
+#ifndef THING_STRING_LITERAL_HPP
+#define THING_STRING_LITERAL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "number_literal.hpp"
+
+// String tokens keep their quotes and escapes, exactly as written. The value
+// of a literal is only materialized when something needs it, and most
+// literals have no escapes, so their value is a view straight into the
+// source. Literals that do have escapes are decoded once, into an arena owned
+// by whoever compiles the script, so that no literal costs an allocation of
+// its own.
+//
+// Supported escapes: \n \t \r \0 \a \b \f \v \\ \" \' and \xHH with exactly
+// two hex digits. Anything else is an error.
+
+namespace thing::lexing {
+
+// Bump allocator for decoded strings. Memory is handed out from blocks of
+// `block_size` bytes and only released with the arena, so every view it
+// returns stays valid, at the same address, for the arena's lifetime. Blocks
+// are raw storage: a byte is first written by the string it is handed to.
+template<template<class> class Container_Type> struct basic_string_arena
+{
+  using allocator_type = typename Container_Type<char>::allocator_type;
+  using traits = std::allocator_traits<allocator_type>;
+
+  static constexpr std::size_t default_block_size = 16 * 1024;
+
+  struct block
+  {
+    char *data;
+    std::size_t size;
+    std::size_t capacity;
+  };
+
+  [[no_unique_address]] allocator_type alloc;
+  Container_Type<block> blocks;
+  std::size_t block_size;
+
+  constexpr explicit basic_string_arena(allocator_type alloc_ = {}, const std::size_t block_size_ = default_block_size)
+    : alloc{ alloc_ }, blocks(alloc_), block_size{ block_size_ }
+  {}
+
+  constexpr basic_string_arena(basic_string_arena &&other) noexcept
+    : alloc{ other.alloc }, blocks{ std::exchange(other.blocks, Container_Type<block>(other.alloc)) },
+      block_size{ other.block_size }
+  {}
+
+  basic_string_arena(const basic_string_arena &) = delete;
+  basic_string_arena &operator=(const basic_string_arena &) = delete;
+  basic_string_arena &operator=(basic_string_arena &&) = delete;
+
+  constexpr ~basic_string_arena()
+  {
+    for (const auto &used : blocks) { traits::deallocate(alloc, used.data, used.capacity); }
+  }
+
+  [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return alloc; }
+
+  // `size` bytes at the end of the current block, starting a new one if needed
+  [[nodiscard]] constexpr char *allocate(const std::size_t size)
+  {
+    if (blocks.empty() || blocks.back().capacity - blocks.back().size < size) {
+      const auto capacity = std::max(size, block_size);
+      auto *const data = traits::allocate(alloc, capacity);
+      // constant evaluation only writes to objects that were constructed
+      if (std::is_constant_evaluated()) {
+        for (std::size_t index = 0; index < capacity; ++index) { std::construct_at(data + index); }
+      }
+      blocks.push_back(block{ data, 0, capacity });
+    }
+
+    auto &current = blocks.back();
+    auto *const result = current.data + current.size;
+    current.size += size;
+    return result;
+  }
+
+  // gives the last `size` bytes handed out back to the arena
+  constexpr void shrink(const std::size_t size) noexcept { blocks.back().size -= size; }
+};
+
+[[nodiscard]] constexpr std::optional<char> escaped_char(const char c) noexcept
+{
+  switch (c) {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  case '0':
+    return '\0';
+  case 'a':
+    return '\a';
+  case 'b':
+    return '\b';
+  case 'f':
+    return '\f';
+  case 'v':
+    return '\v';
+  case '\\':
+  case '"':
+  case '\'':
+    return c;
+  default:
+    return std::nullopt;
+  }
+}
+
+// The value of the string token `match`, quotes included, as produced by the
+// lexer. Views into `match` when there is nothing to decode, into `arena`
+// otherwise. nullopt for an invalid escape sequence.
+template<template<class> class Container_Type>
+[[nodiscard]] constexpr std::optional<std::string_view> string_value(std::string_view match,
+  basic_string_arena<Container_Type> &arena)
+{
+  const auto contents = match.substr(1, match.size() - 2);
+
+  // char_traits::find, which is memchr outside of constant evaluation
+  auto escape = contents.find('\\');
+  if (escape == std::string_view::npos) { return contents; }
+
+  // escapes never make a string longer
+  auto *const output = arena.allocate(contents.size());
+  auto *position = std::copy_n(contents.data(), escape, output);
+
+  while (escape != std::string_view::npos) {
+    const auto code = contents[escape + 1];
+    auto next = escape + 2;
+
+    if (code == 'x') {
+      const auto high = next < contents.size() ? digit_value(contents[next]) : 16;
+      const auto low = next + 1 < contents.size() ? digit_value(contents[next + 1]) : 16;
+      if (high >= 16 || low >= 16) {
+        arena.shrink(contents.size());
+        return std::nullopt;
+      }
+      *position++ = static_cast<char>(high * 16 + low);
+      next += 2;
+    } else if (const auto decoded = escaped_char(code); decoded) {
+      *position++ = *decoded;
+    } else {
+      arena.shrink(contents.size());
+      return std::nullopt;
+    }
+
+    escape = contents.find('\\', next);
+    const auto run = contents.substr(next, escape == std::string_view::npos ? std::string_view::npos : escape - next);
+    position = std::copy(run.begin(), run.end(), position);
+  }
+
+  const auto length = static_cast<std::size_t>(position - output);
+  arena.shrink(contents.size() - length);
+  return std::string_view{ output, length };
+}
+
+}// namespace thing::lexing
+
+#endif
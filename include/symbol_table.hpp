@@ -0,0 +1,182 @@
+#ifndef THING_SYMBOL_TABLE_HPP
+#define THING_SYMBOL_TABLE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace thing::lexing {
+
+// Identifiers and keywords are interned into dense 32-bit ids, so that the
+// parser, the AST and later variable lookup compare integers instead of
+// strings. Keywords have fixed ids, assigned below, identifiers are numbered
+// in order of first appearance after them.
+using symbol_id = std::uint32_t;
+
+namespace symbols {
+  constexpr symbol_id none = 0;
+  constexpr symbol_id auto_ = 1;
+  constexpr symbol_id for_ = 2;
+  constexpr symbol_id if_ = 3;
+  constexpr symbol_id else_ = 4;
+  constexpr symbol_id while_ = 5;
+  // names that the lexer reads as identifiers, but with fixed ids as well
+  constexpr symbol_id true_ = 6;
+  constexpr symbol_id false_ = 7;
+}// namespace symbols
+
+// indexed by symbol_id
+static constexpr std::array<std::string_view, 6> keyword_names{ "", "auto", "for", "if", "else", "while" };
+
+// every name with a fixed id, keywords first, indexed by symbol_id
+static constexpr std::array<std::string_view, 8> predefined_names{
+  "", "auto", "for", "if", "else", "while", "true", "false"
+};
+
+// the id of the first name interned from a script
+static constexpr auto first_identifier = static_cast<symbol_id>(predefined_names.size());
+
+// Perfect hash over the keywords, from the first byte, last byte and length.
+// The multiplier is searched for at compile time.
+struct keyword_hash
+{
+  static constexpr std::size_t table_size = 8;
+
+  std::size_t multiplier;
+
+  [[nodiscard]] constexpr std::size_t operator()(std::string_view name) const noexcept
+  {
+    return (static_cast<unsigned char>(name.front()) * multiplier + static_cast<unsigned char>(name.back())
+             + name.size())
+           % table_size;
+  }
+};
+
+[[nodiscard]] consteval keyword_hash find_keyword_hash()
+{
+  for (std::size_t multiplier = 1; multiplier < 1024; ++multiplier) {
+    const keyword_hash hash{ multiplier };
+    std::array<bool, keyword_hash::table_size> used{};
+    bool collision = false;
+    for (std::size_t id = 1; id < keyword_names.size(); ++id) {
+      auto &slot = used[hash(keyword_names[id])];
+      collision = collision || slot;
+      slot = true;
+    }
+    if (!collision) { return hash; }
+  }
+  throw "no perfect hash found for the keyword set";
+}
+
+static constexpr auto keyword_hasher = find_keyword_hash();
+
+[[nodiscard]] consteval std::array<symbol_id, keyword_hash::table_size> make_keyword_slots()
+{
+  std::array<symbol_id, keyword_hash::table_size> slots{};
+  for (std::size_t id = 1; id < keyword_names.size(); ++id) {
+    slots[keyword_hasher(keyword_names[id])] = static_cast<symbol_id>(id);
+  }
+  return slots;
+}
+
+static constexpr auto keyword_slots = make_keyword_slots();
+
+// returns symbols::none if `name` is not a keyword
+[[nodiscard]] constexpr symbol_id keyword_lookup(std::string_view name) noexcept
+{
+  if (name.empty()) { return symbols::none; }
+  const auto id = keyword_slots[keyword_hasher(name)];
+  return keyword_names[id] == name ? id : symbols::none;
+}
+
+// Open addressing hash table of interned names. The names are views into the
+// source buffers and must outlive the table.
+template<template<class> class Container_Type> struct basic_symbol_table
+{
+  using allocator_type = typename Container_Type<std::string_view>::allocator_type;
+
+  // indexed by symbol_id
+  Container_Type<std::string_view> names;
+  // power of two sized, symbols::none marks an empty slot
+  Container_Type<symbol_id> slots;
+
+  constexpr explicit basic_symbol_table(allocator_type alloc = {}) : names(alloc), slots(alloc)
+  {
+    names.insert(names.end(), predefined_names.begin(), predefined_names.end());
+    slots.resize(16);
+    for (symbol_id id = 1; id < names.size(); ++id) { insert_slot(id); }
+  }
+
+  constexpr basic_symbol_table(const basic_symbol_table &other, allocator_type alloc)
+    : names(other.names, alloc), slots(other.slots, alloc)
+  {}
+
+  constexpr basic_symbol_table(basic_symbol_table &&other, allocator_type alloc)
+    : names(std::move(other.names), alloc), slots(std::move(other.slots), alloc)
+  {}
+
+  [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return names.get_allocator(); }
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return names.size(); }
+
+  [[nodiscard]] constexpr std::string_view name(const symbol_id id) const noexcept { return names[id]; }
+
+  // returns symbols::none if `name` has not been interned
+  [[nodiscard]] constexpr symbol_id find(std::string_view name_) const noexcept
+  {
+    for (auto slot = hash(name_) & mask();; slot = (slot + 1) & mask()) {
+      const auto id = slots[slot];
+      if (id == symbols::none || names[id] == name_) { return id; }
+    }
+  }
+
+  constexpr symbol_id intern(std::string_view name_)
+  {
+    if (const auto keyword = keyword_lookup(name_); keyword != symbols::none) { return keyword; }
+
+    auto slot = hash(name_) & mask();
+    for (; slots[slot] != symbols::none; slot = (slot + 1) & mask()) {
+      if (names[slots[slot]] == name_) { return slots[slot]; }
+    }
+
+    const auto id = static_cast<symbol_id>(names.size());
+    names.push_back(name_);
+    slots[slot] = id;
+
+    // keep the load factor under 1/2
+    if (names.size() * 2 > slots.size()) { rehash(slots.size() * 2); }
+    return id;
+  }
+
+  [[nodiscard]] static constexpr std::uint64_t hash(std::string_view name_) noexcept
+  {
+    // FNV-1a
+    std::uint64_t result = 14695981039346656037ull;
+    for (const char c : name_) {
+      result ^= static_cast<unsigned char>(c);
+      result *= 1099511628211ull;
+    }
+    return result;
+  }
+
+  [[nodiscard]] constexpr std::size_t mask() const noexcept { return slots.size() - 1; }
+
+  constexpr void insert_slot(const symbol_id id)
+  {
+    auto slot = hash(names[id]) & mask();
+    while (slots[slot] != symbols::none) { slot = (slot + 1) & mask(); }
+    slots[slot] = id;
+  }
+
+  constexpr void rehash(const std::size_t size)
+  {
+    slots.assign(size, symbols::none);
+    for (symbol_id id = 1; id < names.size(); ++id) { insert_slot(id); }
+  }
+};
+
+}// namespace thing::lexing
+
+#endif
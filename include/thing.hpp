@@ -1,3 +1,6 @@
+#ifndef THING_THING_HPP
+#define THING_THING_HPP
+
 #include <array>
 #include <cassert>
 #include <cstdint>
@@ -563,3 +566,5 @@ template <typename StackType> struct Operations {
     return !std::holds_alternative<Nop>(values[pc]);
   }
 };
+
+#endif
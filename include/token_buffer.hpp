@@ -0,0 +1,273 @@
+#ifndef THING_TOKEN_BUFFER_HPP
+#define THING_TOKEN_BUFFER_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "lex_item.hpp"
+#include "lexer.hpp"
+#include "symbol_table.hpp"
+
+namespace thing::lexing {
+
+// The whole token stream of a source buffer, stored as parallel arrays so
+// that a token costs 13 bytes (type, offset, length, symbol) instead of a
+// full lex_item. Whitespace is not stored and the stream always ends with an
+// end_of_file token. Identifiers are interned into the buffer's symbol table
+// as they are lexed.
+//
+// Offsets are relative to `source`, which must outlive the buffer.
+template<template<class> class Container_Type> struct basic_token_buffer
+{
+  using offset_type = std::uint32_t;
+  using allocator_type = typename Container_Type<token_type>::allocator_type;
+
+  std::string_view source;
+  Container_Type<token_type> types;
+  Container_Type<offset_type> offsets;
+  Container_Type<offset_type> lengths;
+  Container_Type<symbol_id> symbol_ids;
+  basic_symbol_table<Container_Type> symbols;
+  Container_Type<number_value> numbers;
+
+  constexpr explicit basic_token_buffer(std::string_view source_, allocator_type alloc = {})
+    : source{ source_ }, types(alloc), offsets(alloc), lengths(alloc), symbol_ids(alloc), symbols(alloc), numbers(alloc)
+  {}
+
+  [[nodiscard]] constexpr allocator_type get_allocator() const noexcept { return types.get_allocator(); }
+
+  [[nodiscard]] constexpr std::size_t size() const noexcept { return types.size(); }
+
+  [[nodiscard]] constexpr std::string_view match(const std::size_t index) const noexcept
+  {
+    return source.substr(offsets[index], lengths[index]);
+  }
+
+  // offset one past the end of the token at `index`
+  [[nodiscard]] constexpr std::size_t end(const std::size_t index) const noexcept
+  {
+    return std::size_t{ offsets[index] } + lengths[index];
+  }
+
+  // Materializes the token at `index` as a lex_item pointing into `source`
+  [[nodiscard]] constexpr lex_item operator[](const std::size_t index) const noexcept
+  {
+    lex_item item{ types[index], source.substr(offsets[index], lengths[index]), source.substr(end(index)) };
+    if (types[index] == token_type::number) {
+      item.number = numbers[symbol_ids[index]];
+    } else {
+      item.symbol = symbol_ids[index];
+    }
+    return item;
+  }
+
+  // the entry of symbol_ids for `item`, interning its name or storing its
+  // value as needed
+  [[nodiscard]] constexpr symbol_id symbol_slot(const lex_item &item)
+  {
+    switch (item.type) {
+    case token_type::identifier:
+      return symbols.intern(item.match);
+    case token_type::number:
+      numbers.push_back(item.number);
+      return static_cast<symbol_id>(numbers.size() - 1);
+    default:
+      return item.symbol;
+    }
+  }
+
+  constexpr void reserve(const std::size_t count)
+  {
+    types.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
+    symbol_ids.reserve(count);
+  }
+
+  constexpr void push_back(const lex_item &item)
+  {
+    types.push_back(item.type);
+    offsets.push_back(static_cast<offset_type>(item.match.data() - source.data()));
+    lengths.push_back(static_cast<offset_type>(item.match.size()));
+    symbol_ids.push_back(symbol_slot(item));
+  }
+};
+
+template<template<class> class Container_Type = std::vector>
+[[nodiscard]] constexpr basic_token_buffer<Container_Type> tokenize(std::string_view source,
+  typename basic_token_buffer<Container_Type>::allocator_type alloc = {})
+{
+  if (!std::is_constant_evaluated()) {
+    assert(source.size() <= std::numeric_limits<typename basic_token_buffer<Container_Type>::offset_type>::max());
+  }
+
+  basic_token_buffer<Container_Type> result{ source, alloc };
+  // typical scripts average a little over 4 bytes per token
+  result.reserve(source.size() / 4 + 1);
+
+  auto remainder = source;
+  while (true) {
+    const auto item = lexer(remainder);
+    if (item.type != token_type::whitespace) { result.push_back(item); }
+    if (item.type == token_type::end_of_file) { return result; }
+    remainder = item.remainder;
+  }
+}
+
+// A change to a source buffer: `removed` bytes at `offset` were replaced by
+// `inserted`
+struct text_edit
+{
+  std::size_t offset;
+  std::size_t removed;
+  std::string_view inserted;
+};
+
+// Tokens [first, first + removed) of the buffer before a relex were replaced
+// by tokens [first, first + inserted). Everything else was kept, with the
+// offsets after the edit shifted.
+struct relexed_tokens
+{
+  std::size_t first;
+  std::size_t removed;
+  std::size_t inserted;
+};
+
+// Updates `tokens` in place for `edit`. `source` is the new buffer, the old
+// buffer with the edit applied, and replaces `tokens.source`; the old buffer
+// is no longer read and may already be gone.
+//
+// Lexing restarts after the last token that the edit cannot have changed and
+// stops as soon as a new token starts where an old token started, past the
+// edit. The lexer carries no state from one token to the next, so from that
+// point on the old tokens are still correct. That includes edits that open or
+// close a string literal: the stream then differs until the quotes pair up
+// the same way again, which may be at the end of the buffer. Likewise an
+// unknown token runs to the end of the buffer, so an edit that creates or
+// removes one relexes everything after it.
+//
+// Symbol ids of kept tokens do not change. A name whose only occurrences were
+// removed keeps its id, which will not match anything again. Likewise the
+// values of replaced number tokens stay in `numbers`, unreferenced.
+template<template<class> class Container_Type>
+constexpr relexed_tokens
+  relex(basic_token_buffer<Container_Type> &tokens, std::string_view source, const text_edit &edit)
+{
+  using offset_type = typename basic_token_buffer<Container_Type>::offset_type;
+
+  const auto old_source = tokens.source;
+  if (!std::is_constant_evaluated()) {
+    assert(edit.offset + edit.removed <= old_source.size());
+    assert(source.size() + edit.removed == old_source.size() + edit.inserted.size());
+    assert(source.substr(edit.offset, edit.inserted.size()) == edit.inserted);
+    assert(source.size() <= std::numeric_limits<offset_type>::max());
+  }
+
+  // the first token the edit may have changed, tokens end in increasing order
+  std::size_t first = 0;
+  for (std::size_t count = tokens.size(); count > 0;) {
+    const auto half = count / 2;
+    if (tokens.end(first + half) + max_lookahead <= edit.offset) {
+      first += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+
+  const auto restart = first == 0 ? std::size_t{ 0 } : tokens.end(first - 1);
+  const auto inserted_end = edit.offset + edit.inserted.size();
+
+  Container_Type<lex_item> fresh(tokens.get_allocator());
+  std::size_t resync = first;
+  for (auto remainder = source.substr(restart);;) {
+    const auto item = lexer(remainder);
+    remainder = item.remainder;
+    if (item.type == token_type::whitespace) { continue; }
+
+    if (const auto start = static_cast<std::size_t>(item.match.data() - source.data()); start >= inserted_end) {
+      const auto old_start = start - edit.inserted.size() + edit.removed;
+      while (resync < tokens.size() && tokens.offsets[resync] < old_start) { ++resync; }
+      // the old end_of_file token always matches, at the latest
+      if (resync < tokens.size() && tokens.offsets[resync] == old_start) { break; }
+    }
+
+    fresh.push_back(item);
+  }
+
+  // Names are views into the source, so they are moved over to the new
+  // buffer. Names that only pointed into the replaced tokens are pointed at
+  // another occurrence of the same symbol, or retired if there is none.
+  const auto kept_tail = std::size_t{ tokens.offsets[resync] };
+  bool lost_names = false;
+  for (auto id = first_identifier; id < tokens.symbols.size(); ++id) {
+    auto &name = tokens.symbols.names[id];
+    if (name.empty()) { continue; }
+
+    const auto position = static_cast<std::size_t>(name.data() - old_source.data());
+    if (position < restart) {
+      name = source.substr(position, name.size());
+    } else if (position >= kept_tail) {
+      name = source.substr(position - edit.removed + edit.inserted.size(), name.size());
+    } else {
+      // empty names never match an identifier, but keep their hash slot
+      name = {};
+      lost_names = true;
+    }
+  }
+
+  const auto shift = [&](const std::size_t offset) {
+    return static_cast<offset_type>(offset - edit.removed + edit.inserted.size());
+  };
+
+  if (lost_names) {
+    const auto recover = [&](const std::size_t index, const std::size_t offset) {
+      if (tokens.types[index] != token_type::identifier) { return; }
+      if (auto &name = tokens.symbols.names[tokens.symbol_ids[index]]; name.empty()) {
+        name = source.substr(offset, tokens.lengths[index]);
+      }
+    };
+    for (std::size_t index = 0; index < first; ++index) { recover(index, tokens.offsets[index]); }
+    for (std::size_t index = resync; index < tokens.size(); ++index) { recover(index, shift(tokens.offsets[index])); }
+  }
+
+  // make room for the fresh tokens, moving the tail only once
+  const auto replaced = resync - first;
+  const auto resize_gap = [&](auto &array) {
+    using value_type = typename std::decay_t<decltype(array)>::value_type;
+    const auto gap = std::next(array.begin(), static_cast<std::ptrdiff_t>(first));
+    if (fresh.size() > replaced) {
+      array.insert(gap, fresh.size() - replaced, value_type{});
+    } else {
+      array.erase(gap, std::next(gap, static_cast<std::ptrdiff_t>(replaced - fresh.size())));
+    }
+  };
+  resize_gap(tokens.types);
+  resize_gap(tokens.offsets);
+  resize_gap(tokens.lengths);
+  resize_gap(tokens.symbol_ids);
+
+  for (auto index = first + fresh.size(); index < tokens.size(); ++index) {
+    tokens.offsets[index] = shift(tokens.offsets[index]);
+  }
+
+  tokens.source = source;
+  for (std::size_t index = 0; index < fresh.size(); ++index) {
+    const auto &item = fresh[index];
+    tokens.types[first + index] = item.type;
+    tokens.offsets[first + index] = static_cast<offset_type>(item.match.data() - source.data());
+    tokens.lengths[first + index] = static_cast<offset_type>(item.match.size());
+    tokens.symbol_ids[first + index] = tokens.symbol_slot(item);
+  }
+
+  return { first, replaced, fresh.size() };
+}
+
+}// namespace thing::lexing
+
+#endif
@@ -9,7 +9,10 @@
 
 #include <thing.hpp>
 #include <parser.hpp>
+#include <flat_parse_tree.hpp>
 #include <algorithms.hpp>
+#include <line_table.hpp>
+#include <source_file.hpp>
 #include <ast.hpp>
 
 static constexpr auto USAGE =
@@ -17,6 +20,7 @@ static constexpr auto USAGE =
 
     Usage:
           parser_test [options]
+          parser_test [options] <file>
 
  Options:
           -h --help     Show this screen.
@@ -102,16 +106,14 @@ using ast_builder = thing::ast::basic_ast_builder<std::vector>;
 using parser = thing::parsing::basic_parser<std::vector>;
 using parse_node = parser::parse_node;
 
-void dump(std::string_view input, const parse_node &node, const std::size_t indent = 0)
+using line_table = thing::basic_line_table<std::vector>;
+
+// works on parse_nodes and on the nodes of flat parse trees alike
+template<typename Node> void dump(const line_table &lines, const Node &node, const std::size_t indent = 0)
 {
   if (node.is_error()) {
-    const auto parsed = node.item;
-    const auto [line, location] = thing::count_to_last(input.begin(), parsed.remainder.begin(), '\n');
-    // skip last matched newline, and find next newline after
-    const auto errored_line =
-      std::string_view{ std::next(location), std::find(std::next(location), parsed.remainder.end(), '\n') };
-    // count column from location to beginning of unmatched string
-    const auto column = std::distance(std::next(location), parsed.remainder.begin());
+    const auto [line, column] = lines.position_of(node.item);
+    const auto errored_line = lines.line(line);
 
     std::cout << fmt::format("Error parsing input at ({},{})\n\n", line + 1, column + 1);
 
@@ -121,7 +123,9 @@ void dump(std::string_view input, const parse_node &node, const std::size_t inde
     using error_type = parse_node::error_type;
     switch (node.error) {
     case error_type::wrong_token_type:
-      std::cout << fmt::format("{:>{}}'{}' expected\n", "", column - 1, thing::lexing::to_string(node.expected_token));
+      // column is 0-based, and 0 when the error starts its line
+      std::cout << fmt::format(
+        "{:>{}}'{}' expected\n", "", column == 0 ? 0 : column - 1, thing::lexing::to_string(node.expected_token));
       //      std::cout << "Expected next_lexed_token of type: " << static_cast<int>(node.expected_token) << '\n';
       break;
     case error_type::unexpected_infix_token:
@@ -130,13 +134,25 @@ void dump(std::string_view input, const parse_node &node, const std::size_t inde
     case error_type::unexpected_prefix_token:
       std::cout << "Unexected prefix opeeration: " << node.item.match << '\n';
       break;
+    case error_type::invalid_number_literal:
+      std::cout << "Invalid number literal: " << node.item.match << '\n';
+      break;
+    case error_type::nesting_too_deep:
+      std::cout << "Nested too deeply: " << node.item.match << '\n';
+      break;
     case error_type::no_error:
       break;
     }
   }
   fmt::print("{}'{}'\n", std::string(indent, ' '), node.item.match);
 
-  for (const auto &child : node.children) { dump(input, child, indent + 2); }
+  for (const auto &child : node.children) { dump(lines, child, indent + 2); }
+}
+
+void report(const line_table &lines, const ast_builder::parse_error &error)
+{
+  const auto [line, column] = lines.position_of(error.error_location.get().item);
+  fmt::print("Error building AST at ({},{}): {}\n", line + 1, column + 1, error.error_description);
 }
 
 
@@ -144,7 +160,7 @@ auto parse_n_dump(std::string_view input)
 {
   parser p;
   auto parse_output = p.parse(input);
-  dump(input, parse_output);
+  dump(line_table{ input }, parse_output);
   return parse_output;
 }
 
@@ -159,6 +175,15 @@ int main(int argc, const char **argv)
   //    fmt::print("Command line arg: '{}': '{}'\n", arg.first, arg.second);
   //  }
 
+  if (const auto &file = args.at("<file>"); file) {
+    // tokens, parse nodes and diagnostics all point into the mapped file
+    const thing::source_file source{ file.asString() };
+    thing::parsing::basic_flat_parser<std::vector> flat_parser;
+    const auto tree = flat_parser.parse(source.text());
+    dump(line_table{ source.text() }, tree.root());
+    return 0;
+  }
+
 
   //    constexpr std::string_view str{"3 * (2+-4)^4 + 3! - 123.1"};
   constexpr std::string_view str{ "auto func(x,a*(2/z+q),d,b)" };
@@ -218,5 +243,8 @@ auto func(auto x, auto y, auto z) {
 )"};
 
 
-  const auto ast = ast_builder::build_function_ast(parse_n_dump(function), {});
+  const auto function_tree = parse_n_dump(function);
+  ast_builder builder;
+  const auto ast = builder.build_function_ast(function_tree);
+  if (ast_builder::is_parse_error(ast)) { report(line_table{ function }, std::get<ast_builder::parse_error>(ast)); }
 }
@@ -1,6 +1,11 @@
 #include <catch2/catch.hpp>
 #include <thing.hpp>
+#include <compiler.hpp>
+#include <containers.hpp>
 #include <parser.hpp>
+#include <flat_parse_tree.hpp>
+#include <string_literal.hpp>
+#include <array>
 #include <string_view>
 
 
@@ -156,12 +161,58 @@ TEST_CASE("Can lex integer literals")
   STATIC_REQUIRE(lexed_bits.type == thing::lexing::token_type::number);
 }
 
-// TEST_CASE("Can handle lexing of bad literals")
-//{
-//  CONSTEXPR auto bits = std::string_view{ "0B2010101" };
-//  CONSTEXPR auto lexed_bits = thing::lexing::lexer(bits);
-//  STATIC_REQUIRE(!lexed_bits);
-//}
+TEST_CASE("Can handle lexing of bad literals")
+{
+  CONSTEXPR auto bits = std::string_view{ "0B2010101" };
+  CONSTEXPR auto lexed_bits = thing::lexing::lexer(bits);
+  STATIC_REQUIRE(!lexed_bits);
+
+  STATIC_REQUIRE(!thing::lexing::lexer("0x").number.is_valid());
+  STATIC_REQUIRE(!thing::lexing::lexer("12ab").number.is_valid());
+  STATIC_REQUIRE(!thing::lexing::lexer("08").number.is_valid());
+  STATIC_REQUIRE(!thing::lexing::lexer("1lul").number.is_valid());
+  // does not fit in int64 without a u suffix
+  STATIC_REQUIRE(!thing::lexing::lexer("18446744073709551615").number.is_valid());
+  STATIC_REQUIRE(!thing::lexing::lexer("18446744073709551616u").number.is_valid());
+  STATIC_REQUIRE(!thing::lexing::lexer("1.0e400").number.is_valid());
+  STATIC_REQUIRE(!thing::lexing::lexer("1.0e39f").number.is_valid());
+}
+
+TEST_CASE("Number literals are decoded by the lexer")
+{
+  using thing::lexing::number_kind;
+
+  CONSTEXPR auto integer = thing::lexing::lexer("12345").number;
+  STATIC_REQUIRE(integer.kind == number_kind::signed_integer);
+  STATIC_REQUIRE(integer.as_signed() == 12345);
+
+  CONSTEXPR auto hex = thing::lexing::lexer("0xAF12345").number;
+  STATIC_REQUIRE(hex.kind == number_kind::signed_integer);
+  STATIC_REQUIRE(hex.as_signed() == 0xAF12345);
+
+  CONSTEXPR auto bits = thing::lexing::lexer("0B1010101").number;
+  STATIC_REQUIRE(bits.as_signed() == 0b1010101);
+
+  STATIC_REQUIRE(thing::lexing::lexer("017").number.as_signed() == 017);
+  STATIC_REQUIRE(thing::lexing::lexer("0").number.as_signed() == 0);
+
+  CONSTEXPR auto suffixed = thing::lexing::lexer("42uLL").number;
+  STATIC_REQUIRE(suffixed.kind == number_kind::unsigned_integer);
+  STATIC_REQUIRE(suffixed.as_unsigned() == 42);
+
+  CONSTEXPR auto large_hex = thing::lexing::lexer("0xFFFFFFFFFFFFFFFF").number;
+  STATIC_REQUIRE(large_hex.kind == number_kind::unsigned_integer);
+  STATIC_REQUIRE(large_hex.as_unsigned() == 0xFFFFFFFFFFFFFFFF);
+
+  CONSTEXPR auto fp = thing::lexing::lexer("123.42E1l").number;
+  STATIC_REQUIRE(fp.kind == number_kind::floating_point);
+  STATIC_REQUIRE(fp.as_double() == 1234.2);
+
+  STATIC_REQUIRE(thing::lexing::lexer("3.1415e2f").number.as_double() == static_cast<double>(3.1415e2f));
+  STATIC_REQUIRE(thing::lexing::lexer("1.5p3").number.as_double() == 12.0);
+  STATIC_REQUIRE(thing::lexing::lexer("0.1").number.as_double() == 0.1);
+  STATIC_REQUIRE(thing::lexing::lexer("2.").number.as_double() == 2.0);
+}
 
 
 TEST_CASE("Can lex floating point literals")
@@ -172,3 +223,134 @@ TEST_CASE("Can lex floating point literals")
   STATIC_REQUIRE(lexed_fp.remainder == "");
   STATIC_REQUIRE(lexed_fp.type == thing::lexing::token_type::number);
 }
+
+CONSTEXPR std::size_t count_tokens(std::string_view input)
+{
+  const auto tokens = thing::lexing::tokenize(input);
+  return tokens.size();
+}
+
+CONSTEXPR thing::lexing::token_type token_at(std::string_view input, const std::size_t index)
+{
+  return thing::lexing::tokenize(input)[index].type;
+}
+
+TEST_CASE("Can tokenize a whole buffer at compile time")
+{
+  STATIC_REQUIRE(count_tokens("") == 1);
+  STATIC_REQUIRE(count_tokens("  x  +\n 15 ") == 4);
+  STATIC_REQUIRE(token_at("  x  +\n 15 ", 1) == thing::lexing::token_type::plus);
+  STATIC_REQUIRE(token_at("  x  +\n 15 ", 3) == thing::lexing::token_type::end_of_file);
+}
+
+TEST_CASE("Keywords are recognized by perfect hash at compile time")
+{
+  namespace symbols = thing::lexing::symbols;
+
+  STATIC_REQUIRE(thing::lexing::keyword_lookup("auto") == symbols::auto_);
+  STATIC_REQUIRE(thing::lexing::keyword_lookup("while") == symbols::while_);
+  STATIC_REQUIRE(thing::lexing::keyword_lookup("whilst") == symbols::none);
+  STATIC_REQUIRE(thing::lexing::keyword_lookup("") == symbols::none);
+  STATIC_REQUIRE(thing::lexing::lexer("else;").symbol == symbols::else_);
+  STATIC_REQUIRE(thing::lexing::lexer("elsewhere").type == thing::lexing::token_type::identifier);
+  // the boolean constants are identifiers, interned with fixed ids
+  STATIC_REQUIRE(thing::lexing::lexer("true").type == thing::lexing::token_type::identifier);
+  STATIC_REQUIRE(thing::lexing::tokenize("false true").symbol_ids[1] == symbols::true_);
+  STATIC_REQUIRE(thing::lexing::tokenize("x false").symbol_ids[1] == symbols::false_);
+}
+
+TEST_CASE("String literals are decoded at compile time")
+{
+  constexpr auto decode = [](const std::string_view source, const std::string_view expected) {
+    thing::lexing::basic_string_arena<std::vector> arena;
+    const auto value = thing::lexing::string_value(thing::lexing::lexer(source).match, arena);
+    return value && *value == expected;
+  };
+
+  STATIC_REQUIRE(decode(R"("no escapes")", "no escapes"));
+  STATIC_REQUIRE(decode(R"("a\tb\\c\x21")", "a\tb\\c!"));
+  STATIC_REQUIRE(!decode(R"("\e")", ""));
+}
+
+TEST_CASE("Can build a flat parse tree at compile time")
+{
+  constexpr auto shape = [] {
+    thing::parsing::basic_flat_parser<std::vector> parser;
+    const auto tree = parser.parse("5 * 2 + f(4, 3)");
+    const auto root = tree.root();
+    return root.item.type == thing::lexing::token_type::plus && tree.size() == 8 && root.children.size() == 2
+           && root.children[0].item.type == thing::lexing::token_type::asterisk
+           && root.children[1].item.match == "f" && root.children[1].children.front().children.size() == 2
+           && root.children[1].children.front().children.back().item.number.as_signed() == 3;
+  };
+
+  STATIC_REQUIRE(shape());
+}
+
+TEST_CASE("Nesting is limited by the parser, not by the constexpr call depth")
+{
+  constexpr auto nested = [](const std::size_t levels, const std::size_t max_nesting) {
+    std::array<char, 4001> script{};
+    std::size_t size = 0;
+    for (std::size_t level = 0; level < levels; ++level) { script[size++] = '('; }
+    script[size++] = '1';
+    for (std::size_t level = 0; level < levels; ++level) { script[size++] = ')'; }
+
+    thing::parsing::basic_flat_parser<std::vector> parser;
+    parser.max_nesting = max_nesting;
+    return parser.parse(std::string_view{ script.data(), size }).root().error;
+  };
+
+  // deeper than the recursion that constant evaluation allows
+  STATIC_REQUIRE(nested(2000, 4000) == thing::parsing::error_type::no_error);
+  STATIC_REQUIRE(nested(8, 4) == thing::parsing::error_type::nesting_too_deep);
+}
+
+TEST_CASE("small_vector works at compile time")
+{
+  constexpr auto sum = [] {
+    thing::small_vector<int, 2> values;
+    for (int value = 1; value <= 10; ++value) { values.push_back(value); }
+    values.erase(values.begin(), values.begin() + 5);
+    auto moved = std::move(values);
+    int total = 0;
+    for (const auto value : moved) { total += value; }
+    return total;
+  };
+  STATIC_REQUIRE(sum() == 40);
+}
+
+template<typename Result> constexpr Result run_script(const Operations<thing::compiling::script_stack> &program)
+{
+  thing::compiling::script_stack stack;
+  thing::compiling::run(program, stack);
+  const auto *result = peek<Result>(stack, 0);
+  if (result != nullptr) {
+    return *result;
+  } else {
+    return Result{};
+  }
+}
+
+TEST_CASE("Scripts are compiled to Operations at compile time")
+{
+  static constexpr auto answer = thing::compiling::compile_embedded("auto x{ 6 * 7 }; x - 2");
+  STATIC_REQUIRE(run_script<std::int64_t>(answer) == 40);
+
+  static constexpr auto nested =
+    thing::compiling::compile_embedded("auto a{ 3 }; auto b{ (a + 1) * (a - 1) }; -b + a * 2");
+  STATIC_REQUIRE(run_script<std::int64_t>(nested) == -2);
+
+  static constexpr auto comparison = thing::compiling::compile_embedded("auto a{ 3 }; a * 2 < 7 && a != 4 || false");
+  STATIC_REQUIRE(run_script<bool>(comparison));
+
+  static constexpr auto constants = thing::compiling::compile_embedded("auto yes{ true }; yes && false || yes");
+  STATIC_REQUIRE(run_script<bool>(constants));
+
+  static constexpr auto floating = thing::compiling::compile_embedded("auto half{ 0.5 }; half * 3.0 + 1.0");
+  STATIC_REQUIRE(run_script<double>(floating) == 2.5);
+
+  static constexpr auto branches = thing::compiling::compile_embedded(
+    "auto a{ 3 }; auto b{ if (a < 4) { a * 2; } else { 1; } }; auto c{ b + if (b == 5) 1; else -1; }; c");
+  STATIC_REQUIRE(run_script<std::int64_t>(branches) == 5);
+}
@@ -1,6 +1,34 @@
 #include <catch2/catch.hpp>
 #include "../include/parser.hpp"
+#include "../include/ast.hpp"
+#include "../include/compiler.hpp"
+#include "../include/containers.hpp"
+#include "../include/flat_parse_tree.hpp"
+#include "../include/incremental_parse.hpp"
+#include "../include/lazy_definitions.hpp"
 #include "../include/algorithms.hpp"
+#include "../include/line_table.hpp"
+#include "../include/parse_arena.hpp"
+#include "../include/parse_cache.hpp"
+#include "../include/parse_events.hpp"
+#include "../include/parallel_lexer.hpp"
+#include "../include/parallel_parser.hpp"
+#include "../include/pipeline.hpp"
+#include "../include/source_file.hpp"
+#include "../include/string_literal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 TEST_CASE("Can parse expressions with precendence")
 {
@@ -19,3 +47,1477 @@ TEST_CASE("Can parse expressions with precendence")
   CHECK(result.children[1].children[0].item.match == "4");
   CHECK(result.children[1].children[1].item.match == "3");
 }
+
+TEST_CASE("Vectorized scanners agree with the scalar scanners")
+{
+  using thing::simd::isa;
+
+  // runs of every length up to a few blocks, separated by bytes that end them,
+  // including '\0' and bytes >= 0x80
+  constexpr std::string_view alphabet{ " \t\n\r\v\f_azAZ09.\"+\0\x80\xff", 20 };
+  std::string input;
+  std::uint32_t state = 42;
+  while (input.size() < 4096) {
+    state = state * 1664525u + 1013904223u;
+    const auto c = alphabet[(state >> 8) % alphabet.size()];
+    input.append((state >> 16) % 70, c);
+    input += alphabet[(state >> 4) % alphabet.size()];
+  }
+
+  const auto reference = thing::simd::scanners_for(isa::scalar);
+
+  for (const auto instruction_set : { isa::sse42, isa::avx2 }) {
+    if (!thing::simd::is_supported(instruction_set)) { continue; }
+    const auto scanners = thing::simd::scanners_for(instruction_set);
+    REQUIRE(scanners.instruction_set == instruction_set);
+
+    std::size_t mismatches = 0;
+    for (std::size_t pos = 0; pos <= input.size(); ++pos) {
+      if (scanners.whitespace(input, pos) != reference.whitespace(input, pos)) { ++mismatches; }
+      if (scanners.identifier(input, pos) != reference.identifier(input, pos)) { ++mismatches; }
+    }
+    CHECK(mismatches == 0);
+  }
+}
+
+TEST_CASE("tokenize produces the lexer's token stream without whitespace")
+{
+  constexpr std::string_view str = "auto func(auto x, auto y) {\n  if (x >= 0x10) { print(\"a \\\" b\"); }\n}";
+  const auto tokens = thing::lexing::tokenize(str);
+
+  std::vector<thing::lexing::lex_item> expected;
+  for (auto item = thing::parsing::basic_parser<std::vector>::next_token(str);;
+       item = thing::parsing::basic_parser<std::vector>::next_token(item.remainder)) {
+    expected.push_back(item);
+    if (item.type == thing::lexing::token_type::end_of_file) { break; }
+  }
+
+  REQUIRE(tokens.size() == expected.size());
+  for (std::size_t index = 0; index < tokens.size(); ++index) {
+    CHECK(tokens[index].type == expected[index].type);
+    CHECK(tokens[index].match.data() == expected[index].match.data());
+    CHECK(tokens[index].match.size() == expected[index].match.size());
+    CHECK(tokens[index].remainder == expected[index].remainder);
+  }
+}
+
+namespace {
+template<typename Lhs, typename Rhs> bool same_tree(const Lhs &lhs, const Rhs &rhs)
+{
+  if (lhs.item.type != rhs.item.type || lhs.item.match.data() != rhs.item.match.data()
+      || lhs.item.match.size() != rhs.item.match.size() || lhs.item.symbol != rhs.item.symbol
+      || lhs.item.number != rhs.item.number || lhs.error != rhs.error || lhs.expected_token != rhs.expected_token
+      || lhs.children.size() != rhs.children.size()) {
+    return false;
+  }
+
+  auto rhs_child = rhs.children.begin();
+  for (const auto &lhs_child : lhs.children) {
+    if (!same_tree(lhs_child, *rhs_child)) { return false; }
+    ++rhs_child;
+  }
+  return true;
+}
+}// namespace
+
+TEST_CASE("Parsing a token buffer matches parsing the string")
+{
+  constexpr std::string_view str = R"(
+auto func(auto x, auto y) {
+  if (x > y && y != 5) {
+    print("Hello");
+  } else {
+    print("World";
+  }
+}
+)";
+
+  thing::parsing::basic_parser<std::vector> string_parser;
+  thing::parsing::basic_parser<std::vector> buffer_parser;
+  const auto tokens = thing::lexing::tokenize(str);
+
+  CHECK(same_tree(string_parser.parse(str), buffer_parser.parse(tokens)));
+}
+
+TEST_CASE("Flat parse trees hold the same tree as parse nodes")
+{
+  std::string script = "if (true) {\n";
+  for (int statement = 0; statement < 100; ++statement) {
+    const auto id = std::to_string(statement);
+    script += "  auto value_" + id + "{ (x * 15 + 0xAF12) / -(y - 3.1415e2f)! };\n";
+    script += "  while (x > y && y != " + id + ") { print(\"Hello \\\"World\\\"\"); }\n";
+    script += "  call_other_function(value_" + id + ", z, 0B1010101, 123.42E1l);\n";
+  }
+  // and some errors, before the block is closed
+  script += R"(
+  auto func(auto x, auto y) {
+    if (x > y && y != 5) {
+      print("Hello", f(1)(2){3});
+    } else {
+      print("World" 0b2 ? ;
+    }
+  }
+}
+)";
+
+  thing::parsing::basic_parser<std::vector> node_parser;
+  thing::parsing::basic_flat_parser<std::vector> flat_parser;
+  const auto tokens = thing::lexing::tokenize(script);
+
+  const auto nodes = node_parser.parse(script);
+  const auto tree = flat_parser.parse(script);
+  CHECK(tree.size() > 3000);
+  CHECK(same_tree(nodes, tree.root()));
+  CHECK(same_tree(nodes, flat_parser.parse(tokens).root()));
+
+  // preorder, with every subtree ending where the next sibling starts
+  CHECK(tree.root().children.end_index == tree.size());
+  for (std::size_t index = 0; index < tree.size(); ++index) {
+    std::size_t end = index + 1;
+    for (std::uint32_t child = 0; child < tree[index].child_count; ++child) { end = tree[end].subtree_end; }
+    REQUIRE(tree[index].subtree_end == end);
+  }
+}
+
+namespace {
+// the node of type Node that the handle held by `value` refers to
+template<typename Node, typename Builder, typename Value>
+const Node &node_of(const Builder &builder, const Value &value)
+{
+  return builder.nodes[std::get<thing::handle<Node>>(value)];
+}
+}// namespace
+
+TEST_CASE("AST builders work on flat parse trees")
+{
+  constexpr std::string_view definition = "auto value{ 42 }";
+
+  thing::parsing::basic_parser<std::vector> node_parser;
+  thing::parsing::basic_flat_parser<std::vector> flat_parser;
+  const auto nodes = node_parser.parse(definition);
+  const auto tree = flat_parser.parse(definition);
+
+  using node_builder = thing::ast::basic_ast_builder<std::vector>;
+  using flat_builder =
+    thing::ast::basic_ast_builder<std::vector, thing::parsing::basic_flat_parse_tree<std::vector>::node_view>;
+  node_builder from_nodes_builder;
+  flat_builder from_tree_builder;
+
+  const auto from_nodes = from_nodes_builder.build_variable_definition(nodes);
+  const auto from_tree = from_tree_builder.build_variable_definition(tree.root());
+  REQUIRE(!node_builder::is_parse_error(from_nodes));
+  REQUIRE(!flat_builder::is_parse_error(from_tree));
+  CHECK(node_of<flat_builder::variable_definition>(from_tree_builder, from_tree).name.match
+        == node_of<node_builder::variable_definition>(from_nodes_builder, from_nodes).name.match);
+
+  const auto error = from_tree_builder.build_if_statement(tree.root());
+  REQUIRE(flat_builder::is_parse_error(error));
+  CHECK(std::get<flat_builder::parse_error>(error).error_location.item.match == "auto");
+}
+
+TEST_CASE("AST builders build every construct of a function")
+{
+  constexpr std::string_view function = "auto f(auto x, auto y) { if (auto z{ x * 2 }; z > -y) {"
+                                        " while (x < y) { g(x, 1)(y); } for (auto i{ 0 }; i < 10; i + 1) { x; }"
+                                        " } else { \"s\"; } }";
+
+  thing::parsing::basic_parser<std::vector> node_parser;
+  thing::parsing::basic_flat_parser<std::vector> flat_parser;
+  const auto nodes = node_parser.parse(function);
+  const auto tree = flat_parser.parse(function);
+
+  const auto check = []<typename Builder>(const typename Builder::parse_node &root) {
+    using compound_statement = typename Builder::compound_statement;
+    using function_call = typename Builder::function_call;
+    using infix_operator = typename Builder::infix_operator;
+    using literal_value = typename Builder::literal_value;
+    using variable_definition = typename Builder::variable_definition;
+
+    Builder builder;
+    auto built = builder.build_function_ast(root);
+    REQUIRE(!Builder::is_parse_error(built));
+    const auto &definition = node_of<typename Builder::function_definition>(builder, built);
+    CHECK(definition.name.match == "f");
+    const auto parameters = builder.nodes[definition.parameters];
+    REQUIRE(parameters.size() == 2);
+    CHECK(parameters[1].name.match == "y");
+
+    const auto body = builder.nodes[node_of<compound_statement>(builder, definition.body).statements];
+    REQUIRE(body.size() == 1);
+    const auto &branch = node_of<typename Builder::if_statement>(builder, body[0]);
+    REQUIRE(branch.init);
+    const auto &init = node_of<variable_definition>(builder, *branch.init);
+    CHECK(init.name.match == "z");
+    CHECK(node_of<infix_operator>(builder, init.initial_value).op.match == "*");
+    const auto &condition = node_of<infix_operator>(builder, branch.condition);
+    CHECK(condition.op.match == ">");
+    CHECK(node_of<typename Builder::prefix_operator>(builder, condition.rhs_operand).op.match == "-");
+
+    const auto true_case = builder.nodes[node_of<compound_statement>(builder, branch.true_case).statements];
+    REQUIRE(true_case.size() == 2);
+    const auto &loop = node_of<typename Builder::while_statement>(builder, true_case[0]);
+    const auto loop_body = builder.nodes[node_of<compound_statement>(builder, loop.body).statements];
+    REQUIRE(loop_body.size() == 1);
+    // g(x, 1)(y) calls the result of g(x, 1)
+    const auto &outer_call = node_of<function_call>(builder, loop_body[0]);
+    REQUIRE(outer_call.parameters.size() == 1);
+    const auto &inner_call = node_of<function_call>(builder, outer_call.function);
+    CHECK(node_of<typename Builder::identifier>(builder, inner_call.function).id.match == "g");
+    const auto arguments = builder.nodes[inner_call.parameters];
+    REQUIRE(arguments.size() == 2);
+    CHECK(node_of<literal_value>(builder, arguments[1]).value.number.as_signed() == 1);
+
+    const auto &counted = node_of<typename Builder::for_statement>(builder, true_case[1]);
+    CHECK(node_of<variable_definition>(builder, counted.init).name.match == "i");
+    CHECK(node_of<infix_operator>(builder, counted.loop_expression).op.match == "+");
+
+    REQUIRE(branch.false_case);
+    const auto false_case = builder.nodes[node_of<compound_statement>(builder, *branch.false_case).statements];
+    REQUIRE(false_case.size() == 1);
+    CHECK(node_of<literal_value>(builder, false_case[0]).value.match == "\"s\"");
+
+    // every node of a kind is in one array: x * 2, z > -y, x < y, i < 10, i + 1
+    CHECK(builder.nodes.template all<infix_operator>().size() == 5);
+    CHECK(builder.nodes.template all<function_call>().size() == 2);
+    builder.nodes.clear();
+    CHECK(builder.nodes.template all<infix_operator>().empty());
+  };
+
+  check.operator()<thing::ast::basic_ast_builder<std::vector>>(nodes);
+  check.operator()<
+    thing::ast::basic_ast_builder<std::vector, thing::parsing::basic_flat_parse_tree<std::vector>::node_view>>(
+    tree.root());
+
+  using builder_type = thing::ast::basic_ast_builder<std::vector>;
+  // nodes link to their children with 32-bit handles
+  STATIC_REQUIRE(sizeof(builder_type::expression) == 2 * sizeof(std::uint32_t));
+
+  thing::parsing::basic_parser<std::vector> parser;
+  builder_type builder;
+
+  // a syntax error is reported where the parser found it
+  const auto broken = parser.parse("auto f(auto x) { if (x > ) { x; } }");
+  const auto error = builder.build_function_ast(broken);
+  REQUIRE(builder_type::is_parse_error(error));
+  CHECK(std::get<builder_type::parse_error>(error).error_location.get().is_error());
+
+  // a definition is not an expression
+  const auto definition = parser.parse("auto x{ 1 }");
+  const auto not_expression = builder.build_expression(definition);
+  REQUIRE(builder_type::is_parse_error(not_expression));
+  CHECK(std::get<builder_type::parse_error>(not_expression).error_location.get().item.match == "auto");
+}
+
+TEST_CASE("The AST builder decodes string literals into an arena it owns")
+{
+  std::string function = "auto f(auto x) {\n if (x) {\n";
+  for (int line = 0; line < 2000; ++line) {
+    const auto id = std::to_string(line);
+    function += "  print(\"plain " + id + "\", \"tab\\t" + id + "\\x21 \\\"quoted\\\"\");\n";
+  }
+  function += " }\n}\n";
+
+  using builder_type = thing::ast::basic_ast_builder<std::vector>;
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto tree = parser.parse(function);
+  builder_type builder;
+  REQUIRE(!builder_type::is_parse_error(builder.build_function_ast(tree)));
+
+  const auto literals = builder.nodes.all<builder_type::literal_value>();
+  REQUIRE(literals.size() == 4000);
+  const auto in_source = [&function](const std::string_view text) {
+    return text.data() >= function.data() && text.data() + text.size() <= function.data() + function.size();
+  };
+  for (std::size_t line = 0; line < 2000; ++line) {
+    const auto id = std::to_string(line);
+    const auto &plain = literals[2 * line];
+    const auto &escaped = literals[2 * line + 1];
+    CHECK(plain.text == "plain " + id);
+    CHECK(in_source(plain.text));
+    CHECK(escaped.text == "tab\t" + id + "! \"quoted\"");
+    CHECK_FALSE(in_source(escaped.text));
+  }
+  // the decoded values share a few blocks rather than an allocation each
+  CHECK(builder.strings.blocks.size() < 4);
+
+  const auto call = parser.parse(R"(print("\q"))");
+  const auto invalid = builder.build_expression(call);
+  REQUIRE(builder_type::is_parse_error(invalid));
+  CHECK(std::get<builder_type::parse_error>(invalid).error_location.get().item.match == R"("\q")");
+}
+
+TEST_CASE("Parse nodes keep every member when copied or moved with an allocator")
+{
+  constexpr std::string_view str = "f(1, 2) + (3 * 0b2";
+
+  std::pmr::monotonic_buffer_resource first;
+  std::pmr::monotonic_buffer_resource second;
+  thing::parsing::pmr_parser parser{ &first };
+  const auto original = parser.parse(str);
+
+  const auto uses = [](const auto &self, const auto &node, std::pmr::memory_resource *resource) -> bool {
+    if (node.get_allocator().resource() != resource) { return false; }
+    return std::all_of(node.children.begin(), node.children.end(), [&](const auto &child) {
+      return self(self, child, resource);
+    });
+  };
+  REQUIRE(uses(uses, original, &first));
+
+  thing::parsing::pmr_parser::parse_node copy{ original, &second };
+  CHECK(same_tree(copy, original));
+  CHECK(uses(uses, copy, &second));
+
+  thing::parsing::pmr_parser::parse_node plain_copy{ original };
+  CHECK(same_tree(plain_copy, original));
+
+  const thing::parsing::pmr_parser::parse_node moved{ std::move(copy), &first };
+  CHECK(same_tree(moved, original));
+  CHECK(uses(uses, moved, &first));
+}
+
+TEST_CASE("pmr parses take all of their memory from the arena")
+{
+  const std::array<std::string_view, 3> scripts{ "auto x{ (15 / 2) + (((3 * x) - 1) / 2) }",
+    R"(if (true) { print("Hello \"World\"", 1.5e3); } else { f(x)(y){ z }; })",
+    "while (x > y && y != 5) { x = x - 1; }" };
+
+  // fails with bad_alloc if anything outgrows the arena's buffer
+  thing::parsing::parse_arena arena{ 64 * 1024, std::pmr::null_memory_resource() };
+
+  for (int iteration = 0; iteration < 1000; ++iteration) {
+    const auto script = scripts[static_cast<std::size_t>(iteration) % scripts.size()];
+    {
+      thing::parsing::basic_parser<std::vector> reference_parser;
+      const auto reference = reference_parser.parse(script);
+
+      thing::parsing::pmr_parser parser{ arena.allocator() };
+      CHECK(same_tree(parser.parse(script), reference));
+
+      const auto tokens = thing::lexing::tokenize<std::pmr::vector>(script, arena.allocator());
+      CHECK(same_tree(parser.parse(tokens), reference));
+
+      thing::parsing::basic_flat_parser<std::pmr::vector> flat_parser{ arena.allocator() };
+      CHECK(same_tree(flat_parser.parse(script).root(), reference));
+    }
+    arena.reset();
+  }
+}
+
+TEST_CASE("small_vector keeps its first elements inline and spills into its allocator")
+{
+  std::array<std::byte, 4096> buffer{};
+  std::pmr::monotonic_buffer_resource resource{ buffer.data(), buffer.size(), std::pmr::null_memory_resource() };
+
+  using strings = thing::small_vector<std::pmr::string, 2, std::pmr::polymorphic_allocator<std::pmr::string>>;
+  strings values{ &resource };
+  values.emplace_back(40, 'a');
+  values.emplace_back(40, 'b');
+  CHECK(values.is_inline());
+  CHECK(values.capacity() == 2);
+
+  values.emplace_back(40, 'c');
+  CHECK_FALSE(values.is_inline());
+  CHECK(values.capacity() >= 3);
+  // the elements are constructed with the allocator, wherever they are
+  for (const auto &value : values) { CHECK(value.get_allocator().resource() == &resource); }
+
+  values.erase(values.begin());
+  REQUIRE(values.size() == 2);
+  CHECK(values.front() == std::string_view{ std::string(40, 'b') });
+  CHECK(values.back() == std::string_view{ std::string(40, 'c') });
+
+  const strings copy{ values, &resource };
+  strings moved{ std::move(values) };
+  CHECK(moved == copy);
+  CHECK(values.empty());
+
+  thing::small_vector<int, 4> small{ 1, 2 };
+  auto other = std::move(small);
+  CHECK(other.is_inline());
+  CHECK(other == thing::small_vector<int, 4>{ 1, 2 });
+
+  moved.assign(3, moved[1]);
+  REQUIRE(moved.size() == 3);
+  CHECK(moved[0] == std::string_view{ std::string(40, 'c') });
+  CHECK(moved[2] == std::string_view{ std::string(40, 'c') });
+}
+
+TEST_CASE("small_vector_2 serves as the Container_Type of a flat parser and an AST builder")
+{
+  constexpr std::string_view function = "auto f(auto x, auto y) { if (x < y) { while (x < y) { g(x, 1)(y); } }"
+                                        " else { \"s\"; } }";
+
+  thing::parsing::basic_flat_parser<std::vector> reference_parser;
+  const auto reference = reference_parser.parse(function);
+
+  thing::parsing::basic_flat_parser<thing::small_vector_2> parser;
+  const auto tree = parser.parse(thing::lexing::tokenize<thing::small_vector_2>(function));
+  REQUIRE(tree.size() == reference.size());
+  for (std::size_t index = 0; index < tree.size(); ++index) {
+    CHECK(tree[index].type == reference[index].type);
+    CHECK(tree[index].subtree_end == reference[index].subtree_end);
+  }
+
+  using tree_type = thing::parsing::basic_flat_parse_tree<thing::small_vector_2>;
+  using builder_type = thing::ast::basic_ast_builder<thing::small_vector_2, tree_type::node_view>;
+  builder_type builder;
+  const auto built = builder.build_function_ast(tree.root());
+  REQUIRE(!builder_type::is_parse_error(built));
+  CHECK(builder.nodes[node_of<builder_type::function_definition>(builder, built).parameters].size() == 2);
+}
+
+TEST_CASE("AST builders keep their scratch lists in the builder's memory")
+{
+  // more parameters and arguments than the lists keep inline
+  constexpr std::string_view function =
+    "auto f(auto a, auto b, auto c, auto d, auto e, auto g) { h(1, 2, 3, 4, 5, 6, 7, 8, 9, 10) }";
+
+  thing::parsing::parse_arena arena{ 64 * 1024, std::pmr::null_memory_resource() };
+  thing::parsing::pmr_parser parser{ arena.allocator() };
+  const auto tree = parser.parse(function);
+
+  using builder_type = thing::ast::basic_ast_builder<std::pmr::vector>;
+  builder_type builder{ arena.allocator() };
+  CHECK(builder.scratch_list<builder_type::expression, 8>().get_allocator().resource() == &arena.resource);
+  CHECK(builder.scratch_list<builder_type::node_reference, 4>().get_allocator().resource() == &arena.resource);
+
+  const auto built = builder.build_function_ast(tree);
+  REQUIRE(!builder_type::is_parse_error(built));
+  const auto &definition = node_of<builder_type::function_definition>(builder, built);
+  CHECK(builder.nodes[definition.parameters].size() == 6);
+}
+
+namespace {
+// An allocator that follows the vector it is copied into, and whose copies
+// compare equal only when they come from the same `id`
+template<typename Type> struct tagged_allocator
+{
+  using value_type = Type;
+  using propagate_on_container_copy_assignment = std::true_type;
+
+  int id{ 0 };
+
+  tagged_allocator() = default;
+  explicit tagged_allocator(const int id_) : id{ id_ } {}
+  template<typename Other> explicit tagged_allocator(const tagged_allocator<Other> &other) : id{ other.id } {}
+
+  [[nodiscard]] Type *allocate(const std::size_t n) { return std::allocator<Type>{}.allocate(n); }
+  void deallocate(Type *const pointer, const std::size_t n) { std::allocator<Type>{}.deallocate(pointer, n); }
+
+  [[nodiscard]] bool operator==(const tagged_allocator &) const = default;
+};
+
+struct throwing_move
+{
+  throwing_move() = default;
+  throwing_move(const throwing_move &) = default;
+  throwing_move(throwing_move &&) noexcept(false) {}
+  throwing_move &operator=(const throwing_move &) = default;
+  throwing_move &operator=(throwing_move &&) noexcept(false) { return *this; }
+  ~throwing_move() = default;
+};
+}// namespace
+
+TEST_CASE("small_vector can push back its own elements and propagates its allocator")
+{
+  // growing must not free the element being copied
+  thing::small_vector<std::string, 2> values{ std::string(40, 'a'), std::string(40, 'b') };
+  values.push_back(values[0]);
+  values.push_back(values[1]);
+  values.push_back(values[2]);
+  CHECK(values.size() == 5);
+  REQUIRE(values.capacity() == 8);
+  values.resize(8);
+  values.push_back(values[4]);
+  CHECK(values[0] == std::string(40, 'a'));
+  CHECK(values[3] == std::string(40, 'b'));
+  CHECK(values[4] == std::string(40, 'a'));
+  CHECK(values[8] == std::string(40, 'a'));
+
+  using tagged = thing::small_vector<int, 1, tagged_allocator<int>>;
+  const tagged source({ 1, 2, 3 }, tagged_allocator<int>{ 1 });
+  tagged target({ 4, 5, 6, 7 }, tagged_allocator<int>{ 2 });
+  target = source;
+  CHECK(target.get_allocator().id == 1);
+  CHECK(target == source);
+
+  static_assert(std::is_nothrow_move_constructible_v<thing::small_vector<int, 2>>);
+  static_assert(!std::is_nothrow_move_constructible_v<thing::small_vector<throwing_move, 2>>);
+}
+
+TEST_CASE("Identifiers are interned into dense symbol ids")
+{
+  namespace symbols = thing::lexing::symbols;
+
+  // built from pieces so that equal names do not share storage
+  const std::string first = std::string{ "val" } + "ue";
+  const std::string second = std::string{ "va" } + "lue";
+
+  thing::lexing::basic_symbol_table<std::vector> table;
+  const auto initial_size = table.size();
+  const auto value = table.intern(first);
+
+  CHECK(value == initial_size);
+  CHECK(table.intern(second) == value);
+  CHECK(table.find(second) == value);
+  CHECK(table.find("other") == symbols::none);
+  CHECK(table.intern("else") == symbols::else_);
+  CHECK(table.name(value) == "value");
+
+  // survives growing the hash table
+  std::vector<std::string> names;
+  for (int index = 0; index < 1000; ++index) { names.push_back("name" + std::to_string(index)); }
+  for (const auto &name : names) { table.intern(name); }
+  CHECK(table.size() == initial_size + 1 + names.size());
+  for (std::size_t index = 0; index < names.size(); ++index) {
+    CHECK(table.find(names[index]) == initial_size + 1 + index);
+  }
+
+  const auto tokens = thing::lexing::tokenize("auto x = y; while (x) { x = y; }");
+  CHECK(tokens[0].symbol == symbols::auto_);
+  CHECK(tokens[1].symbol == tokens[7].symbol);
+  CHECK(tokens[1].symbol == tokens[10].symbol);
+  CHECK(tokens[3].symbol == tokens[12].symbol);
+  CHECK(tokens[1].symbol != tokens[3].symbol);
+  CHECK(tokens[5].symbol == symbols::while_);
+  CHECK(tokens[2].symbol == symbols::none);
+}
+
+namespace {
+// compares an incrementally maintained buffer with a full tokenize of its source
+template<typename Buffer> void check_same_tokens(const Buffer &incremental)
+{
+  const auto expected = thing::lexing::tokenize(incremental.source);
+
+  REQUIRE(incremental.size() == expected.size());
+  for (std::size_t index = 0; index < expected.size(); ++index) {
+    REQUIRE(incremental.types[index] == expected.types[index]);
+    REQUIRE(incremental.offsets[index] == expected.offsets[index]);
+    REQUIRE(incremental.lengths[index] == expected.lengths[index]);
+    if (incremental.types[index] == thing::lexing::token_type::identifier) {
+      // ids depend on the editing history, but must still map one to one to names
+      REQUIRE(incremental.symbols.name(incremental.symbol_ids[index]) == incremental.match(index));
+      REQUIRE(incremental.symbols.find(incremental.match(index)) == incremental.symbol_ids[index]);
+    } else if (incremental.types[index] == thing::lexing::token_type::number) {
+      // values are stored in the order they were lexed in
+      REQUIRE(incremental[index].number == expected[index].number);
+    } else {
+      REQUIRE(incremental.symbol_ids[index] == expected.symbol_ids[index]);
+    }
+  }
+}
+}// namespace
+
+TEST_CASE("Relexing an edit matches lexing the edited buffer")
+{
+  const std::string original = "auto func(auto x, auto y) {\n  if (x >= 1.5) { print(\"a \\\" b\", y); }\n}\n";
+
+  struct test_edit
+  {
+    std::size_t offset;
+    std::size_t removed;
+    std::string_view inserted;
+  };
+
+  const auto edits = GENERATE(test_edit{ 0, 0, "x" },
+    test_edit{ 6, 0, "c" },// inside an identifier
+    test_edit{ 4, 1, "" },// joins two tokens
+    test_edit{ 7, 0, " " },// splits a token
+    test_edit{ 54, 0, "x" },// inside a string literal
+    test_edit{ 65, 0, "\"" },// opens a string that is never closed
+    test_edit{ 55, 1, "" },// removes the escape, so the string ends early
+    test_edit{ 42, 0, "e" },// a token that only ends the number
+    test_edit{ 42, 0, "e3" },// extends the number with an exponent
+    test_edit{ 10, 50, "" },
+    test_edit{ 70, 0, "z" });
+
+  std::string edited = original;
+  edited.replace(edits.offset, edits.removed, edits.inserted);
+
+  auto tokens = thing::lexing::tokenize(original);
+  const auto result = thing::lexing::relex(tokens, edited, { edits.offset, edits.removed, edits.inserted });
+
+  check_same_tokens(tokens);
+  CHECK(result.first + result.inserted <= tokens.size());
+}
+
+TEST_CASE("Relexing a sequence of random edits matches lexing the edited buffer")
+{
+  std::mt19937 random{ 42 };
+  const auto pick = [&](const std::size_t limit) {
+    return std::uniform_int_distribution<std::size_t>{ 0, limit }(random);
+  };
+
+  constexpr std::string_view alphabet = "ab_9.e\" \\\n+=(){};";
+
+  // two buffers, so that the source of the old tokens stays alive until relex
+  std::string current = "auto value{ \"text\\\"\" };\nif (value >= 1.5e3) { call(value, 0x10); }\n";
+  std::string next;
+  auto tokens = thing::lexing::tokenize(current);
+
+  for (int iteration = 0; iteration < 2000; ++iteration) {
+    const auto offset = pick(current.size());
+    const auto removed = std::min(pick(3), current.size() - offset);
+    std::string inserted;
+    for (auto count = pick(3); count > 0; --count) { inserted += alphabet[pick(alphabet.size() - 1)]; }
+
+    next = current;
+    next.replace(offset, removed, inserted);
+
+    const auto edit =
+      thing::lexing::text_edit{ offset, removed, std::string_view{ next }.substr(offset, inserted.size()) };
+    static_cast<void>(thing::lexing::relex(tokens, next, edit));
+    std::swap(current, next);
+
+    check_same_tokens(tokens);
+  }
+}
+
+TEST_CASE("Reparsing an edit inside a statement only replaces that statement")
+{
+  const std::string original = "if (true) {\n  value + 1;\n  while (x) { y; { z; } }\n  a + b;\n  (c);\n}\n";
+  const auto offset = original.find("a + b");
+  std::string edited = original;
+  edited.insert(offset, "q");
+
+  auto tokens = thing::lexing::tokenize(original);
+  thing::parsing::basic_parser<std::vector> parser;
+  auto tree = parser.parse(tokens);
+
+  auto &block = tree.children[1];
+  const auto *kept_before = &block.children[0].children[0];
+  const auto *kept_after = &block.children[3];
+
+  const auto result = thing::parsing::reparse(parser, tree, tokens, edited, { offset, 0, "q" });
+
+  CHECK(!result.whole_script);
+  CHECK(result.block == &block);
+  CHECK(result.first + result.removed < block.children.size());
+  CHECK(result.removed == result.inserted);
+  CHECK(same_tree(tree, parser.parse(tokens)));
+  CHECK(block.children[2].children[0].item.match == "qa");
+
+  // the statements around the edit are the same nodes, pointing at the new source
+  CHECK(&block.children[0].children[0] == kept_before);
+  CHECK(&block.children[3] == kept_after);
+  CHECK(kept_after->item.match.data() == edited.data() + edited.find("c);"));
+
+  // kept statements after an edit that changes their count move to the index
+  // that reparsed_statements gives them
+  const auto split = edited.find("qa + b;") + 1;
+  auto resplit = edited;
+  resplit.insert(split, ";");
+  const auto kept_index = result.first + result.inserted;
+  REQUIRE(block.children[kept_index].item.match == "c");
+  const auto second = thing::parsing::reparse(parser, tree, tokens, resplit, { split, 0, ";" });
+  REQUIRE(second.block == &block);
+  CHECK(second.inserted == second.removed + 1);
+  CHECK(same_tree(tree, parser.parse(tokens)));
+  CHECK(block.children[kept_index - second.removed + second.inserted].item.match == "c");
+}
+
+TEST_CASE("Reparsing a sequence of random edits matches parsing the edited buffer")
+{
+  std::mt19937 random{ 42 };
+  const auto pick = [&](const std::size_t limit) {
+    return std::uniform_int_distribution<std::size_t>{ 0, limit }(random);
+  };
+
+  constexpr std::string_view alphabet = "ab9 ;{}()+";
+
+  const std::string original =
+    "if (true) {\n  value + 1;\n  while (x) { y; { z; } }\n  a + b;\n  if (value >= 1.5e3) { call(value, 0x10); }\n}\n";
+  std::string current;
+  std::string next;
+  thing::parsing::basic_parser<std::vector> parser;
+
+  for (int script = 0; script < 50; ++script) {
+    current = original;
+    auto tokens = thing::lexing::tokenize(current);
+    auto tree = parser.parse(tokens);
+
+    for (int iteration = 0; iteration < 40; ++iteration) {
+      const auto offset = pick(current.size());
+      const auto removed = std::min(pick(2), current.size() - offset);
+      std::string inserted;
+      for (auto count = pick(2); count > 0; --count) { inserted += alphabet[pick(alphabet.size() - 1)]; }
+
+      next = current;
+      next.replace(offset, removed, inserted);
+
+      // the tree is found in the old source, so it stays alive until reparse returns
+      const auto edit =
+        thing::lexing::text_edit{ offset, removed, std::string_view{ next }.substr(offset, inserted.size()) };
+      const auto result = thing::parsing::reparse(parser, tree, tokens, next, edit);
+      std::swap(current, next);
+
+      REQUIRE(same_tree(tree, parser.parse(tokens)));
+      if (result.block != nullptr) { CHECK(result.first + result.inserted <= result.block->children.size()); }
+    }
+  }
+
+  // and in place, where only the nodes from the edit on are visited
+  for (int script = 0; script < 50; ++script) {
+    current = original;
+    // never reallocated, which would move the old text
+    current.reserve(original.size() * 4);
+    auto tokens = thing::lexing::tokenize(current);
+    auto tree = parser.parse(tokens);
+
+    for (int iteration = 0; iteration < 40 && current.size() < original.size() * 3; ++iteration) {
+      const auto offset = pick(current.size());
+      const auto removed = std::min(pick(2), current.size() - offset);
+      std::string inserted;
+      for (auto count = pick(2); count > 0; --count) { inserted += alphabet[pick(alphabet.size() - 1)]; }
+
+      current.replace(offset, removed, inserted);
+      static_cast<void>(thing::parsing::reparse(parser, tree, tokens, current, { offset, removed, inserted }));
+
+      REQUIRE(same_tree(tree, parser.parse(tokens)));
+    }
+  }
+}
+
+TEST_CASE("Parallel tokenize produces the same buffer as sequential tokenize")
+{
+  // string literals spanning lines, so that some chunks start inside one
+  std::string script;
+  for (int block = 0; script.size() < 1024 * 1024; ++block) {
+    script += "auto value_" + std::to_string(block) + "{ 1.5e3 * x };\n";
+    script += "print(\"first line\n  second line \\\" still inside\n\", value_" + std::to_string(block % 7) + ");\n";
+  }
+
+  const auto trailing_unknown = script + "x = 1; \\ everything after this is one unknown token\n" + script;
+
+  for (const auto &source : { script, trailing_unknown }) {
+    const auto expected = thing::lexing::tokenize(source);
+    for (const auto threads : { 1, 2, 3, 7, 16 }) {
+      const auto tokens = thing::lexing::parallel_tokenize(source, static_cast<std::size_t>(threads));
+      REQUIRE(tokens.size() == expected.size());
+      CHECK(tokens.types == expected.types);
+      CHECK(tokens.offsets == expected.offsets);
+      CHECK(tokens.lengths == expected.lengths);
+      CHECK(tokens.symbol_ids == expected.symbol_ids);
+      CHECK(tokens.symbols.names == expected.symbols.names);
+      CHECK(tokens.numbers == expected.numbers);
+    }
+  }
+}
+
+TEST_CASE("Long operator chains keep every operand")
+{
+  constexpr std::size_t terms = 10000;
+  std::string expression = "a0";
+  for (std::size_t term = 1; term < terms; ++term) { expression += " - a" + std::to_string(term); }
+
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto result = parser.parse(expression);
+
+  // left associative, so the chain nests down the first child
+  const thing::parsing::basic_parser<std::vector>::parse_node *node = &result;
+  for (std::size_t term = terms - 1; term > 0; --term) {
+    REQUIRE(node->item.type == thing::lexing::token_type::minus);
+    REQUIRE(node->children.size() == 2);
+    REQUIRE(node->children[1].item.match == "a" + std::to_string(term));
+    node = &node->children[0];
+  }
+  CHECK(node->item.match == "a0");
+}
+
+namespace {
+// the number of nodes with `error`, and the depth of the tree, without
+// recursing into it
+template<typename Node>
+std::pair<std::size_t, std::size_t> count_errors(const Node &root, const thing::parsing::error_type error)
+{
+  std::size_t errors = 0;
+  std::size_t depth = 0;
+  std::vector<std::pair<const Node *, std::size_t>> pending{ { &root, 1 } };
+  while (!pending.empty()) {
+    const auto [node, level] = pending.back();
+    pending.pop_back();
+    if (node->error == error) { ++errors; }
+    depth = std::max(depth, level);
+    for (const auto &child : node->children) { pending.emplace_back(&child, level + 1); }
+  }
+  return { errors, depth };
+}
+
+// the error nodes of a tree, in preorder
+template<typename Node> void collect_errors(const Node &root, std::vector<const Node *> &errors)
+{
+  if (root.is_error()) { errors.push_back(&root); }
+  for (const auto &child : root.children) { collect_errors(child, errors); }
+}
+
+template<typename Node> bool has_errors(const Node &root)
+{
+  std::vector<const Node *> pending{ &root };
+  while (!pending.empty()) {
+    const auto *node = pending.back();
+    pending.pop_back();
+    if (node->is_error()) { return true; }
+    for (const auto &child : node->children) { pending.push_back(&child); }
+  }
+  return false;
+}
+}// namespace
+
+TEST_CASE("Deeply nested input produces an error node instead of overflowing the stack")
+{
+  constexpr std::size_t levels = 100000;
+  using parser_type = thing::parsing::basic_parser<std::vector>;
+  const auto too_deep = thing::parsing::error_type::nesting_too_deep;
+
+  const std::array<std::string, 4> scripts{ std::string(levels, '(') + "x" + std::string(levels, ')'),
+    "if (true) " + std::string(levels, '{') + "x;" + std::string(levels, '}'),
+    "f(" + std::string(levels, '(') + "x" + std::string(levels, ')') + ", y)",
+    [] {
+      std::string prefixes;
+      for (std::size_t level = 0; level < levels; ++level) { prefixes += "- "; }
+      return prefixes + "x";
+    }() };
+
+  for (const auto &script : scripts) {
+    parser_type parser;
+    const auto result = parser.parse(script);
+    const auto [errors, depth] = count_errors(result, too_deep);
+    CHECK(errors == 1);
+    // the rest of the nested construct is skipped, rather than nesting the tree
+    CHECK(depth <= 2 * parser_type::default_max_nesting);
+  }
+
+  // parsing goes on after the construct that was too deep
+  parser_type parser;
+  const auto call = parser.parse(scripts[2]);
+  REQUIRE(call.children.size() == 1);
+  REQUIRE(call.children[0].children.size() == 2);
+  CHECK(call.children[0].children[0].error == too_deep);
+  CHECK(call.children[0].children[1].item.match == "y");
+}
+
+TEST_CASE("The nesting limit is configurable")
+{
+  constexpr std::string_view script = "if (a) { b; ((((x)))); { { { c; } } } d; }";
+  const auto too_deep = thing::parsing::error_type::nesting_too_deep;
+
+  thing::parsing::basic_parser<std::vector> unlimited;
+  const auto expected = unlimited.parse(script);
+  CHECK(count_errors(expected, too_deep).first == 0);
+
+  thing::parsing::basic_parser<std::vector> limited;
+  limited.max_nesting = 4;
+  const auto result = limited.parse(script);
+  CHECK(count_errors(result, too_deep).first == 2);
+
+  // only the constructs that are too deep are replaced
+  const auto &body = result.children[1].children;
+  REQUIRE(body.size() == 4);
+  CHECK(body[0].item.match == "b");
+  CHECK(body[1].error == too_deep);
+  CHECK(body[2].children[0].children[0].error == too_deep);
+  CHECK(body[3].item.match == "d");
+
+  // the same parser parses input within the limit as before
+  const auto shallow = limited.parse("(((x)))");
+  CHECK(shallow.item.match == "x");
+  CHECK(!shallow.is_error());
+}
+
+TEST_CASE("Top-level definitions end where their brackets balance")
+{
+  const auto tokens = thing::lexing::tokenize(
+    "auto f(auto x) { while (x) { y; } }\nauto g(auto y) { y };\nauto v{ 1 };\nauto h(auto z) { (z }\nauto i{ 2 }");
+
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto definitions = parser.parse_definitions(tokens);
+  REQUIRE(definitions.size() == 5);
+  CHECK(definitions[0].children[0].item.match == "f");
+  CHECK(definitions[1].children[0].item.match == "g");
+  CHECK(definitions[2].children[0].item.match == "v");
+  for (std::size_t index = 0; index < 3; ++index) { CHECK(!has_errors(definitions[index])); }
+  // the unclosed parenthesis takes the rest of the script into its definition,
+  // but the parser recovers from it and parses what follows on its own
+  CHECK(definitions[3].children[0].item.match == "h");
+  CHECK(has_errors(definitions[3]));
+  CHECK(definitions[4].children[0].item.match == "i");
+  CHECK(!has_errors(definitions[4]));
+}
+
+TEST_CASE("The parser recovers from an error at the next `;` or `}` and reports every error")
+{
+  constexpr std::string_view script = R"(
+auto f(auto x) {
+  if (x) {
+    a b c;
+    d;
+    g(1, 2;
+    h(x +);
+    (x y);
+    auto v{ 1 2 };
+    if (x) { k; } auto w{ 3 };
+    m
+  }
+}
+auto g{ 4 };
+)";
+
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto definitions = parser.parse_definitions(thing::lexing::tokenize(script));
+  REQUIRE(definitions.size() == 2);
+  CHECK(!has_errors(definitions[1]));
+
+  // one error for each mistake, at the token found in place of what was expected
+  using parse_node = thing::parsing::basic_parse_node<std::vector>;
+  std::vector<const parse_node *> errors;
+  collect_errors(definitions[0], errors);
+  using thing::lexing::token_type;
+  using thing::parsing::error_type;
+  const std::array<std::tuple<std::string_view, error_type, token_type>, 6> expected{ {
+    { "b", error_type::wrong_token_type, token_type::semicolon },
+    { ";", error_type::wrong_token_type, token_type::right_paren },
+    { ")", error_type::unexpected_prefix_token, token_type{} },
+    { "y", error_type::wrong_token_type, token_type::right_paren },
+    { "2", error_type::wrong_token_type, token_type::right_brace },
+    { "}", error_type::wrong_token_type, token_type::semicolon },
+  } };
+  REQUIRE(errors.size() == expected.size());
+  for (std::size_t index = 0; index < errors.size(); ++index) {
+    CHECK(errors[index]->item.match == std::get<0>(expected[index]));
+    CHECK(errors[index]->error == std::get<1>(expected[index]));
+    CHECK(errors[index]->expected_token == std::get<2>(expected[index]));
+  }
+
+  // and every statement after a mistake is still there
+  const auto &body = definitions[0].children[0].children[1].children[0].children[1];
+  REQUIRE(body.children.size() == 9);
+  CHECK(body.children[1].item.match == "d");
+  CHECK(body.children[6].item.match == "if");
+  CHECK(body.children[7].children[0].item.match == "w");
+  CHECK(!has_errors(body.children[7]));
+  CHECK(body.children[8].item.match == "m");
+}
+
+TEST_CASE("Parallel parsing of definitions produces the same trees as a sequential parse")
+{
+  std::string script;
+  for (int definition = 0; script.size() < 2 * 1024 * 1024; ++definition) {
+    const auto id = std::to_string(definition);
+    script += "auto function_" + id + "(auto x, auto y) {\n";
+    script += "  while (x > y && y != " + id + ") { print(\"Hello \\\"World\\\"\", x); { x - 1; } }\n}\n";
+    // errors, some of which leave brackets unbalanced across definitions
+    if (definition % 97 == 0) { script += "auto broken_" + id + "(auto x) { x; }\n"; }
+    if (definition % 211 == 0) { script += "auto open_" + id + "(auto x { (x }\n"; }
+    if (definition % 307 == 0) { script += ") } ;\n"; }
+  }
+
+  const auto tokens = thing::lexing::tokenize(script);
+
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto expected = parser.parse_definitions(tokens);
+  CHECK(expected.size() > 10000);
+
+  thing::parsing::basic_flat_parser<std::vector> flat_parser;
+  for (const auto threads : { 1, 2, 3, 7, 16 }) {
+    const auto definitions =
+      thing::parsing::parallel_parse_definitions(parser, tokens, static_cast<std::size_t>(threads));
+    REQUIRE(definitions.size() == expected.size());
+    for (std::size_t index = 0; index < definitions.size(); ++index) {
+      REQUIRE(same_tree(definitions[index], expected[index]));
+    }
+
+    const auto trees =
+      thing::parsing::parallel_parse_definitions(flat_parser, tokens, static_cast<std::size_t>(threads));
+    REQUIRE(trees.size() == expected.size());
+    for (std::size_t index = 0; index < trees.size(); ++index) {
+      REQUIRE(same_tree(trees[index].root(), expected[index]));
+    }
+  }
+}
+
+TEST_CASE("Pipelined parsing of definitions produces the same trees as a sequential parse")
+{
+  std::string script;
+  for (int definition = 0; definition < 2000; ++definition) {
+    const auto id = std::to_string(definition);
+    script += "auto function_" + id + "(auto x, auto y) {\n";
+    script += "  while (x > y && y != " + id + ") { print(\"Hello\", x); { x - 1; } }\n};\n";
+    script += "auto value_" + id + "{ " + id + " * 2.5 }; value_" + id + " + 1;\n";
+    if (definition % 97 == 0) { script += "auto broken_" + id + "(auto x) { x; }\n"; }
+    if (definition % 307 == 0) { script += ") } ; }\n"; }
+  }
+  // ends inside a definition whose brackets never balance
+  script += "auto open(auto x { (x }\n";
+
+  const auto tokens = thing::lexing::tokenize(script);
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto expected = parser.parse_definitions(tokens);
+
+  const auto check = [&](auto pipeline) {
+    std::vector<thing::parsing::basic_parse_node<std::vector>> definitions;
+    const auto symbols = pipeline([&](auto &&definition) { definitions.push_back(std::move(definition)); });
+    REQUIRE(definitions.size() == expected.size());
+    for (std::size_t index = 0; index < definitions.size(); ++index) {
+      REQUIRE(same_tree(definitions[index], expected[index]));
+    }
+    CHECK(symbols.names == tokens.symbols.names);
+  };
+
+  // every definition in a chunk of its own, and the stages waiting on each other
+  for (const std::size_t chunk_tokens : { 1u, 7u, 1000u, 16u * 1024 }) {
+    check([&](auto &&lower) {
+      return thing::parsing::pipelined_parse_definitions<1>(parser, script, lower, chunk_tokens);
+    });
+  }
+  check([&](auto &&lower) { return thing::parsing::pipelined_parse_definitions(parser, script, lower, 50); });
+
+  std::vector<thing::parsing::basic_parse_node<std::vector>> none;
+  CHECK(thing::parsing::pipelined_parse_definitions(parser, "", [&](auto &&definition) {
+    none.push_back(std::move(definition));
+  }).size() == thing::lexing::first_identifier);
+  CHECK(none.empty());
+
+  // a failing stage stops the others
+  std::size_t lowered = 0;
+  const auto fail = [&](auto &&) {
+    if (++lowered == 100) { throw std::runtime_error{ "lowering failed" }; }
+  };
+  CHECK_THROWS_AS(thing::parsing::pipelined_parse_definitions<2>(parser, script, fail, 10), std::runtime_error);
+  CHECK(lowered == 100);
+}
+
+TEST_CASE("Lazily parsed function bodies produce the same trees as parsing them up front")
+{
+  std::string script;
+  for (int definition = 0; definition < 200; ++definition) {
+    const auto id = std::to_string(definition);
+    script += "auto function_" + id + "(auto x, auto y) {\n";
+    script += "  if (x > y) { auto v{ x * " + id + " }; print(\"Hello\", v); g(y); }\n}\n";
+    script += "auto value_" + id + "{ " + id + " };\n";
+    if (definition % 37 == 0) { script += "auto broken_" + id + "(auto x) { x; }\n"; }
+  }
+
+  const auto tokens = thing::lexing::tokenize(script);
+  thing::parsing::basic_parser<std::vector> parser;
+  const auto expected = parser.parse_definitions(tokens);
+
+  thing::parsing::basic_lazy_definitions<std::vector> lazy{ tokens };
+  REQUIRE(lazy.size() == 406);
+  CHECK(lazy.is_function(0));
+  CHECK_FALSE(lazy.is_parsed(0));
+  CHECK(lazy.name(0) == "function_0");
+  CHECK_FALSE(lazy.is_function(1));
+  CHECK(lazy.is_parsed(1));
+
+  // only the signature of a function is parsed up front
+  const auto function = lazy.find("function_150");
+  REQUIRE(function != lazy.npos);
+  const auto &signature = lazy.signature(function);
+  CHECK(signature.children[0].item.match == "function_150");
+  REQUIRE(signature.children[0].children.size() == 1);
+  CHECK(signature.children[0].children[0].children.size() == 2);
+  CHECK_FALSE(lazy.is_parsed(function));
+
+  const auto &body = lazy.definition(function).children[0].children[1];
+  CHECK(body.item.type == thing::lexing::token_type::left_brace);
+  CHECK(lazy.is_parsed(function));
+  CHECK(lazy.find("missing") == lazy.npos);
+
+  // as is its AST, the first time it is asked for
+  using ast_builder = thing::ast::basic_ast_builder<std::vector>;
+  using function_handle = thing::handle<ast_builder::function_definition>;
+  const auto other = lazy.find("function_151");
+  ast_builder builder;
+  CHECK_FALSE(lazy.is_built(other));
+  const auto ast = lazy.function_ast(other, builder);
+  REQUIRE(std::holds_alternative<function_handle>(ast));
+  CHECK(lazy.is_parsed(other));
+  CHECK(lazy.is_built(other));
+  CHECK(builder.nodes[std::get<function_handle>(ast)].name.match == "function_151");
+  const auto built = builder.nodes.all<ast_builder::function_definition>().size();
+  const auto again = lazy.function_ast(other, builder);
+  REQUIRE(std::holds_alternative<function_handle>(again));
+  CHECK(std::get<function_handle>(again) == std::get<function_handle>(ast));
+  CHECK(builder.nodes.all<ast_builder::function_definition>().size() == built);
+  CHECK(std::holds_alternative<ast_builder::parse_error>(lazy.function_ast(other + 1, builder)));
+  CHECK_FALSE(lazy.is_built(other + 1));
+
+  std::size_t tree = 0;
+  for (std::size_t index = 0; index < lazy.size(); ++index) {
+    for (const auto &parsed : lazy.trees(index)) {
+      REQUIRE(tree < expected.size());
+      REQUIRE(same_tree(parsed, expected[tree++]));
+    }
+  }
+  CHECK(tree == expected.size());
+}
+
+namespace {
+// the facts some consumers need, without a tree
+struct call_counter : thing::parsing::parse_event_handler
+{
+  std::size_t calls{ 0 };
+  std::size_t if_blocks{ 0 };
+  std::size_t errors{ 0 };
+
+  constexpr void leave_node(const thing::parsing::event_node &node)
+  {
+    if (node.item.type == thing::lexing::token_type::identifier
+        && node.last_child_type == thing::lexing::token_type::left_paren) {
+      ++calls;
+    }
+    if (node.item.type == thing::lexing::token_type::keyword && node.item.symbol == thing::lexing::symbols::if_) {
+      ++if_blocks;
+    }
+  }
+
+  constexpr void error(const thing::parsing::event_node &) { ++errors; }
+};
+}// namespace
+
+TEST_CASE("Parse events rebuild the same tree as the tree builder")
+{
+  std::string block = "if (true) {\n";
+  for (int statement = 0; statement < 50; ++statement) {
+    const auto id = std::to_string(statement);
+    block += "  auto value_" + id + "{ (x * 15 + 0xAF12) / -(y - 3.1415e2f)! };\n";
+    block += "  while (x > y && y != " + id + ") { print(\"Hello\"); }\n";
+    block += "  f(x);\n";
+    block += "  if (x) { f(x); } else { g(y); };\n";
+    block += "  g(x);\n";
+  }
+  block += "}\n";
+
+  const std::array<std::string, 8> scripts{ block,
+    "(1 + 2 3",
+    "x{ 1 2 }",
+    "a b c + d",
+    "f(1, 2",
+    "if (x) { print(\"World\" 0b2 ? ; }",
+    "-(((",
+    "" };
+
+  for (const auto &script : scripts) {
+    INFO(script);
+    const auto tokens = thing::lexing::tokenize(script);
+    thing::parsing::basic_parser<std::vector> node_parser;
+    const auto expected = node_parser.parse(tokens);
+
+    thing::parsing::basic_event_parser<std::vector, thing::parsing::basic_node_tree_handler<std::vector>> tree_parser;
+    const auto root = tree_parser.parse(tokens);
+    CHECK(root.item.match.data() == expected.item.match.data());
+    CHECK(same_tree(tree_parser.builder.handler.take_root(), expected));
+
+    thing::parsing::basic_event_parser<std::vector, call_counter> counter;
+    [[maybe_unused]] const auto counted = counter.parse(tokens);
+    CHECK((counter.builder.handler.errors != 0) == has_errors(expected));
+  }
+
+  // a script of any length takes no more than the parser's frames
+  thing::parsing::basic_event_parser<std::vector, call_counter> counter;
+  [[maybe_unused]] const auto counted = counter.parse(thing::lexing::tokenize(block));
+  CHECK(counter.frames.capacity() == counter.initial_frames);
+  CHECK(counter.builder.handler.calls == 250);
+  CHECK(counter.builder.handler.if_blocks == 51);
+  CHECK(counter.builder.handler.errors == 0);
+}
+
+TEST_CASE("Number literals decode the same at runtime as at compile time")
+{
+  // evaluated at compile time, and by the lexer at runtime below
+  constexpr std::array literals{ std::pair{ std::string_view{ "12345" }, thing::lexing::decode_number("12345") },
+    std::pair{ std::string_view{ "0xAF12345" }, thing::lexing::decode_number("0xAF12345") },
+    std::pair{ std::string_view{ "0B2010101" }, thing::lexing::decode_number("0B2010101") },
+    std::pair{ std::string_view{ "9223372036854775807" }, thing::lexing::decode_number("9223372036854775807") },
+    std::pair{ std::string_view{ "9223372036854775808" }, thing::lexing::decode_number("9223372036854775808") },
+    std::pair{ std::string_view{ "123.42E1l" }, thing::lexing::decode_number("123.42E1l") },
+    std::pair{ std::string_view{ "3.1415e2f" }, thing::lexing::decode_number("3.1415e2f") },
+    std::pair{ std::string_view{ "0.000001" }, thing::lexing::decode_number("0.000001") },
+    std::pair{ std::string_view{ "1.5p3" }, thing::lexing::decode_number("1.5p3") },
+    std::pair{ std::string_view{ "1.0e400" }, thing::lexing::decode_number("1.0e400") } };
+
+  for (const auto &[text, expected] : literals) {
+    INFO(text);
+    CHECK(thing::lexing::lexer(text).number == expected);
+  }
+
+  // the runtime path is correctly rounded, whatever the number of digits
+  std::mt19937_64 random{ 7 };
+  for (int iteration = 0; iteration < 1000; ++iteration) {
+    const auto text = std::to_string(random() % 1000000) + "." + std::to_string(random()) + "e"
+                      + std::to_string(random() % 300);
+    CHECK(thing::lexing::lexer(text).number.as_double() == std::strtod(text.c_str(), nullptr));
+  }
+}
+
+TEST_CASE("String literals without escapes are views into the source")
+{
+  thing::lexing::basic_string_arena<std::vector> arena;
+  constexpr std::string_view source{ R"("plain text")" };
+
+  const auto value = thing::lexing::string_value(thing::lexing::lexer(source).match, arena);
+  REQUIRE(value);
+  CHECK(*value == "plain text");
+  CHECK(value->data() == source.data() + 1);
+  CHECK(arena.blocks.empty());
+}
+
+TEST_CASE("String literals with escapes are decoded into the arena")
+{
+  thing::lexing::basic_string_arena<std::vector> arena{ {}, 256 };
+
+  const auto decode = [&](const std::string_view source) {
+    return thing::lexing::string_value(thing::lexing::lexer(source).match, arena);
+  };
+
+  CHECK(decode(R"("a\nb")") == "a\nb");
+  CHECK(decode(R"("\\\"\'")") == R"(\"')");
+  CHECK(decode(R"("tab\there\x41\x7a!")") == "tab\there\x41\x7a!");
+  CHECK(decode(R"("\0")") == std::string_view{ "\0", 1 });
+
+  CHECK(!decode(R"("\q")"));
+  CHECK(!decode(R"("\x4")"));
+  CHECK(!decode(R"("\xg1")"));
+
+  // thousands of literals, but only a few blocks
+  std::string script;
+  for (int index = 0; index < 10000; ++index) { script += R"("line\n")"; }
+
+  thing::lexing::basic_string_arena<std::vector> script_arena{ {}, 256 };
+  for (auto remainder = std::string_view{ script }; !remainder.empty();) {
+    const auto item = thing::lexing::lexer(remainder);
+    const auto value = thing::lexing::string_value(item.match, script_arena);
+    REQUIRE(value == "line\n");
+    remainder = item.remainder;
+  }
+  // every block holds 256 bytes, which is 51 decoded literals
+  CHECK(script_arena.blocks.size() == 10000 / 51 + 1);
+}
+
+TEST_CASE("Line table maps offsets to the same positions as count_to_last")
+{
+  constexpr std::string_view str = "\nauto x{ 1 };\n\n  if (x) {\r\n    call();\n}\nlast line";
+  const thing::basic_line_table<std::vector> lines{ str };
+
+  CHECK(lines.line_count() == 7);
+  CHECK(lines.line(3) == "  if (x) {\r");
+  CHECK(lines.line(6) == "last line");
+
+  for (std::size_t offset = 0; offset <= str.size(); ++offset) {
+    const auto end = std::next(str.begin(), static_cast<std::ptrdiff_t>(offset));
+    const auto [line, location] = thing::count_to_last(str.begin(), end, '\n');
+    const auto line_start =
+      line == 0 ? std::size_t{ 0 } : static_cast<std::size_t>(std::distance(str.begin(), location)) + 1;
+
+    const auto position = lines.position_of(offset);
+    CHECK(position.line == static_cast<std::size_t>(line));
+    CHECK(position.column == offset - line_start);
+  }
+}
+
+namespace {
+std::filesystem::path write_temporary_file(const std::string_view name, const std::string_view contents)
+{
+  const auto path = std::filesystem::temp_directory_path() / name;
+  std::ofstream file{ path, std::ios::binary };
+  file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+  return path;
+}
+}// namespace
+
+TEST_CASE("source_file exposes the file contents without copying")
+{
+  constexpr std::string_view contents = "auto x{ \"mapped\" };\n";
+  const auto path = write_temporary_file("thing_source_file_test.thing", contents);
+
+  thing::source_file file{ path };
+  const auto text = file.text();
+  CHECK(text == contents);
+
+  // tokens point into the mapping, which survives moving the file
+  const auto moved = std::move(file);
+  const auto tokens = thing::lexing::tokenize(moved.text());
+  CHECK(moved.text().data() == text.data());
+  CHECK(tokens.match(3) == "\"mapped\"");
+
+  const auto empty_path = write_temporary_file("thing_source_file_empty.thing", "");
+  CHECK(thing::source_file{ empty_path }.text().empty());
+
+  CHECK_THROWS_AS(thing::source_file{ path.string() + ".missing" }, std::system_error);
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(empty_path);
+}
+
+TEST_CASE("Streaming a file in small windows produces the same tokens as tokenizing it whole")
+{
+  std::string contents;
+  for (int line = 0; line < 200; ++line) {
+    contents += "auto value_" + std::to_string(line) + "{ 1.5e3 + \"text \\\" \" };\n";
+  }
+  // longer than the window, which has to grow for it
+  contents += "print(\"" + std::string(10000, 'x') + "\");\n";
+  const auto path = write_temporary_file("thing_source_stream_test.thing", contents);
+
+  const auto expected = thing::lexing::tokenize(contents);
+
+  thing::source_stream stream{ path, 1000 };
+  std::size_t index = 0;
+  std::size_t chunks = 0;
+  thing::tokenize_stream(stream, [&](const auto &tokens, const std::size_t offset) {
+    ++chunks;
+    for (std::size_t token = 0; token < tokens.size(); ++token, ++index) {
+      REQUIRE(index < expected.size());
+      CHECK(tokens.types[token] == expected.types[index]);
+      CHECK(offset + tokens.offsets[token] == expected.offsets[index]);
+      CHECK(tokens.match(token) == expected.match(index));
+    }
+  });
+
+  CHECK(index == expected.size());
+  CHECK(chunks > 1);
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Cached parse trees are loaded in place and rebuilt when stale or corrupt")
+{
+  const auto directory = std::filesystem::temp_directory_path() / "thing_parse_cache_test";
+  std::filesystem::remove_all(directory);
+  const thing::parse_cache cache{ directory };
+
+  const std::string source = "auto f(auto x) { if (x > 1) { print(\"big\"); } g(x * 3 + 0x10, 2.5); }";
+  thing::parsing::basic_flat_parser<std::vector> parser;
+  const auto expected = parser.parse(thing::lexing::tokenize(source));
+
+  const auto same_tree = [&](const thing::cached_parse &parsed) {
+    REQUIRE(parsed.tree.size() == expected.size());
+    for (std::size_t index = 0; index < expected.size(); ++index) {
+      const auto &lhs = parsed.tree[index];
+      const auto &rhs = expected[index];
+      CHECK(lhs.type == rhs.type);
+      CHECK(lhs.error == rhs.error);
+      CHECK(lhs.offset == rhs.offset);
+      CHECK(lhs.length == rhs.length);
+      CHECK(lhs.symbol == rhs.symbol);
+      CHECK(lhs.child_count == rhs.child_count);
+      CHECK(lhs.subtree_end == rhs.subtree_end);
+      CHECK(parsed.tree.item(index).match == expected.item(index).match);
+      CHECK(parsed.tree.item(index).number == expected.item(index).number);
+      if (lhs.type == thing::lexing::token_type::identifier) {
+        CHECK(parsed.symbols.name(lhs.symbol) == parsed.tree.item(index).match);
+      }
+    }
+  };
+
+  using header = thing::parse_cache::header;
+  const auto read_entry = [](const std::filesystem::path &entry_path) {
+    std::string bytes(std::filesystem::file_size(entry_path), '\0');
+    std::ifstream file{ entry_path, std::ios::binary };
+    file.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    return bytes;
+  };
+  const auto write_entry = [](const std::filesystem::path &entry_path, const std::string &bytes) {
+    std::ofstream file{ entry_path, std::ios::binary | std::ios::trunc };
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  };
+
+  const auto cold = cache.parse(source);
+  CHECK_FALSE(cold.hit);
+  same_tree(cold);
+
+  // the nodes are used where they are mapped, and survive moving the result
+  auto warm = cache.parse(source);
+  CHECK(warm.hit);
+  const auto *nodes = warm.tree.nodes.data();
+  const auto moved = std::move(warm);
+  CHECK(moved.tree.nodes.data() == nodes);
+  same_tree(moved);
+
+  const auto path = cache.entry_path(thing::content_hash(source));
+  REQUIRE(std::filesystem::exists(path));
+  const auto entry = read_entry(path);
+  header entry_header{};
+  std::memcpy(&entry_header, entry.data(), sizeof(entry_header));
+  const auto nodes_start = sizeof(header) + entry_header.number_count * sizeof(thing::parse_cache::number)
+                           + entry_header.name_count * sizeof(thing::parse_cache::symbol_name);
+
+  // the same source always gives the same bytes, padding included
+  std::filesystem::remove(path);
+  CHECK_FALSE(cache.parse(source).hit);
+  CHECK(read_entry(path) == entry);
+
+  // a flipped byte in the nodes fails the checksum, and the entry is replaced
+  {
+    std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+    file.seekp(static_cast<std::streamoff>(nodes_start + 5));
+    file.put('\x7f');
+  }
+  const auto corrupt = cache.parse(source);
+  CHECK_FALSE(corrupt.hit);
+  same_tree(corrupt);
+  CHECK(cache.parse(source).hit);
+
+  // as is a truncated one
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+  CHECK_FALSE(cache.parse(source).hit);
+  CHECK(cache.parse(source).hit);
+
+  // and one whose root claims a child too many, even with its checksum fixed
+  {
+    auto doctored = entry;
+    thing::parse_cache::node root{};
+    std::memcpy(&root, doctored.data() + nodes_start, sizeof(root));
+    ++root.child_count;
+    std::memcpy(doctored.data() + nodes_start, &root, sizeof(root));
+    auto doctored_header = entry_header;
+    doctored_header.node_checksum =
+      thing::content_hash(doctored.data() + nodes_start, entry_header.node_count * sizeof(root));
+    std::memcpy(doctored.data(), &doctored_header, sizeof(doctored_header));
+    write_entry(path, doctored);
+  }
+  CHECK_FALSE(cache.parse(source).hit);
+  CHECK(cache.parse(source).hit);
+
+  // an entry written for other source text is never used for this one
+  std::filesystem::copy_file(path,
+    cache.entry_path(thing::content_hash(source + " ")),
+    std::filesystem::copy_options::overwrite_existing);
+  CHECK_FALSE(cache.parse(source + " ").hit);
+
+  // nor one for source of the same size with the same hash. These two
+  // collided when content_hash mixed in whole words without scrambling them.
+  const std::string plus = "aaaaaaa+bbbbbbbVbbbbbbbL";
+  const std::string minus = "aaaaaaa-bbbbbbbabbbbbbba";
+  CHECK(thing::content_hash(plus) != thing::content_hash(minus));
+  CHECK_FALSE(cache.parse(plus).hit);
+  CHECK(cache.parse(minus).tree[0].type == thing::lexing::token_type::minus);
+  {
+    auto colliding = read_entry(cache.entry_path(thing::content_hash(plus)));
+    header colliding_header{};
+    std::memcpy(&colliding_header, colliding.data(), sizeof(colliding_header));
+    colliding_header.source_hash = thing::content_hash(minus);
+    std::memcpy(colliding.data(), &colliding_header, sizeof(colliding_header));
+    write_entry(cache.entry_path(thing::content_hash(minus)), colliding);
+  }
+  const auto collided = cache.parse(minus);
+  CHECK_FALSE(collided.hit);
+  CHECK(collided.tree[0].type == thing::lexing::token_type::minus);
+  CHECK(cache.parse(minus).hit);
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Scripts that cannot be compiled throw a compile_error")
+{
+  CHECK_THROWS_AS(thing::compiling::compile("1 +"), thing::compiling::compile_error);
+  CHECK_THROWS_AS(thing::compiling::compile("x + 1"), thing::compiling::compile_error);
+  CHECK_THROWS_AS(thing::compiling::compile("print(1)"), thing::compiling::compile_error);
+  CHECK_THROWS_AS(thing::compiling::compile("auto x{ if (true) 1; }"), thing::compiling::compile_error);
+  CHECK_THROWS_AS(
+    thing::compiling::compile("auto x{ if (true) { auto y{ 1 }; y; } else 2; }"), thing::compiling::compile_error);
+
+  std::string long_script = "1";
+  for (int term = 0; term < 100; ++term) { long_script += " + 1"; }
+  CHECK_THROWS_AS(thing::compiling::compile(long_script), thing::compiling::compile_error);
+}